@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <getopt.h>
 
 #include "libmpeg2.h"
 
@@ -10,6 +11,7 @@
 #include "es.hpp"
 #include "ogl.hpp"
 #include "decoder.hpp"
+#include "decoderop.hpp"
 #include "xeventloop.hpp"
 
 #include <sys/time.h>
@@ -27,18 +29,52 @@ int main( int argc, char *argv[] )
   Decoder *decoder;
   XEventLoop *xevents;
 
-  if ( argc != 2 ) {
-    fprintf( stderr, "USAGE: %s FILENAME\n", argv[ 0 ] );
+  int lowres = 0;
+  bool mapped = false;
+  DisplayOutput output = OUTPUT_WINDOW;
+  double refresh_hz = 60;
+
+  const struct option long_options[] = {
+    { "headless", optional_argument, NULL, 'H' },
+    { "refresh", required_argument, NULL, 'r' },
+    { NULL, 0, NULL, 0 } };
+
+  int opt;
+  while ( (opt = getopt_long( argc, argv, "l:m", long_options, NULL )) != -1 ) {
+    switch ( opt ) {
+    case 'l': lowres = atoi( optarg ); break;
+    case 'm': mapped = true; break;
+    case 'H':
+      if ( !optarg || !strcmp( optarg, "checksum" ) ) {
+	output = OUTPUT_CHECKSUM;
+      } else if ( !strcmp( optarg, "offscreen" ) ) {
+	output = OUTPUT_OFFSCREEN;
+      } else {
+	argc = 0;
+      }
+      break;
+    case 'r': refresh_hz = atof( optarg ); break;
+    default: argc = 0; break;
+    }
+  }
+
+  if ( (argc - optind != 1) || (lowres < 0) || (lowres > 2) || !(refresh_hz > 0) ) {
+    fprintf( stderr, "USAGE: %s [-l LOWRES] [-m] [--headless[=checksum|offscreen] [--refresh HZ]] FILENAME\n", argv[ 0 ] );
+    fprintf( stderr, "  -l  decode at 1/2 (1) or 1/4 (2) resolution\n" );
+    fprintf( stderr, "  -m  decode into mapped GL buffers (ARB_buffer_storage)\n" );
+    fprintf( stderr, "  --headless  play through once without X, checksumming frames or\n" );
+    fprintf( stderr, "              painting them offscreen, and report the timing\n" );
+    fprintf( stderr, "  --refresh   simulated refresh rate when headless (default 60)\n" );
     exit( 1 );
   }
 
   fprintf( stderr, "Opening file..." );
-  file = new File( argv[ 1 ] );
+  file = new File( argv[ optind ] );
   fprintf( stderr, " done.\n" );
 
   fprintf( stderr, "Constructing elementary stream object...      " );
   try {
-    stream = new ES( file, &progress_bar );
+    stream = new ES( file, &progress_bar, lowres );
   } catch ( AhabException *e ) {
     fprintf( stderr, "Caught exception.\n" );
     if ( UnixError *ue = dynamic_cast<UnixError *>( e ) ) {
@@ -51,26 +87,45 @@ int main( int argc, char *argv[] )
 
   seq = stream->get_sequence();
 
-  display = new OpenGLDisplay( (char *)NULL, seq->get_sar(),
-			       16 * seq->get_mb_width(),
-			       16 * seq->get_mb_height(),
-			       seq->get_horizontal_size(),
-			       seq->get_vertical_size() );
+  if ( output == OUTPUT_WINDOW ) {
+    display = new OpenGLDisplay( (char *)NULL, seq->get_sar(),
+				 16 * seq->get_mb_width(),
+				 16 * seq->get_mb_height(),
+				 seq->get_horizontal_size(),
+				 seq->get_vertical_size(),
+				 lowres, mapped ? stream->get_pool() : NULL );
+  } else {
+    display = new OpenGLDisplay( output, refresh_hz,
+				 16 * seq->get_mb_width(),
+				 16 * seq->get_mb_height(),
+				 seq->get_horizontal_size(),
+				 seq->get_vertical_size(),
+				 lowres, mapped ? stream->get_pool() : NULL );
+  }
 
   fprintf( stderr, "Pictures: %d, duration: %.3f seconds.\n",
 	   stream->get_num_pictures(), stream->get_duration() );
 
-  controller = new Controller( stream->get_num_pictures() );
+  controller = NULL;
+  xevents = NULL;
 
-  decoder = new Decoder( stream, display->get_queue() );
+  if ( output == OUTPUT_WINDOW ) {
+    controller = new Controller( stream->get_num_pictures() );
+  }
+
+  decoder = new Decoder( stream, display->get_queue(), display->get_clock() );
 
-  xevents = new XEventLoop( display );
+  if ( output == OUTPUT_WINDOW ) {
+    xevents = new XEventLoop( display );
 
-  controller->get_queue()->hookup( decoder->get_queue() );
-  xevents->get_key_queue()->hookup( decoder->get_queue() );
-  xevents->get_repaint_queue()->hookup( display->get_queue() );
+    controller->get_queue()->hookup( decoder->get_queue() );
+    xevents->get_key_queue()->hookup( decoder->get_queue() );
+    xevents->get_repaint_queue()->hookup( display->get_queue() );
 
-  decoder->get_output_queue()->hookup( controller->get_input_queue() );
+    decoder->get_output_queue()->hookup( controller->get_input_queue() );
+  } else {
+    decoder->get_queue()->enqueue( new PlayToEnd() );
+  }
 
   try {
     decoder->wait_shutdown();
@@ -0,0 +1,43 @@
+#include "batchdecoder.hpp"
+#include "framebuffer.hpp"
+#include "picture.hpp"
+
+BatchDecoder::BatchDecoder( ES *s_stream, DecodeEngine *s_engine,
+			    uint s_window )
+  : stream( s_stream ), engine( s_engine ), window( s_window )
+{
+  /* Every picture in flight holds a frame, and so may its references.
+     Leave the pool room for those or we will wait forever. */
+  uint max_window = stream->get_pool()->get_num_frames() / 2;
+
+  if ( window > max_window ) {
+    window = max_window;
+  }
+
+  if ( window < 1 ) {
+    window = 1;
+  }
+}
+
+void BatchDecoder::decode( uint first, uint last, FrameSink *sink )
+{
+  ahabassert( first <= last );
+  ahabassert( last <= stream->get_num_pictures() );
+
+  uint started = first;
+
+  for ( uint i = first; i < last; i++ ) {
+    /* Keep the window full */
+    while ( (started < last) && (started < i + window) ) {
+      stream->get_picture_displayed( started )->start_parallel_decode( engine, true );
+      started++;
+    }
+
+    Picture *pic = stream->get_picture_displayed( i );
+    FrameHandle *handle = pic->get_framehandle();
+
+    handle->wait_rendered();
+    sink->deliver( pic, handle->get_frame() );
+    handle->decrement_lockcount();
+  }
+}
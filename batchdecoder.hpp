@@ -0,0 +1,38 @@
+#ifndef BATCHDECODER_HPP
+#define BATCHDECODER_HPP
+
+#include "es.hpp"
+#include "decodeengine.hpp"
+
+class Frame;
+class Picture;
+
+/* Receives each decoded picture in display order. The frame is
+   locked for the duration of the call and released afterward,
+   so it must not be retained. */
+class FrameSink
+{
+public:
+  virtual void deliver( Picture *picture, Frame *frame ) = 0;
+  virtual ~FrameSink() {}
+};
+
+/* Headless decoder for processing pipelines: keeps up to "window"
+   pictures decoding in parallel and hands them to the sink in order. */
+class BatchDecoder
+{
+private:
+  ES *stream;
+  DecodeEngine *engine;
+  uint window;
+
+public:
+  BatchDecoder( ES *s_stream, DecodeEngine *s_engine, uint s_window );
+
+  uint get_window( void ) { return window; }
+
+  /* Decode displayed pictures [first, last) */
+  void decode( uint first, uint last, FrameSink *sink );
+};
+
+#endif
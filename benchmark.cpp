@@ -1,6 +1,10 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
 
 #include "libmpeg2.h"
 
@@ -11,20 +15,100 @@
 #include "framebuffer.hpp"
 #include "picture.hpp"
 #include "decodeengine.hpp"
+#include "batchdecoder.hpp"
 
 void progress_bar( off_t, off_t ) {}
 
+static double seconds( const struct timespec &start, const struct timespec &finish )
+{
+  return (finish.tv_sec - start.tv_sec)
+    + (finish.tv_nsec - start.tv_nsec) / 1000000000.0;
+}
+
+/* Hardware cache misses of the calling thread: last-level cache misses
+   and L1 data cache read misses. Virtual machines and a restrictive
+   perf_event_paranoid often don't allow them; then available() is
+   false and nothing is counted. */
+class CacheMissCounter
+{
+private:
+  int fd[ 2 ];
+
+public:
+  CacheMissCounter();
+  ~CacheMissCounter();
+
+  bool available( void ) { return (fd[ 0 ] >= 0) && (fd[ 1 ] >= 0); }
+  void read( uint64_t count[ 2 ] );
+};
+
+CacheMissCounter::CacheMissCounter()
+{
+  static const uint32_t types[ 2 ] = { PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE };
+  static const uint64_t configs[ 2 ] = {
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+    | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) };
+
+  for ( int i = 0; i < 2; i++ ) {
+    struct perf_event_attr attr;
+    memset( &attr, 0, sizeof( attr ) );
+    attr.size = sizeof( attr );
+    attr.type = types[ i ];
+    attr.config = configs[ i ];
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd[ i ] = syscall( SYS_perf_event_open, &attr, 0, -1, -1, 0 );
+  }
+}
+
+CacheMissCounter::~CacheMissCounter()
+{
+  for ( int i = 0; i < 2; i++ ) {
+    if ( fd[ i ] >= 0 ) close( fd[ i ] );
+  }
+}
+
+void CacheMissCounter::read( uint64_t count[ 2 ] )
+{
+  for ( int i = 0; i < 2; i++ ) {
+    count[ i ] = 0;
+    if ( (fd[ i ] >= 0)
+	 && (::read( fd[ i ], &count[ i ], sizeof( count[ i ] ) ) != sizeof( count[ i ] )) ) {
+      throw UnixError( errno );
+    }
+  }
+}
+
+class CountingSink : public FrameSink
+{
+public:
+  int count;
+
+  CountingSink() : count( 0 ) {}
+
+  void deliver( Picture *, Frame * ) { count++; }
+};
+
 int main( int argc, char *argv[] )
 {
-  if ( argc != 3 ) {
-    fprintf( stderr, "USAGE: %s FILENAME PARALLEL\n", argv[ 0 ] );
+  if ( (argc != 3) && (argc != 4) ) {
+    fprintf( stderr, "USAGE: %s FILENAME PARALLEL [LOWRES]\n", argv[ 0 ] );
+    fprintf( stderr, "PARALLEL = 0 for serial decode, otherwise number of pictures in flight\n" );
+    fprintf( stderr, "LOWRES = 1 or 2 to decode at 1/2 or 1/4 resolution\n" );
     exit( 1 );
   }
 
-  bool parallel = atoi( argv[ 2 ] );
+  int parallel = atoi( argv[ 2 ] );
+  int lowres = (argc == 4) ? atoi( argv[ 3 ] ) : 0;
+
+  if ( (lowres < 0) || (lowres > 2) ) {
+    fprintf( stderr, "LOWRES must be 0, 1 or 2.\n" );
+    exit( 1 );
+  }
 
   File *file = new File( argv[ 1 ] );
-  ES *stream = new ES( file, &progress_bar );
+  ES *stream = new ES( file, &progress_bar, lowres );
   DecodeEngine engine;
   int num_pictures = stream->get_num_pictures();
 
@@ -34,23 +118,96 @@ int main( int argc, char *argv[] )
 
   int pic_count = 0;
 
-  for ( int i = 0; i < num_pictures; i++ ) {
-    if ( parallel ) {
-      stream->get_picture_displayed( i )->start_parallel_decode( &engine, true );
-      stream->get_picture_displayed( i )->get_framehandle()->wait_rendered();
-    } else {
-      stream->get_picture_displayed( i )->lock_and_decodeall();
+  /* serial decode time and cache misses by picture type (I, P, B) */
+  double type_secs[ 4 ] = { 0, 0, 0, 0 };
+  int type_count[ 4 ] = { 0, 0, 0, 0 };
+  uint64_t type_misses[ 4 ][ 2 ];
+  memset( type_misses, 0, sizeof( type_misses ) );
+  CacheMissCounter counter;
+
+  if ( parallel ) {
+    BatchDecoder batch( stream, &engine, parallel );
+    CountingSink sink;
+    batch.decode( 0, num_pictures, &sink );
+    pic_count = sink.count;
+  } else {
+    /* In coded order, with the references locked first, so each
+       picture's decode is timed on its own */
+    for ( int i = 0; i < num_pictures; i++ ) {
+      Picture *pic = stream->get_picture_coded( i );
+      Picture *refs[ 2 ] = { pic->get_forward(), pic->get_backward() };
+
+      for ( int r = 0; r < 2; r++ ) {
+	if ( refs[ r ] ) refs[ r ]->lock_and_decodeall();
+      }
+
+      struct timespec pic_start, pic_finish;
+      uint64_t misses_start[ 2 ], misses_finish[ 2 ];
+      counter.read( misses_start );
+      unixassert( clock_gettime( CLOCK_REALTIME, &pic_start ) );
+      pic->lock_and_decodeall();
+      unixassert( clock_gettime( CLOCK_REALTIME, &pic_finish ) );
+      counter.read( misses_finish );
+
+      type_secs[ pic->get_type() ] += seconds( pic_start, pic_finish );
+      type_count[ pic->get_type() ]++;
+      for ( int k = 0; k < 2; k++ ) {
+	type_misses[ pic->get_type() ][ k ] += misses_finish[ k ] - misses_start[ k ];
+      }
+
+      pic->get_framehandle()->decrement_lockcount();
+      for ( int r = 0; r < 2; r++ ) {
+	if ( refs[ r ] ) refs[ r ]->get_framehandle()->decrement_lockcount();
+      }
+      pic_count++;
     }
-    
-    stream->get_picture_displayed( i )->get_framehandle()->decrement_lockcount();
-    pic_count++;
   }
 
   unixassert( clock_gettime( CLOCK_REALTIME, &finish ) );
 
-  double secs = (finish.tv_sec - start.tv_sec)
-    + (finish.tv_nsec - start.tv_nsec) / 1000000000.0;
+  double secs = seconds( start, finish );
 
-  printf( "%d pictures in %.3f s = %.3f pics per second\n",
-	  pic_count, secs, pic_count / secs );
+  printf( "%d pictures in %.3f s = %.3f pics per second (%s kernels)\n",
+	  pic_count, secs, pic_count / secs, mpeg2_kernels()->name );
+
+  const char type_name[ 4 ] = { '?', 'I', 'P', 'B' };
+  for ( int t = I; t <= B; t++ ) {
+    if ( type_count[ t ] ) {
+      printf( "  %c: %d pictures, %.3f ms per picture", type_name[ t ],
+	      type_count[ t ], 1000 * type_secs[ t ] / type_count[ t ] );
+      if ( counter.available() ) {
+	printf( ", %.0f LLC / %.0f L1D read misses per picture",
+		(double)type_misses[ t ][ 0 ] / type_count[ t ],
+		(double)type_misses[ t ][ 1 ] / type_count[ t ] );
+      }
+      printf( "\n" );
+    }
+  }
+
+  if ( !parallel && !counter.available() ) {
+    printf( "  (cache miss counters not available)\n" );
+  }
+
+  if ( !parallel ) {
+    /* Seek around the stream like a user scrubbing it. Pictures no
+       longer in the pool are restored from the frame cache or
+       re-decoded along with their references. */
+    uint32_t seed = 1;
+    unixassert( clock_gettime( CLOCK_REALTIME, &start ) );
+    for ( int i = 0; i < num_pictures; i++ ) {
+      seed = seed * 1103515245 + 12345;
+      Picture *pic = stream->get_picture_displayed( (seed >> 8) % num_pictures );
+      pic->lock_and_decodeall();
+      pic->get_framehandle()->decrement_lockcount();
+    }
+    unixassert( clock_gettime( CLOCK_REALTIME, &finish ) );
+
+    printf( "random seeks: %.3f ms per picture\n",
+	    1000 * seconds( start, finish ) / num_pictures );
+  }
+
+  stream->get_pool()->get_cache()->print_status();
+  if ( stream->get_pool()->get_spill() ) {
+    stream->get_pool()->get_spill()->print_status();
+  }
 }
@@ -1,14 +1,8 @@
-/* Ahab defines */
-
-#define mpeg2_idct_copy mpeg2_idct_copy_sse2
-#define mpeg2_idct_add mpeg2_idct_add_sse2
-#define mpeg2_mc mpeg2_mc_mmxext
-
 /* include/config.h.  Generated from config.h.in by configure.  */
 /* include/config.h.in.  Generated from configure.ac by autoheader.  */
 
 /* autodetect accelerations */
-/* #undef ACCEL_DETECT  */
+#define ACCEL_DETECT 
 
 /* alpha architecture */
 /* #undef ARCH_ALPHA */
@@ -0,0 +1,294 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libmpeg2.h"
+
+#include "file.hpp"
+#include "es.hpp"
+#include "mpegheader.hpp"
+#include "exceptions.hpp"
+#include "framebuffer.hpp"
+#include "picture.hpp"
+#include "decodeengine.hpp"
+#include "batchdecoder.hpp"
+
+/* Decodes a stream serially and in parallel under several thread
+   limits, with every kernel set this CPU supports, and checks the
+   CRC-32 of each picture's Y, Cb and Cr planes against a golden list.
+   Stops at the first mismatch. */
+
+void progress_bar( off_t, off_t ) {}
+
+static const int parallel_window = 8;
+static const int thread_limits[] = { 1, 2, 4, 0 };
+
+static uint32_t crc_table[ 256 ];
+
+static void crc_init( void )
+{
+  for ( uint32_t i = 0; i < 256; i++ ) {
+    uint32_t c = i;
+    for ( int k = 0; k < 8; k++ ) {
+      c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+    }
+    crc_table[ i ] = c;
+  }
+}
+
+/* CRC-32 of the visible width x height pixels of a plane */
+static uint32_t plane_crc( const uint8_t *plane, uint width, uint height, uint stride )
+{
+  uint32_t c = 0xffffffff;
+  for ( uint row = 0; row < height; row++ ) {
+    const uint8_t *p = plane + row * stride;
+    for ( uint i = 0; i < width; i++ ) {
+      c = crc_table[ (c ^ p[ i ]) & 0xff ] ^ (c >> 8);
+    }
+  }
+  return c ^ 0xffffffff;
+}
+
+class Checksum
+{
+public:
+  uint32_t crc[ 3 ];
+
+  bool operator==( const Checksum &other ) const
+  {
+    return !memcmp( crc, other.crc, sizeof( crc ) );
+  }
+};
+
+/* Checksums each delivered picture and compares it with the golden
+   list, or fills the list in if it is still empty */
+class ChecksumSink : public FrameSink
+{
+private:
+  Checksum *golden;
+  uint num_golden;
+  bool filling;
+
+  uint luma_width, luma_height, chroma_width, chroma_height;
+
+public:
+  uint delivered;
+  bool failed;
+
+  ChecksumSink( Sequence *seq, Checksum *s_golden, uint s_num_golden, bool s_filling );
+
+  void deliver( Picture *picture, Frame *frame );
+};
+
+ChecksumSink::ChecksumSink( Sequence *seq, Checksum *s_golden,
+			    uint s_num_golden, bool s_filling )
+  : golden( s_golden ), num_golden( s_num_golden ), filling( s_filling ),
+    delivered( 0 ), failed( false )
+{
+  luma_width = seq->get_horizontal_size();
+  luma_height = seq->get_vertical_size();
+  chroma_width = (luma_width + 1) / 2;
+  chroma_height = (luma_height + 1) / 2;
+}
+
+void ChecksumSink::deliver( Picture *picture, Frame *frame )
+{
+  uint n = picture->get_display();
+
+  Checksum sum;
+  sum.crc[ 0 ] = plane_crc( frame->get_y(), luma_width, luma_height, frame->get_stride() );
+  sum.crc[ 1 ] = plane_crc( frame->get_cb(), chroma_width, chroma_height, frame->get_uv_stride() );
+  sum.crc[ 2 ] = plane_crc( frame->get_cr(), chroma_width, chroma_height, frame->get_uv_stride() );
+
+  delivered++;
+
+  if ( failed ) {
+    return;
+  }
+
+  if ( filling ) {
+    golden[ n ] = sum;
+    return;
+  }
+
+  if ( (n >= num_golden) || !(sum == golden[ n ]) ) {
+    static const char *planes[ 3 ] = { "Y", "Cb", "Cr" };
+    printf( "FAIL at picture %u:", n );
+    for ( int i = 0; i < 3; i++ ) {
+      if ( n >= num_golden ) {
+	printf( " %s %08x", planes[ i ], sum.crc[ i ] );
+      } else if ( sum.crc[ i ] != golden[ n ].crc[ i ] ) {
+	printf( " %s %08x (expected %08x)", planes[ i ], sum.crc[ i ], golden[ n ].crc[ i ] );
+      }
+    }
+    printf( "\n" );
+    failed = true;
+  }
+}
+
+/* Decodes the whole stream with a fresh ES, so no frames are reused
+   from an earlier run. threads < 0 means the serial path. */
+static bool run( char *filename, int threads,
+		 Checksum *golden, uint num_golden, bool filling )
+{
+  File *file = new File( filename );
+  ES *stream = new ES( file, &progress_bar, 0 );
+  uint num_pictures = stream->get_num_pictures();
+
+  ChecksumSink sink( stream->get_sequence(), golden, num_golden, filling );
+
+  if ( threads < 0 ) {
+    for ( uint i = 0; (i < num_pictures) && !sink.failed; i++ ) {
+      Picture *pic = stream->get_picture_displayed( i );
+      pic->lock_and_decodeall();
+      sink.deliver( pic, pic->get_framehandle()->get_frame() );
+      pic->get_framehandle()->decrement_lockcount();
+    }
+  } else {
+    DecodeEngine engine( threads );
+    BatchDecoder batch( stream, &engine, parallel_window );
+    batch.decode( 0, num_pictures, &sink );
+  }
+
+  bool ok = !sink.failed;
+  if ( ok && (sink.delivered != num_golden) ) {
+    printf( "FAIL: decoded %u pictures, expected %u\n", sink.delivered, num_golden );
+    ok = false;
+  }
+
+  delete stream;
+  delete file;
+
+  return ok;
+}
+
+static uint read_golden( const char *filename, Checksum *golden, uint max )
+{
+  FILE *f = fopen( filename, "r" );
+  if ( f == NULL ) {
+    perror( filename );
+    exit( 1 );
+  }
+
+  char line[ 256 ];
+  uint count = 0;
+  while ( fgets( line, sizeof( line ), f ) ) {
+    uint n;
+    Checksum sum;
+    if ( line[ 0 ] == '#' ) continue;
+    if ( (sscanf( line, "%u %x %x %x", &n, &sum.crc[ 0 ], &sum.crc[ 1 ], &sum.crc[ 2 ] ) != 4)
+	 || (n != count) || (count == max) ) {
+      fprintf( stderr, "%s: bad checksum line: %s", filename, line );
+      exit( 1 );
+    }
+    golden[ count++ ] = sum;
+  }
+
+  fclose( f );
+  return count;
+}
+
+static void write_golden( const char *filename, const Checksum *golden, uint count )
+{
+  FILE *f = fopen( filename, "w" );
+  if ( f == NULL ) {
+    perror( filename );
+    exit( 1 );
+  }
+
+  fprintf( f, "# display number, CRC-32 of Y, Cb, Cr\n" );
+  for ( uint i = 0; i < count; i++ ) {
+    fprintf( f, "%u %08x %08x %08x\n", i, golden[ i ].crc[ 0 ], golden[ i ].crc[ 1 ], golden[ i ].crc[ 2 ] );
+  }
+
+  if ( fclose( f ) < 0 ) {
+    perror( filename );
+    exit( 1 );
+  }
+}
+
+int main( int argc, char *argv[] )
+{
+  bool write = false;
+  int repeat = 1;
+
+  int opt;
+  while ( (opt = getopt( argc, argv, "wr:" )) != -1 ) {
+    switch ( opt ) {
+    case 'w': write = true; break;
+    case 'r': repeat = atoi( optarg ); break;
+    default: argc = 0; break;
+    }
+  }
+
+  if ( (argc - optind != 2) || (repeat < 1) ) {
+    fprintf( stderr, "USAGE: %s [-w] [-r REPEAT] FILENAME GOLDEN\n", argv[ 0 ] );
+    fprintf( stderr, "  -w  write GOLDEN from the first (serial) decode, then check the rest against it\n" );
+    fprintf( stderr, "  -r  run each parallel configuration REPEAT times\n" );
+    exit( 1 );
+  }
+
+  char *filename = argv[ optind ];
+  const char *golden_filename = argv[ optind + 1 ];
+
+  crc_init();
+
+  uint num_pictures;
+  {
+    File file( filename );
+    ES stream( &file, &progress_bar, 0 );
+    num_pictures = stream.get_num_pictures();
+  }
+
+  Checksum *golden = new Checksum[ num_pictures ];
+  uint num_golden = num_pictures;
+
+  if ( !write ) {
+    num_golden = read_golden( golden_filename, golden, num_pictures );
+  }
+
+  int num_sets;
+  const mpeg2_kernels_t *sets = mpeg2_kernel_sets( &num_sets );
+  uint32_t accel = mpeg2_detect_accel( 0 );
+  bool filling = write;
+
+  for ( int i = 0; i < num_sets; i++ ) {
+    if ( !(accel & sets[ i ].accel) ) continue;
+
+    mpeg2_use_kernels( &sets[ i ] );
+
+    int num_limits = sizeof( thread_limits ) / sizeof( thread_limits[ 0 ] );
+    for ( int config = -1; config < num_limits; config++ ) {
+      int threads = (config < 0) ? -1 : thread_limits[ config ];
+
+      for ( int rep = 0; rep < ((threads < 0) ? 1 : repeat); rep++ ) {
+	printf( "%-7s ", sets[ i ].name );
+	if ( threads < 0 ) {
+	  printf( "serial            " );
+	} else if ( threads == 0 ) {
+	  printf( "parallel, any threads " );
+	} else {
+	  printf( "parallel, %d threads   ", threads );
+	}
+	fflush( stdout );
+
+	if ( !run( filename, threads, golden, num_golden, filling ) ) {
+	  exit( 1 );
+	}
+
+	if ( filling ) {
+	  write_golden( golden_filename, golden, num_golden );
+	  filling = false;
+	  printf( "wrote %u checksums to %s\n", num_golden, golden_filename );
+	} else {
+	  printf( "%u pictures ok\n", num_golden );
+	}
+      }
+    }
+  }
+
+  delete[] golden;
+
+  return 0;
+}
@@ -5,6 +5,12 @@
 #include "controllerop.hpp"
 
 #include <stdio.h>
+#include <stdlib.h>
+
+/* Slider moves of more than one picture this close together (in
+   seconds) count as a fast drag, and the drag has settled once there
+   has been none for as long */
+static const double preview_interval = 0.1;
 
 static void *thread_helper( void *controller )
 {
@@ -18,8 +24,12 @@ Controller::Controller( uint s_num_frames )
   : quit_signal( NULL ),
     opq( 0 ),
     inputq( 0 ),
-    num_frames( s_num_frames )
+    num_frames( s_num_frames ),
+    last_frame( 0 ),
+    previewing( false )
 {
+  last_change.tv_sec = last_change.tv_usec = 0;
+
   unixassert( pthread_mutex_init( &mutex, NULL ) );
   pthread_create( &thread_handle, NULL, thread_helper, this );
 }
@@ -69,6 +79,7 @@ void Controller::loop( void )
     state.scale->set_draw_value();
 
     state.scale->signal_change_value().connect( sigc::mem_fun( this, &Controller::on_changed_value ) );
+    state.scale->signal_button_release_event().connect( sigc::mem_fun( this, &Controller::on_button_release ), false );
 
     quit_signal->connect( sigc::mem_fun( this, &Controller::shutdown ) );
     state.move_slider->connect( sigc::mem_fun( this, &Controller::move ) );
@@ -80,6 +91,8 @@ void Controller::loop( void )
 
   main->run( *window );
 
+  settle.disconnect();
+
   {
     MutexLock x( &mutex );
     delete quit_signal;
@@ -104,13 +117,59 @@ bool Controller::on_changed_value( Gtk::ScrollType, double new_value )
   if ( cur_frame < 0 ) cur_frame = 0;
   if ( cur_frame >= num_frames ) cur_frame = num_frames - 1;
 
-  SetPictureNumber *op = new SetPictureNumber( cur_frame );
+  struct timeval now;
+  unixassert( gettimeofday( &now, NULL ) );
+
+  double elapsed = (now.tv_sec - last_change.tv_sec)
+    + (now.tv_usec - last_change.tv_usec) / 1000000.0;
+
+  previewing = (abs( cur_frame - last_frame ) > 1) && (elapsed < preview_interval);
+  last_frame = cur_frame;
+  last_change = now;
+
+  DecoderOperation *op;
+  if ( previewing ) {
+    op = new PreviewPictureNumber( cur_frame );
+  } else {
+    op = new SetPictureNumber( cur_frame );
+  }
+
   opq.flush_type( op );
   opq.enqueue( op );
 
+  /* Keys and the scroll wheel move the slider without a button
+     release to end the preview */
+  settle.disconnect();
+  if ( previewing ) {
+    settle = Glib::signal_timeout().connect( sigc::mem_fun( this, &Controller::show_exact ),
+					     lround( preview_interval * 1000 ) );
+  }
+
   return true;
 }
 
+bool Controller::on_button_release( GdkEventButton * )
+{
+  settle.disconnect();
+  show_exact();
+
+  return false;
+}
+
+/* The drag is over, so show the exact picture. Returns false so that
+   the settle timeout fires only once. */
+bool Controller::show_exact( void )
+{
+  if ( previewing ) {
+    SetPictureNumber *op = new SetPictureNumber( last_frame );
+    opq.flush_type( op );
+    opq.enqueue( op );
+    previewing = false;
+  }
+
+  return false;
+}
+
 Controller::~Controller()
 {
   {
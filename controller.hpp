@@ -3,6 +3,7 @@
 
 #include <gtkmm-2.4/gtkmm.h>
 #include <pthread.h>
+#include <sys/time.h>
 
 #include "decoderop.hpp"
 #include "controllerop.hpp"
@@ -22,6 +23,8 @@ private:
   pthread_t thread_handle;
 
   bool on_changed_value( Gtk::ScrollType scroll, double new_value );
+  bool on_button_release( GdkEventButton *event );
+  bool show_exact( void );
   void shutdown( void ) { main->quit(); }
   void move( void );
 
@@ -33,6 +36,13 @@ private:
 
   int num_frames;
 
+  /* Fast drags are previewed with I pictures only, until the slider
+     is let go or settles */
+  int last_frame;
+  struct timeval last_change;
+  bool previewing;
+  sigc::connection settle;
+
 public:
   Controller( uint s_num_frames );
   ~Controller();
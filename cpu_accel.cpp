@@ -0,0 +1,165 @@
+/*
+ * cpu_accel.cpp
+ *
+ * Runtime choice of the IDCT and motion compensation kernels. The CPU
+ * is probed with cpuid once, the first time a decoder is set up, and
+ * the fastest kernel set it supports is used from then on. Setting
+ * AHAB_ACCEL to one of the set names below (mmx, mmxext, sse2, avx2)
+ * forces that set instead, e.g. to compare them with the benchmark.
+ *
+ * AVX-512 is detected and reported, but there are no AVX-512 kernels
+ * yet, so such CPUs run the AVX2 set.
+ */
+
+#include "config.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mpeg2.h"
+#include "attributes.h"
+#include "mpeg2_internal.h"
+
+#if defined(ARCH_X86) || defined(ARCH_X86_64)
+
+#include <cpuid.h>
+
+/* XCR0 bits: the OS saves and restores these register states */
+#define XCR0_SSE 0x02
+#define XCR0_AVX 0x04
+#define XCR0_AVX512 0xe0
+
+static inline uint32_t xgetbv (void)
+{
+    uint32_t eax, edx;
+
+    __asm__ __volatile__ ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+    return eax;
+}
+
+static uint32_t x86_accel (void)
+{
+    unsigned int eax, ebx, ecx, edx;
+    uint32_t caps = 0;
+    uint32_t xcr0 = 0;
+
+    if (!__get_cpuid (1, &eax, &ebx, &ecx, &edx))
+	return 0;
+
+    if (edx & bit_MMX)
+	caps |= MPEG2_ACCEL_X86_MMX;
+    if (edx & bit_SSE)		/* SSE includes the MMX extensions */
+	caps |= MPEG2_ACCEL_X86_MMXEXT;
+    if (edx & bit_SSE2)
+	caps |= MPEG2_ACCEL_X86_SSE2;
+    if (ecx & bit_SSE3)
+	caps |= MPEG2_ACCEL_X86_SSE3;
+
+    /* The wider registers are only usable if the OS saves them */
+    if (ecx & bit_OSXSAVE)
+	xcr0 = xgetbv ();
+
+    if ((ecx & bit_AVX) && (xcr0 & (XCR0_SSE | XCR0_AVX)) ==
+	(XCR0_SSE | XCR0_AVX) && __get_cpuid_max (0, NULL) >= 7) {
+	__cpuid_count (7, 0, eax, ebx, ecx, edx);
+	if (ebx & bit_AVX2)
+	    caps |= MPEG2_ACCEL_X86_AVX2;
+	if ((ebx & bit_AVX512F) && (ebx & bit_AVX512BW) &&
+	    (xcr0 & XCR0_AVX512) == XCR0_AVX512)
+	    caps |= MPEG2_ACCEL_X86_AVX512;
+    }
+
+    /* Older AMD parts have the MMX extensions without SSE */
+    if (__get_cpuid (0x80000001, &eax, &ebx, &ecx, &edx)) {
+	if (edx & bit_MMXEXT)
+	    caps |= MPEG2_ACCEL_X86_MMXEXT;
+	if (edx & bit_3DNOW)
+	    caps |= MPEG2_ACCEL_X86_3DNOW;
+    }
+
+    return caps;
+}
+
+#endif
+
+uint32_t mpeg2_detect_accel (uint32_t accel)
+{
+#if defined(ACCEL_DETECT) && (defined(ARCH_X86) || defined(ARCH_X86_64))
+    accel |= x86_accel ();
+#endif
+    return accel;
+}
+
+/* Fastest first. The MMX sets leave the FPU in MMX state, so a slice
+   decoded with them has to finish with emms. */
+static const mpeg2_kernels_t kernel_sets[] = {
+    {"avx2", MPEG2_ACCEL_X86_AVX2,
+     mpeg2_idct_copy_avx2, mpeg2_idct_add_avx2,
+     mpeg2_idct_copy2_avx2, mpeg2_idct_add2_avx2, &mpeg2_mc_avx2, false},
+    {"sse2", MPEG2_ACCEL_X86_SSE2,
+     mpeg2_idct_copy_sse2, mpeg2_idct_add_sse2,
+     mpeg2_idct_copy2_sse2, mpeg2_idct_add2_sse2, &mpeg2_mc_sse2, false},
+    {"mmxext", MPEG2_ACCEL_X86_MMXEXT,
+     mpeg2_idct_copy_mmxext, mpeg2_idct_add_mmxext,
+     mpeg2_idct_copy2_mmxext, mpeg2_idct_add2_mmxext, &mpeg2_mc_mmxext, true},
+    {"mmx", MPEG2_ACCEL_X86_MMX,
+     mpeg2_idct_copy_mmx, mpeg2_idct_add_mmx,
+     mpeg2_idct_copy2_mmx, mpeg2_idct_add2_mmx, &mpeg2_mc_mmx, true},
+};
+
+static const int num_kernel_sets =
+    sizeof (kernel_sets) / sizeof (kernel_sets[0]);
+
+static const mpeg2_kernels_t * select_kernels (void)
+{
+    const uint32_t accel = mpeg2_detect_accel (0);
+    const char * const forced = getenv ("AHAB_ACCEL");
+    int i;
+
+    if (forced) {
+	for (i = 0; i < num_kernel_sets; i++)
+	    if (!strcmp (forced, kernel_sets[i].name))
+		break;
+
+	if (i == num_kernel_sets)
+	    fprintf (stderr, "AHAB_ACCEL=%s is not a kernel set, ignoring.\n",
+		     forced);
+	else if (!(accel & kernel_sets[i].accel))
+	    fprintf (stderr, "AHAB_ACCEL=%s is not supported by this CPU, "
+		     "ignoring.\n", forced);
+	else
+	    return &kernel_sets[i];
+    }
+
+    for (i = 0; i < num_kernel_sets - 1; i++)
+	if (accel & kernel_sets[i].accel)
+	    break;
+
+    return &kernel_sets[i];
+}
+
+/* Every set, fastest first; the caller checks accel against
+   mpeg2_detect_accel () before using one */
+const mpeg2_kernels_t * mpeg2_kernel_sets (int * count)
+{
+    *count = num_kernel_sets;
+    return kernel_sets;
+}
+
+static const mpeg2_kernels_t * forced_kernels;
+
+const mpeg2_kernels_t * mpeg2_kernels (void)
+{
+    static const mpeg2_kernels_t * const kernels = select_kernels ();
+
+    return forced_kernels ? forced_kernels : kernels;
+}
+
+/* Use the given set (NULL for the usual choice) for decoders set up
+   from now on. Only call this while nothing is decoding. */
+void mpeg2_use_kernels (const mpeg2_kernels_t * kernels)
+{
+    forced_kernels = kernels;
+}
@@ -7,8 +7,8 @@
 
 static void *job_runner( void *s_threadq )
 {
-  Queue<ReadyThread> *threadq = (Queue<ReadyThread> *)s_threadq;
-  Queue<DecoderJob> opq( 0 );
+  RingQueue<ReadyThread> *threadq = (RingQueue<ReadyThread> *)s_threadq;
+  RingQueue<DecoderJob> opq( 2 ); /* a worker is handed one job at a time */
 
   ReadyThread me( pthread_self(), &opq );
 
@@ -27,6 +27,9 @@ void DecodeEngine::dispatch( DecoderJob *job )
   ReadyThread *thread = threadq.dequeue( false );
   if ( thread ) {
     thread->opq->enqueue( job );
+  } else if ( max_threads && (thread_count >= max_threads) ) {
+    thread = threadq.dequeue( true );
+    thread->opq->enqueue( job );
   } else {
     pthread_t new_thread;
     {
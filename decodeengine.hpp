@@ -1,30 +1,39 @@
 #ifndef DECODEENGINE_HPP
 #define DECODEENGINE_HPP
 
-#include "opq.hpp"
+#include "ringqueue.hpp"
 #include "decoderjob.hpp"
 #include "exceptions.hpp"
 
+/* Idle workers beyond this wait for the dispatcher to take one */
+const uint max_idle_threads = 1024;
+
 class ReadyThread {
 public:
   pthread_t handle;
-  Queue<DecoderJob> *opq;
+  RingQueue<DecoderJob> *opq;
 
-  ReadyThread( pthread_t s_handle, Queue<DecoderJob> *s_opq )
+  ReadyThread( pthread_t s_handle, RingQueue<DecoderJob> *s_opq )
     : handle( s_handle ), opq( s_opq )
   {}
 };
 
+/* Runs decoder jobs on worker threads, started as needed. With a
+   thread limit, dispatch waits for a worker to come free once that
+   many are running. Jobs only wait on work dispatched before them,
+   so any limit of one or more is safe. */
 class DecodeEngine {
 private:
   pthread_mutex_t mutex;
   int thread_count;
-  Queue<ReadyThread> threadq;
+  int max_threads; /* 0 for no limit */
+  RingQueue<ReadyThread> threadq;
 
 public:
-  DecodeEngine()
+  DecodeEngine( int s_max_threads = 0 )
     : thread_count( 0 ),
-      threadq( 0 )
+      max_threads( s_max_threads ),
+      threadq( max_idle_threads )
   {
     unixassert( pthread_mutex_init( &mutex, NULL ) );
   }
@@ -1,4 +1,5 @@
 #include <pthread.h>
+#include <stdio.h>
 
 #include "decoder.hpp"
 #include "exceptions.hpp"
@@ -7,6 +8,7 @@
 #include "displayop.hpp"
 #include "decoderop.hpp"
 #include "picture.hpp"
+#include "presentationclock.hpp"
 
 static void *thread_helper( void *decoder )
 {
@@ -17,15 +19,24 @@ static void *thread_helper( void *decoder )
 }
 
 Decoder::Decoder( ES *s_stream,
-		  Queue<DisplayOperation> *s_oglq )
+		  Queue<DisplayOperation> *s_oglq,
+		  PresentationClock *s_clock )
   : opq( 0 ),
-    stream( s_stream )
+    stream( s_stream ),
+    picture_shown( NULL ),
+    clock( s_clock ),
+    clock_running( false ),
+    played( 0 ),
+    dropped_b( 0 ),
+    dropped_p( 0 )
 {
   state.current_picture = 0;
   state.fullscreen = false;
   state.live = true;
   state.oglq = s_oglq;
   state.playing = false;
+  state.preview = false;
+  state.quit_at_end = false;
 
   pthread_create( &thread_handle, NULL, thread_helper, this );
 }
@@ -35,18 +46,121 @@ Decoder::~Decoder() {}
 void Decoder::decode_and_display( void )
 {
   Picture *pic = stream->get_picture_displayed( state.current_picture );
+
+  if ( state.preview ) {
+    /* Show the nearest I picture, which needs no references decoded */
+    pic = stream->get_intra_displayed( state.current_picture );
+  }
+
+  if ( pic == picture_shown ) {
+    return;
+  }
+
+  picture_shown = pic;
+
+  int64_t sent_us = 0, due_us = 0;
+  if ( clock_running ) {
+    sent_us = PresentationClock::now();
+    due_us = clock->due( pic->get_time() );
+  }
+
   pic->start_parallel_decode( &engine, true );
   pic->get_framehandle()->wait_rendered();
-  DrawAndUnlockFrame *op = new DrawAndUnlockFrame( pic->get_framehandle() );
+  DrawAndUnlockFrame *op = new DrawAndUnlockFrame( pic->get_framehandle(),
+						   sent_us, due_us,
+						   PresentationClock::now() );
   state.oglq->flush_type( op );
   state.oglq->enqueue( op );
 }
 
+/* A picture has missed its deadline if it could not reach the screen
+   before the next picture is due */
+bool Decoder::missed( int picture_number, int64_t now )
+{
+  if ( (uint)picture_number + 1 >= stream->get_num_pictures() ) {
+    return false;
+  }
+
+  double next_time = stream->get_picture_displayed( picture_number + 1 )->get_time();
+
+  return now + clock->get_latency() > clock->due( next_time );
+}
+
+/* Microseconds until the next picture should be sent to the display */
+int64_t Decoder::playback_wait( void )
+{
+  if ( (uint)state.current_picture + 1 >= stream->get_num_pictures() ) {
+    return 0;
+  }
+
+  double next_time = stream->get_picture_displayed( state.current_picture + 1 )->get_time();
+  int64_t wait = clock->due( next_time ) - clock->get_latency() - PresentationClock::now();
+
+  return wait > 0 ? wait : 0;
+}
+
+void Decoder::advance_playback( void )
+{
+  int num_pictures = stream->get_num_pictures();
+  int next = state.current_picture + 1;
+
+  if ( next >= num_pictures ) {
+    state.playing = false;
+    state.live = !state.quit_at_end;
+    return;
+  }
+
+  int64_t now = PresentationClock::now();
+
+  /* Nothing refers to a B picture, so these go first */
+  while ( missed( next, now )
+	  && (stream->get_picture_displayed( next )->get_type() == B) ) {
+    dropped_b++;
+    next++;
+  }
+
+  /* Dropping a P picture drops everything up to the next I picture */
+  if ( missed( next, now )
+       && (stream->get_picture_displayed( next )->get_type() == P) ) {
+    int intra = next;
+    while ( (intra < num_pictures)
+	    && (stream->get_picture_displayed( intra )->get_type() != I) ) {
+      intra++;
+    }
+
+    if ( intra < num_pictures ) {
+      for ( ; next < intra; next++ ) {
+	if ( stream->get_picture_displayed( next )->get_type() == B ) {
+	  dropped_b++;
+	} else {
+	  dropped_p++;
+	}
+      }
+    }
+  }
+
+  played++;
+  state.current_picture = next;
+  state.outputq.flush();
+  state.outputq.enqueue( new MoveSlider( state.current_picture ) );
+}
+
+void Decoder::report_playback( void )
+{
+  uint late = clock->take_late();
+
+  fprintf( stderr, "[Played %u pictures, dropped %u B and %u P, %u late.]\n",
+	   played, dropped_b, dropped_p, late );
+
+  played = dropped_b = dropped_p = 0;
+}
+
 void Decoder::loop( void )
 {
   decode_and_display();
 
   int picture_displayed = state.current_picture;
+  bool preview_displayed = state.preview;
 
   while ( state.live ) {
     if ( state.current_picture < 0 ) {
@@ -55,22 +169,46 @@ void Decoder::loop( void )
       state.current_picture = stream->get_num_pictures() - 1;
     }
 
-    if ( state.current_picture != picture_displayed ) {
+    /* (Re)start the clock from whatever picture playback resumes at */
+    if ( state.playing && !clock_running ) {
+      clock->start( stream->get_picture_displayed( state.current_picture )->get_time() );
+      clock_running = true;
+    } else if ( !state.playing && clock_running ) {
+      clock_running = false;
+      report_playback();
+    }
+
+    if ( (state.current_picture != picture_displayed)
+	 || (state.preview != preview_displayed) ) {
       decode_and_display();
     }
 
     picture_displayed = state.current_picture;
+    preview_displayed = state.preview;
+
+    DecoderOperation *op;
+    if ( state.playing ) {
+      op = opq.dequeue_timeout( playback_wait() );
+    } else {
+      op = opq.dequeue( true );
+    }
 
-    DecoderOperation *op = opq.dequeue( !state.playing );
     if ( op ) {
       op->execute( state );
       delete op;
+
+      if ( state.current_picture != picture_displayed ) {
+	/* Seeking, so the old deadlines no longer apply */
+	clock_running = false;
+      }
     } else if ( state.playing ) {
-      state.current_picture++;
-      state.outputq.flush();
-      state.outputq.enqueue( new MoveSlider( state.current_picture ) );
+      advance_playback();
     }
   }
+
+  if ( clock_running ) {
+    report_playback();
+  }
 }
 
 void Decoder::wait_shutdown( void )
@@ -8,6 +8,7 @@
 class OpenGLDisplay;
 class DecoderOperation;
 class DisplayOperation;
+class PresentationClock;
 
 #include "opq.hpp"
 #include "decodeengine.hpp"
@@ -23,6 +24,8 @@ public:
   Queue<ControllerOperation> outputq;
 
   bool playing;
+  bool preview;
+  bool quit_at_end; /* stop when playback reaches the last picture */
 
   DecoderState() : outputq( 0 ) {}
 };
@@ -35,11 +38,21 @@ private:
   DecodeEngine engine;
 
   ES *stream;
+  Picture *picture_shown;
+
+  PresentationClock *clock;
+  bool clock_running;
+  uint played, dropped_b, dropped_p;
 
   void decode_and_display( void );
+  bool missed( int picture_number, int64_t now );
+  int64_t playback_wait( void );
+  void advance_playback( void );
+  void report_playback( void );
 
 public:
-  Decoder( ES *s_stream, Queue<DisplayOperation> *s_oglq );
+  Decoder( ES *s_stream, Queue<DisplayOperation> *s_oglq,
+	   PresentationClock *s_clock );
   ~Decoder();
   
   void loop();
@@ -8,6 +8,7 @@ void XKey::execute( DecoderState &state )
   switch ( key ) {
   case ' ':
     state.playing = !state.playing;
+    state.preview = false;
     break;
   case 'f':
     state.fullscreen = !state.fullscreen;
@@ -21,11 +22,13 @@ void XKey::execute( DecoderState &state )
     break;
   case XK_Left:
     state.current_picture--;
+    state.preview = false;
     state.outputq.flush();
     state.outputq.enqueue( new MoveSlider( state.current_picture ) );
     break;
   case XK_Right:
     state.current_picture++;
+    state.preview = false;
     state.outputq.flush();
     state.outputq.enqueue( new MoveSlider( state.current_picture ) );
     break;
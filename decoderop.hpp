@@ -20,7 +20,26 @@ private:
 public:
   SetPictureNumber( int s_picture_number ) : picture_number( s_picture_number ) {}
   ~SetPictureNumber() {}
-  void execute( DecoderState &state ) { state.current_picture = picture_number; }
+  void execute( DecoderState &state ) { state.current_picture = picture_number; state.preview = false; }
+};
+
+/* While scrubbing, show only the nearest I picture */
+class PreviewPictureNumber : public DecoderOperation {
+private:
+  int picture_number;
+
+public:
+  PreviewPictureNumber( int s_picture_number ) : picture_number( s_picture_number ) {}
+  ~PreviewPictureNumber() {}
+  void execute( DecoderState &state ) { state.current_picture = picture_number; state.preview = true; }
+};
+
+/* Plays from the current picture to the end, then shuts down */
+class PlayToEnd : public DecoderOperation {
+public:
+  PlayToEnd() {}
+  ~PlayToEnd() {}
+  void execute( DecoderState &state ) { state.playing = true; state.preview = false; state.quit_at_end = true; }
 };
 
 class XKey : public DecoderOperation {
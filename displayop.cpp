@@ -3,10 +3,56 @@
 #include <stdio.h>
 
 #include "displayop.hpp"
+#include "picture.hpp"
 
 void DrawAndUnlockFrame::execute( OpcodeState &state )
 {
-  state.draw( handle->get_frame()->get_buf() );
+  int64_t start = PresentationClock::now();
+
+  Frame *frame = handle->get_frame();
+  uint display = handle->get_picture()->get_display();
+  if ( state.output == OUTPUT_CHECKSUM ) {
+    state.checksum_frame( frame );
+  } else if ( frame->get_gl_buffer() ) {
+    state.upload_mapped( frame );
+  } else {
+    state.upload( frame->get_y(), frame->get_cb(), frame->get_cr(), frame->get_stride() );
+  }
+
+  /* The textures have what they need from the frame (or it carries a
+     fence until they do), so the decoder can have it back before we
+     wait for the swap */
+  handle->decrement_lockcount();
+  handle = NULL;
+
+  int64_t uploaded = PresentationClock::now();
+  state.paint( due_us );
+
+  state.frames_drawn++;
+  state.upload_us += uploaded - start;
+  state.paint_us += PresentationClock::now() - uploaded;
+
+  FrameTiming timing;
+  timing.display = display;
+  timing.msc = state.last_mbc;
+  timing.ust = state.last_ust;
+  timing.shown_us = state.last_us;
+  timing.decoded_us = decoded_us;
+  timing.due_us = due_us;
+  state.timings->record( timing );
+
+  if ( due_us ) {
+    state.clock.report_swap( sent_us, due_us, state.last_us, state.held_us );
+
+    int64_t latency = state.last_us - sent_us;
+    if ( !state.frames_timed++ ) {
+      state.first_swap_us = state.last_us;
+    }
+    state.latency_us += latency;
+    if ( latency > state.max_latency_us ) {
+      state.max_latency_us = latency;
+    }
+  }
 }
 
 void LoadMatrixCoefficients::execute( OpcodeState &state )
@@ -21,6 +67,10 @@ void ShutDown::execute( OpcodeState & )
 
 void FullScreenMode::execute( OpcodeState &state )
 {
+  if ( state.output != OUTPUT_WINDOW ) {
+    return;
+  }
+
   if ( fullscreen ) {
     state.dofullscreen();
   } else {
@@ -24,13 +24,18 @@ public:
 class DrawAndUnlockFrame : public DisplayOperation {
 private:
   FrameHandle *handle;
+  int64_t sent_us, due_us; /* zero unless playing against the clock */
+  int64_t decoded_us;
 
   static void load_tex( GLenum tnum, GLuint tex, uint width, uint height,
 			uint8_t *data );
 
 public:
-  DrawAndUnlockFrame( FrameHandle *s_handle ) { handle = s_handle; }
-  ~DrawAndUnlockFrame() { handle->decrement_lockcount(); }
+  DrawAndUnlockFrame( FrameHandle *s_handle, int64_t s_sent_us = 0, int64_t s_due_us = 0,
+		      int64_t s_decoded_us = 0 )
+    : handle( s_handle ), sent_us( s_sent_us ), due_us( s_due_us ),
+      decoded_us( s_decoded_us ) {}
+  ~DrawAndUnlockFrame() { if ( handle ) handle->decrement_lockcount(); }
   void execute( OpcodeState &state );
 };
 
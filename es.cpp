@@ -2,7 +2,9 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <errno.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/mman.h>
 #include <typeinfo>
@@ -15,8 +17,73 @@
 #include "picture.hpp"
 
 const uint pool_slots = 50;
+const uint cache_megabytes = 0; /* AHAB_FRAMECACHE_MB enables */
+const uint spill_megabytes = 4096; /* of AHAB_SPILLFILE, if set; AHAB_SPILL_MB overrides */
 
-ES::ES( File *s_file, void (*progress)( off_t size, off_t location ) )
+/* A budget in megabytes from the environment, if it is set to one */
+static size_t megabytes_from_env( const char *name, uint megabytes )
+{
+  const char *value = getenv( name );
+  if ( value ) {
+    char *end;
+    long n = strtol( value, &end, 10 );
+    if ( (end != value) && (*end == '\0') && (n >= 0) ) {
+      return (size_t)n << 20;
+    }
+
+    fprintf( stderr, "%s: \"%s\" is not a number of megabytes; using %u.\n",
+	     name, value, megabytes );
+  }
+
+  return (size_t)megabytes << 20;
+}
+
+static uint64_t fnv1a( uint64_t hash, const uint8_t *buf, size_t len )
+{
+  for ( size_t i = 0; i < len; i++ ) {
+    hash = (hash ^ buf[ i ]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+/* Identifies a stream across sessions, for the spill file: FNV-1a
+   over which file it is (device, inode, size and modification time)
+   and over its first and last 64 KiB and 4 KiB samples spread through
+   the rest, so that a file rewritten in place or copied with its
+   times still changes identity if its contents did */
+static uint64_t stream_identity( File *file )
+{
+  struct stat thestat;
+  if ( fstat( file->get_fd(), &thestat ) < 0 ) {
+    throw UnixError( errno );
+  }
+
+  uint64_t which[ 4 ] = { (uint64_t)thestat.st_dev, (uint64_t)thestat.st_ino,
+			  (uint64_t)thestat.st_size, (uint64_t)thestat.st_mtime };
+  uint64_t hash = fnv1a( 14695981039346656037ULL, (const uint8_t *)which, sizeof( which ) );
+
+  off_t size = file->get_filesize();
+  const uint samples = 64;
+  const size_t end_len = 65536, sample_len = 4096;
+
+  for ( uint s = 0; s <= samples + 1; s++ ) {
+    size_t len = (s == 0) || (s == samples + 1) ? end_len : sample_len;
+    if ( (off_t)len > size ) {
+      len = size;
+    }
+
+    off_t offset = (s == samples + 1) ? size - (off_t)len
+      : (size - (off_t)len) / (samples + 1) * s;
+
+    MapHandle *chunk = file->map( offset, len );
+    hash = fnv1a( hash, chunk->get_buf(), len );
+    delete chunk;
+  }
+
+  return hash;
+}
+
+ES::ES( File *s_file, void (*progress)( off_t size, off_t location ), uint lowres )
 {
   file = s_file;
   first_header = last_header = NULL;
@@ -60,13 +127,29 @@ ES::ES( File *s_file, void (*progress)( off_t size, off_t location ) )
       hdr->link();
   }
 
+  size_t cache_budget = megabytes_from_env( "AHAB_FRAMECACHE_MB", cache_megabytes );
+
   pool = new BufferPool( pool_slots, seq->get_mb_width(),
-			 seq->get_mb_height() );
+			 seq->get_mb_height(), lowres, cache_budget );
 
   /* Figure out the display order of each picture and link each
      from the coded_picture and displayed_picture arrays */
   number_pictures();
 
+  const char *spill_file = getenv( "AHAB_SPILLFILE" );
+  if ( spill_file ) {
+    size_t spill_budget = megabytes_from_env( "AHAB_SPILL_MB", spill_megabytes );
+
+    try {
+      pool->set_spill( new SpillCache( spill_file, spill_budget, stream_identity( file ),
+				       lowres, num_pictures, pool->get_frame_len(),
+				       pool->get_frame( 0 )->get_stride() ) );
+    } catch ( UnixError &e ) {
+      fprintf( stderr, "%s: %s; continuing without a spill file.\n",
+	       spill_file, strerror( e.err ) );
+    }
+  }
+
   /* Count up duration in seconds */
   duration_numer = 0;
   duration_denom = 2 * seq->get_frame_rate_numerator();
@@ -80,6 +163,10 @@ ES::ES( File *s_file, void (*progress)( off_t size, off_t location ) )
 
 ES::~ES()
 {
+  /* First, as the frame cache's compressor may still be filing copies
+     with the pictures' handles */
+  delete pool;
+
   MPEGHeader *hdr = first_header;
   while ( hdr != NULL ) {
     MPEGHeader *next = hdr->get_next();
@@ -87,7 +174,6 @@ ES::~ES()
     hdr = next;
   }
 
-  delete pool;
   delete[] coded_picture;
   delete[] displayed_picture;
 }
@@ -160,3 +246,24 @@ void ES::number_pictures( void )
     }
   }
 }
+
+/* Nearest I picture at or before display number n (or the first one
+   after, if the stream does not start with one) */
+Picture *ES::get_intra_displayed( uint n )
+{
+  ahabassert( n < num_pictures );
+
+  for ( int i = n; i >= 0; i-- ) {
+    if ( displayed_picture[ i ]->get_type() == I ) {
+      return displayed_picture[ i ];
+    }
+  }
+
+  for ( uint i = n + 1; i < num_pictures; i++ ) {
+    if ( displayed_picture[ i ]->get_type() == I ) {
+      return displayed_picture[ i ];
+    }
+  }
+
+  return displayed_picture[ n ];
+}
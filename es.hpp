@@ -44,7 +44,7 @@ private:
   BufferPool *pool;
 
 public:
-  ES( File *s_file, void (*progress)( off_t size, off_t location ) );
+  ES( File *s_file, void (*progress)( off_t size, off_t location ), uint lowres );
   ~ES();
 
   uint get_num_pictures( void ) { return num_pictures; }
@@ -52,6 +52,7 @@ public:
 
   Picture *get_picture_displayed( uint n ) { ahabassert( n < num_pictures ); return displayed_picture[ n ]; }
   Picture *get_picture_coded( uint n ) { ahabassert( n < num_pictures ); return coded_picture[ n ]; }
+  Picture *get_intra_displayed( uint n );
 
   Sequence *get_sequence( void ) { return seq; }
   File *get_file( void ) { return file; }
@@ -0,0 +1,382 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/uio.h>
+
+#include "libmpeg2.h"
+
+#include "file.hpp"
+#include "es.hpp"
+#include "mpegheader.hpp"
+#include "exceptions.hpp"
+#include "framebuffer.hpp"
+#include "picture.hpp"
+#include "decodeengine.hpp"
+#include "batchdecoder.hpp"
+
+void progress_bar( off_t, off_t ) {}
+
+static double now( void )
+{
+  struct timespec ts;
+  unixassert( clock_gettime( CLOCK_MONOTONIC, &ts ) );
+  return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+/* Gathers rows into writev() calls straight from the frame buffers.
+   O_DIRECT wants aligned buffers and lengths, so in that mode the rows
+   are staged in an aligned bounce buffer instead. */
+class OutputFile
+{
+private:
+  static const size_t stage_alignment = 4096;
+  static const size_t stage_size = 4 << 20;
+
+  int fd;
+  bool direct;
+
+  struct iovec iov[ IOV_MAX ];
+  int iovcnt;
+
+  uint8_t *stage;
+  size_t stage_len;
+
+  uint64_t bytes;
+  double io_secs;
+
+  void write_iov( struct iovec *vec, int cnt );
+  void write_stage( size_t len );
+
+public:
+  OutputFile( const char *filename, bool s_direct );
+  ~OutputFile();
+
+  void add( const void *buf, size_t len );
+  void flush( void );
+  void finish( void );
+
+  uint64_t get_bytes( void ) { return bytes; }
+  double get_io_secs( void ) { return io_secs; }
+};
+
+OutputFile::OutputFile( const char *filename, bool s_direct )
+  : fd( -1 ), direct( s_direct ), iovcnt( 0 ),
+    stage( NULL ), stage_len( 0 ), bytes( 0 ), io_secs( 0 )
+{
+  if ( strcmp( filename, "-" ) == 0 ) {
+    fd = STDOUT_FILENO;
+    direct = false;
+  } else {
+    fd = open( filename, O_WRONLY | O_CREAT | O_TRUNC | (direct ? O_DIRECT : 0), 0666 );
+    if ( fd < 0 ) {
+      perror( "open" );
+      throw UnixError( errno );
+    }
+  }
+
+  if ( direct ) {
+    unixassert( posix_memalign( (void **)&stage, stage_alignment, stage_size ) );
+  }
+}
+
+OutputFile::~OutputFile()
+{
+  if ( stage ) {
+    free( stage );
+  }
+
+  if ( (fd != STDOUT_FILENO) && (close( fd ) < 0) ) {
+    perror( "close" );
+  }
+}
+
+void OutputFile::write_iov( struct iovec *vec, int cnt )
+{
+  double start = now();
+
+  while ( cnt > 0 ) {
+    ssize_t written = writev( fd, vec, cnt );
+    if ( written < 0 ) {
+      if ( errno == EINTR ) continue;
+      perror( "writev" );
+      throw UnixError( errno );
+    }
+
+    bytes += written;
+
+    /* Skip past whatever made it out */
+    while ( (cnt > 0) && ((size_t)written >= vec->iov_len) ) {
+      written -= vec->iov_len;
+      vec++;
+      cnt--;
+    }
+
+    if ( cnt > 0 ) {
+      vec->iov_base = (uint8_t *)vec->iov_base + written;
+      vec->iov_len -= written;
+    }
+  }
+
+  io_secs += now() - start;
+}
+
+void OutputFile::write_stage( size_t len )
+{
+  struct iovec vec;
+  vec.iov_base = stage;
+  vec.iov_len = len;
+  write_iov( &vec, 1 );
+
+  memmove( stage, stage + len, stage_len - len );
+  stage_len -= len;
+}
+
+void OutputFile::add( const void *buf, size_t len )
+{
+  if ( !direct ) {
+    if ( iovcnt == IOV_MAX ) {
+      write_iov( iov, iovcnt );
+      iovcnt = 0;
+    }
+
+    iov[ iovcnt ].iov_base = (void *)buf;
+    iov[ iovcnt ].iov_len = len;
+    iovcnt++;
+    return;
+  }
+
+  while ( len > 0 ) {
+    size_t amount = stage_size - stage_len;
+    if ( amount > len ) {
+      amount = len;
+    }
+
+    memcpy( stage + stage_len, buf, amount );
+    stage_len += amount;
+    buf = (const uint8_t *)buf + amount;
+    len -= amount;
+
+    if ( stage_len == stage_size ) {
+      write_stage( stage_size );
+    }
+  }
+}
+
+void OutputFile::flush( void )
+{
+  if ( !direct ) {
+    write_iov( iov, iovcnt );
+    iovcnt = 0;
+    return;
+  }
+
+  /* Write out whole aligned blocks; the rest waits for more data */
+  write_stage( stage_len & ~(stage_alignment - 1) );
+}
+
+void OutputFile::finish( void )
+{
+  flush();
+
+  if ( direct && stage_len ) {
+    /* Whatever is left over is not a whole number of blocks */
+    int flags = fcntl( fd, F_GETFL );
+    if ( (flags < 0) || (fcntl( fd, F_SETFL, flags & ~O_DIRECT ) < 0) ) {
+      perror( "fcntl" );
+      throw UnixError( errno );
+    }
+
+    write_stage( stage_len );
+  }
+}
+
+class FrameWriter : public FrameSink
+{
+private:
+  OutputFile *out;
+  bool y4m;
+
+  uint luma_width, luma_height, chroma_width, chroma_height;
+
+public:
+  FrameWriter( OutputFile *s_out, bool s_y4m, Sequence *seq, uint scale );
+
+  void deliver( Picture *picture, Frame *frame );
+  void write( uint8_t *y, uint8_t *cb, uint8_t *cr, uint stride );
+};
+
+/* Pictures are written at 1/scale size in each dimension */
+FrameWriter::FrameWriter( OutputFile *s_out, bool s_y4m, Sequence *seq, uint scale )
+  : out( s_out ), y4m( s_y4m )
+{
+  luma_width = (seq->get_horizontal_size() + scale - 1) / scale;
+  luma_height = (seq->get_vertical_size() + scale - 1) / scale;
+  chroma_width = (luma_width + 1) / 2;
+  chroma_height = (luma_height + 1) / 2;
+
+  if ( y4m ) {
+    uint64_t sar_n = 1, sar_d = 1;
+
+    switch ( seq->get_aspect() ) {
+    case Sequence::SAR1x1: break;
+    case Sequence::DAR4x3: sar_n = 4 * luma_height; sar_d = 3 * luma_width; break;
+    case Sequence::DAR16x9: sar_n = 16 * luma_height; sar_d = 9 * luma_width; break;
+    case Sequence::DAR221x100: sar_n = 221 * luma_height; sar_d = 100 * luma_width; break;
+    }
+
+    uint64_t a = sar_n, b = sar_d;
+    while ( b ) {
+      uint64_t t = a % b;
+      a = b;
+      b = t;
+    }
+
+    /* add() may only keep a pointer to it until the flush below */
+    char header[ 256 ];
+    snprintf( header, sizeof( header ), "YUV4MPEG2 W%u H%u F%llu:%llu I%c A%llu:%llu C420mpeg2\n",
+	      luma_width, luma_height,
+	      (unsigned long long)seq->get_frame_rate_numerator(),
+	      (unsigned long long)seq->get_frame_rate_denominator(),
+	      seq->get_progressive_sequence() ? 'p' : '?',
+	      (unsigned long long)(sar_n / a), (unsigned long long)(sar_d / a) );
+
+    out->add( header, strlen( header ) );
+    out->flush();
+  }
+}
+
+void FrameWriter::deliver( Picture *, Frame *frame )
+{
+  write( frame->get_y(), frame->get_cb(), frame->get_cr(), frame->get_stride() );
+
+  /* The frame is released when we return */
+}
+
+/* stride is that of the luma plane; the chroma planes use half of it */
+void FrameWriter::write( uint8_t *y, uint8_t *cb, uint8_t *cr, uint stride )
+{
+  static const char frame_header[] = "FRAME\n";
+
+  if ( y4m ) {
+    out->add( frame_header, strlen( frame_header ) );
+  }
+
+  for ( uint row = 0; row < luma_height; row++ ) {
+    out->add( y + row * stride, luma_width );
+  }
+
+  for ( uint row = 0; row < chroma_height; row++ ) {
+    out->add( cb + row * stride / 2, chroma_width );
+  }
+
+  for ( uint row = 0; row < chroma_height; row++ ) {
+    out->add( cr + row * stride / 2, chroma_width );
+  }
+
+  out->flush();
+}
+
+int main( int argc, char *argv[] )
+{
+  bool y4m = true;
+  bool direct = false;
+  bool dc_only = false;
+  int window = 8;
+  int lowres = 0;
+
+  int opt;
+  while ( (opt = getopt( argc, argv, "rdsw:l:" )) != -1 ) {
+    switch ( opt ) {
+    case 'r': y4m = false; break;
+    case 'd': direct = true; break;
+    case 's': dc_only = true; break;
+    case 'w': window = atoi( optarg ); break;
+    case 'l': lowres = atoi( optarg ); break;
+    default: argc = 0; break;
+    }
+  }
+
+  int args = argc - optind;
+  if ( (args < 2) || (args > 4) || (lowres < 0) || (lowres > 2) ) {
+    fprintf( stderr, "USAGE: %s [-r] [-d] [-s] [-w WINDOW] [-l LOWRES] FILENAME OUTPUT [FIRST [LAST]]\n", argv[ 0 ] );
+    fprintf( stderr, "  -r  write raw planar 4:2:0 instead of YUV4MPEG2\n" );
+    fprintf( stderr, "  -d  open OUTPUT with O_DIRECT\n" );
+    fprintf( stderr, "  -s  write 1/8-scale thumbnails of the I pictures, from their DC coefficients only\n" );
+    fprintf( stderr, "  -w  number of pictures to decode in flight (default 8)\n" );
+    fprintf( stderr, "  -l  decode at 1/2 (1) or 1/4 (2) resolution\n" );
+    fprintf( stderr, "OUTPUT may be - for standard output. FIRST and LAST are display numbers.\n" );
+    exit( 1 );
+  }
+
+  File *file = new File( argv[ optind ] );
+  ES *stream = new ES( file, &progress_bar, dc_only ? 0 : lowres );
+
+  uint first = 0;
+  uint last = stream->get_num_pictures();
+
+  if ( args >= 3 ) {
+    first = atoi( argv[ optind + 2 ] );
+  }
+  if ( args == 4 ) {
+    last = atoi( argv[ optind + 3 ] ) + 1;
+  }
+
+  if ( (first >= last) || (last > stream->get_num_pictures()) ) {
+    fprintf( stderr, "Invalid range (stream has %d pictures).\n",
+	     stream->get_num_pictures() );
+    exit( 1 );
+  }
+
+  OutputFile *out = new OutputFile( argv[ optind + 1 ], direct );
+  FrameWriter writer( out, y4m, stream->get_sequence(), dc_only ? 8 : (1 << lowres) );
+
+  double start = now();
+  uint count = last - first;
+
+  if ( dc_only ) {
+    uint stride = 2 * stream->get_sequence()->get_mb_width();
+    uint luma_size = 2 * stride * stream->get_sequence()->get_mb_height();
+    uint8_t *planes = new uint8_t[ luma_size + luma_size / 2 ];
+    uint8_t *y = planes, *cb = planes + luma_size, *cr = cb + luma_size / 4;
+
+    count = 0;
+    for ( uint i = first; i < last; i++ ) {
+      Picture *pic = stream->get_picture_displayed( i );
+      if ( pic->get_type() != I ) continue;
+
+      pic->decode_dc_only( y, cb, cr );
+      writer.write( y, cb, cr, stride );
+      count++;
+    }
+
+    delete[] planes;
+  } else {
+    /* the engine joins its workers when it goes, so no cleanup job
+       can still be running once the stream is deleted below */
+    DecodeEngine engine;
+    BatchDecoder batch( stream, &engine, window );
+    batch.decode( first, last, &writer );
+  }
+
+  out->finish();
+
+  double secs = now() - start;
+  double megabytes = out->get_bytes() / 1048576.0;
+
+  fprintf( stderr, "%d pictures in %.3f s = %.3f pics per second\n",
+	   count, secs, count / secs );
+  fprintf( stderr, "%.1f MiB written = %.1f MiB/s (%.1f MiB/s while writing, %.0f%% of time)\n",
+	   megabytes, megabytes / secs, megabytes / out->get_io_secs(),
+	   100.0 * out->get_io_secs() / secs );
+
+  delete out;
+
+  delete stream;
+  delete file;
+
+  return 0;
+}
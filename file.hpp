@@ -35,6 +35,7 @@ public:
 
   MapHandle *map( off_t offset, size_t len );
   off_t get_filesize( void ) { return filesize; }
+  int get_fd( void ) { return fd; }
 };
 
 #endif
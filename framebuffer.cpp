@@ -1,55 +1,109 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/mman.h>
+
 #include "framebuffer.hpp"
 #include "mutexobj.hpp"
 #include "picture.hpp"
-#include "framequeue.hpp"
 
-BufferPool::BufferPool( uint s_num_frames, uint mb_width, uint mb_height )
-  : free( 0 ), freeable( 0 )
+static const uint stride_alignment = 128;
+static const size_t huge_page_size = 2 << 20;
+
+/* Frame buffers are mapped anonymously, so planes start page aligned.
+   The kernel is asked to back them with transparent huge pages; with
+   AHAB_HUGEPAGES set in the environment they are first taken from the
+   reserved huge page pool (vm.nr_hugepages) instead. Either way a
+   1080-line frame needs two TLB entries rather than hundreds. */
+static uint8_t *map_frame( size_t len, size_t *map_len )
+{
+  static bool hugetlb_failed = false;
+  void *buf;
+
+  if ( getenv( "AHAB_HUGEPAGES" ) && !hugetlb_failed ) {
+    *map_len = (len + huge_page_size - 1) & ~(huge_page_size - 1);
+    buf = mmap( NULL, *map_len, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+    if ( buf != MAP_FAILED ) {
+      return (uint8_t *)buf;
+    }
+
+    hugetlb_failed = true;
+    fprintf( stderr, "AHAB_HUGEPAGES: no huge pages reserved, using normal pages.\n" );
+  }
+
+  *map_len = len;
+  buf = mmap( NULL, *map_len, PROT_READ | PROT_WRITE,
+	      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+  if ( buf == MAP_FAILED ) {
+    perror( "mmap" );
+    throw UnixError( errno );
+  }
+
+  /* Only a hint; kernels without THP refuse it */
+  madvise( buf, *map_len, MADV_HUGEPAGE );
+
+  return (uint8_t *)buf;
+}
+
+BufferPool::BufferPool( uint s_num_frames, uint mb_width, uint mb_height, uint s_lowres,
+			size_t cache_budget )
+  : free(), freeable()
 {
   num_frames = s_num_frames;
-  width = 16 * mb_width;
-  height = 16 * mb_height;
+  lowres = s_lowres;
+  width = (16 * mb_width) >> lowres;
+  height = (16 * mb_height) >> lowres;
 
   frames = new Frame *[ num_frames ];
   for ( uint i = 0; i < num_frames; i++ ) {
-    frames[ i ] = new Frame( this, mb_width, mb_height );
-    free.enqueue( frames[ i ] );
+    frames[ i ] = new Frame( this, mb_width, mb_height, lowres );
+    free.push_back( frames[ i ] );
   }
 
   unixassert( pthread_mutex_init( &mutex, NULL ) );
   unixassert( pthread_cond_init( &activity, NULL ) );
+  unixassert( pthread_cond_init( &restores, NULL ) );
+
+  cache = new FrameCache( cache_budget, frames[ 0 ]->get_stride(), height, &mutex );
+  spill = NULL;
 }
 
-BufferPool::~BufferPool()
+/* Bytes in a frame's three planes, which are contiguous */
+size_t BufferPool::get_frame_len( void )
 {
-  Frame *frame;
-
-  do {
-    frame = free.dequeue( false );
-  } while ( frame );
-
-  do {
-    frame = freeable.dequeue( false );
-  } while ( frame );
+  return 3 * frames[ 0 ]->get_stride() * frames[ 0 ]->get_height() / 2;
+}
 
+BufferPool::~BufferPool()
+{
   for ( uint i = 0; i < num_frames; i++ ) {
-    frame = frames[ i ];
-    delete frame;
+    delete frames[ i ];
   }
   delete[] frames;
 
+  delete cache;
+  delete spill;
+
+  unixassert( pthread_cond_destroy( &restores ) );
   unixassert( pthread_cond_destroy( &activity ) );
   unixassert( pthread_mutex_destroy( &mutex ) );
 }
 
-Frame::Frame( BufferPool *s_pool, uint mb_width, uint mb_height )
+Frame::Frame( BufferPool *s_pool, uint mb_width, uint s_mb_height, uint s_lowres )
 {
   pool = s_pool;
-  width = 16 * mb_width;
-  height = 16 * mb_height;
-  buf = new uint8_t[ sizeof( uint8_t ) * (3 * width * height / 2) ];
-  state = FREE;
+  mb_height = s_mb_height;
+  lowres = s_lowres;
+  width = (16 * mb_width) >> lowres;
+  height = (16 * mb_height) >> lowres;
+  stride = (width + stride_alignment - 1) & ~(stride_alignment - 1);
+  buf = map_frame( 3 * stride * height / 2, &buf_len );
+  gl_buffer = 0;
+  fence = NULL;
+  set_state( FREE );
   handle = NULL;
+  prev = next = NULL;
+  unixassert( pthread_mutex_init( &mutex, NULL ) );
   unixassert( pthread_cond_init( &activity, NULL ) );
 
   slicerow = new SliceRow *[ mb_height ];
@@ -61,51 +115,90 @@ Frame::Frame( BufferPool *s_pool, uint mb_width, uint mb_height )
 
 Frame::~Frame()
 {
-  delete[] buf;
+  if ( (!gl_buffer) && (munmap( buf, buf_len ) < 0) ) {
+    perror( "munmap" );
+  }
 
-  for ( uint i = 0; i < height / 16; i++ ) {
+  for ( uint i = 0; i < mb_height; i++ ) {
     delete slicerow[ i ];
   }
 
   delete[] slicerow;
 
   unixassert( pthread_cond_destroy( &activity ) );
+  unixassert( pthread_mutex_destroy( &mutex ) );
+}
+
+/* Mid-gray in all three planes, for pictures that cannot be decoded */
+void Frame::clear( void )
+{
+  memset( buf, 128, 3 * stride * height / 2 );
+}
+
+void Frame::use_buffer( uint8_t *s_buf, uint s_gl_buffer )
+{
+  ahabassert( (get_state() == FREE) && !gl_buffer );
+
+  if ( munmap( buf, buf_len ) < 0 ) {
+    perror( "munmap" );
+  }
+
+  buf = s_buf;
+  gl_buffer = s_gl_buffer;
 }
 
 void Frame::lock( FrameHandle *s_handle,
-		  int f_code_fv, int f_code_bv,
+		  int f_code_fv, int f_code_bv, bool field_motion,
 		  Picture *forward, Picture *backward )
 {
   ahabassert( handle == NULL );
   ahabassert( state == FREE );
+  ahabassert( fence == NULL );
   handle = s_handle;
-  state = LOCKED;
+  set_state( LOCKED );
 
-  for ( uint i = 0; i < height / 16; i++ ) {
-    slicerow[ i ]->init( f_code_fv, f_code_bv, forward, backward );
+  for ( uint i = 0; i < mb_height; i++ ) {
+    slicerow[ i ]->init( f_code_fv, f_code_bv, field_motion, forward, backward );
   }
 }
 
+/* The decoder holds a lock on the frame, so no pool transition can
+   race with this; only the frame's own waiters need to hear of it */
 void Frame::set_rendered( void )
 {
-  MutexLock x( pool->get_mutex() );
+  MutexLock x( &mutex );
 
   ahabassert( state == LOCKED );
-  state = RENDERED;
-  pthread_cond_broadcast( &activity );
+  set_state( RENDERED );
+  unixassert( pthread_cond_broadcast( &activity ) );
 }
 
+/* Nobody can be waiting on a freeable frame, as waiters hold locks */
 void Frame::relock( void )
 {
   ahabassert( state == FREEABLE );
-  state = RENDERED;
-  pthread_cond_broadcast( &activity );
+  set_state( RENDERED );
+}
+
+/* Contents came back from the frame cache or the spill file; the pool
+   mutex is held */
+void Frame::set_restored( void )
+{
+  ahabassert( state == LOCKED );
+
+  for ( uint i = 0; i < mb_height; i++ ) {
+    slicerow[ i ]->set_rendered();
+  }
+
+  MutexLock x( &mutex );
+  set_state( RENDERED );
+  unixassert( pthread_cond_broadcast( &activity ) );
 }
 
 void Frame::set_freeable( void )
 {
   ahabassert( state == RENDERED );
-  state = FREEABLE;
+  set_state( FREEABLE );
 }
 
 void Frame::free_locked( void )
@@ -113,7 +206,7 @@ void Frame::free_locked( void )
   ahabassert( state == LOCKED );
   /* handle->set_frame( NULL ); */ /* handle takes care of this */
   handle = NULL;
-  state = FREE;
+  set_state( FREE );
 }
 
 void Frame::free( void )
@@ -121,7 +214,7 @@ void Frame::free( void )
   ahabassert( state == FREEABLE );
   handle->set_frame( NULL );
   handle = NULL;
-  state = FREE;
+  set_state( FREE );
 }
 
 FrameHandle::FrameHandle( BufferPool *s_pool, Picture *s_pic )
@@ -130,52 +223,157 @@ FrameHandle::FrameHandle( BufferPool *s_pool, Picture *s_pic )
   pic = s_pic;
   frame = NULL;
   locks = 0;
-  unixassert( pthread_cond_init( &activity, NULL ) );
+  restoring = false;
+  cached = NULL;
 }
 
 FrameHandle::~FrameHandle()
 {
-  unixassert( pthread_cond_destroy( &activity ) );
+}
+
+/* A lock count changes without the pool mutex as long as it stays
+   above zero. Taking the first lock or dropping the last one moves the
+   frame on or off the pool's lists, and that takes the mutex; locks
+   never goes from zero to one anywhere else. */
+bool FrameHandle::try_increment( void )
+{
+  int n = __atomic_load_n( &locks, __ATOMIC_RELAXED );
+
+  while ( n > 0 ) {
+    if ( __atomic_compare_exchange_n( &locks, &n, n + 1, true,
+				      __ATOMIC_ACQUIRE, __ATOMIC_RELAXED ) ) {
+      return true;
+    }
+  }
+
+  return false;
 }
 
 void FrameHandle::increment_lockcount( void )
 {
+  if ( try_increment() ) {
+    return;
+  }
+
   MutexLock x( pool->get_mutex() );
 
+  while ( restoring ) {
+    pool->wait_restore();
+  }
+
   if ( frame ) {
-    if ( locks == 0 ) {
+    if ( get_lockcount() == 0 ) {
       ahabassert( frame->get_state() == FREEABLE );
       pool->remove_from_freeable( frame );
       frame->relock();
     }
-    locks++;
   } else {
-    ahabassert( locks == 0 );
-    while ( (frame = pool->get_free_frame()) == NULL ) {
-      pool->wait();
+    attach_frame();
+  }
+
+  __atomic_add_fetch( &locks, 1, __ATOMIC_ACQ_REL );
+}
+
+/* Gives the handle a frame, restored from the frame cache or the spill
+   file if either has a copy. Returns false if the frame still has to
+   be decoded.
+
+   The frame's old picture is copied to the frame cache and the spill
+   file, and the new one copied back from either, with the pool mutex
+   let go. The frame is off the pool's lists and LOCKED, with no locks
+   counted, so nobody else can take it or the handle without the
+   mutex, and with it they wait for restoring to clear. */
+bool FrameHandle::attach_frame( void )
+{
+  ahabassert( get_lockcount() == 0 );
+  ahabassert( !restoring );
+  Frame *new_frame;
+  FrameHandle *previous;
+  while ( (new_frame = pool->get_free_frame( &previous )) == NULL ) {
+    pool->wait();
+  }
+
+  FrameCache *cache = pool->get_cache();
+  SpillCache *spill = pool->get_spill();
+  CachedFrame *staged = previous ? cache->stage( previous ) : NULL;
+
+  frame = new_frame;
+  frame->lock( this, pic->get_f_code_fv(), pic->get_f_code_bv(), pic->get_field_motion(),
+	       pic->get_forward(), pic->get_backward() );
+
+  bool restored;
+  restoring = true;
+  {
+    MutexUnlock x( pool->get_mutex() );
+
+    if ( staged ) {
+      cache->file( staged, frame );
+    }
+    if ( previous && spill ) {
+      spill->store( previous->get_picture(), frame );
     }
-    frame->lock( this, pic->get_f_code_fv(), pic->get_f_code_bv(),
-		 pic->get_forward(), pic->get_backward() );
-    locks++;
-    pthread_cond_broadcast( &activity );
+
+    restored = cache->restore( this, frame ) || (spill && spill->restore( pic, frame ));
+  }
+
+  if ( restored ) {
+    frame->set_restored();
   }
+
+  restoring = false;
+  pool->restore_done();
+
+  return restored;
+}
+
+bool FrameHandle::has_copy( void )
+{
+  return cached || (pool->get_spill() && pool->get_spill()->contains( pic ));
 }
 
 bool FrameHandle::increment_lockcount_if_renderable( void )
 {
+  /* Locked already: the frame stays put while we hold our lock, but
+     it may not be rendered yet */
+  if ( try_increment() ) {
+    if ( frame->get_state() == RENDERED ) {
+      return true;
+    }
+    decrement_lockcount();
+    return false;
+  }
+
   MutexLock x( pool->get_mutex() );
 
-  if ( !frame ) return false;
+  while ( restoring ) {
+    pool->wait_restore();
+  }
+
+  if ( !frame ) {
+    if ( !has_copy() ) return false;
+
+    if ( !attach_frame() ) {
+      /* The copy was evicted while we waited for a frame */
+      pool->make_free( frame );
+      frame->free_locked();
+      frame = NULL;
+      pool->signal();
+      return false;
+    }
+
+    __atomic_add_fetch( &locks, 1, __ATOMIC_ACQ_REL );
+    return true;
+  }
 
-  if ( locks == 0 ) {
+  if ( get_lockcount() == 0 ) {
     ahabassert( frame->get_state() == FREEABLE );
     pool->remove_from_freeable( frame );
     frame->relock();
     ahabassert( frame->get_state() == RENDERED );
-    locks++;
+    __atomic_add_fetch( &locks, 1, __ATOMIC_ACQ_REL );
     return true;
   } else if ( frame->get_state() == RENDERED ) {
-    locks++;
+    __atomic_add_fetch( &locks, 1, __ATOMIC_ACQ_REL );
     return true;
   }
 
@@ -184,11 +382,20 @@ bool FrameHandle::increment_lockcount_if_renderable( void )
 
 void FrameHandle::decrement_lockcount( void )
 {
+  int n = __atomic_load_n( &locks, __ATOMIC_RELAXED );
+
+  while ( n > 1 ) {
+    if ( __atomic_compare_exchange_n( &locks, &n, n - 1, true,
+				      __ATOMIC_RELEASE, __ATOMIC_RELAXED ) ) {
+      return;
+    }
+  }
+
   MutexLock x( pool->get_mutex() );
 
-  ahabassert( locks > 0 );
-  locks--;
-  if ( locks == 0 ) {
+  /* Someone may have taken another lock since we looked */
+  ahabassert( get_lockcount() > 0 );
+  if ( __atomic_sub_fetch( &locks, 1, __ATOMIC_ACQ_REL ) == 0 ) {
     if ( frame->get_state() == RENDERED ) {
       pool->make_freeable( frame );
       frame->set_freeable();
@@ -204,15 +411,21 @@ void FrameHandle::decrement_lockcount( void )
   }
 }
 
-Frame *BufferPool::get_free_frame( void )
+/* Sets previous to the handle whose picture a freeable frame still
+   holds, so the caller can keep a copy before reusing it */
+Frame *BufferPool::get_free_frame( FrameHandle **previous )
 {
-  Frame *first_free = free.dequeue( false );
+  *previous = NULL;
+
+  Frame *first_free = free.pop_front();
   if ( first_free ) {
     return first_free;
   }
 
-  Frame *first_freeable = freeable.dequeue( false );
+  /* Frames the GPU may still be reading from wait their turn */
+  Frame *first_freeable = freeable.pop_first_unfenced();
   if ( first_freeable ) {
+    *previous = first_freeable->get_handle();
     first_freeable->free();
     return first_freeable;
   } else {
@@ -222,41 +435,112 @@ Frame *BufferPool::get_free_frame( void )
 
 void BufferPool::make_freeable( Frame *frame )
 {
-  frame->set_element( freeable.enqueue( frame ) );
+  freeable.push_back( frame );
 }
 
 void BufferPool::make_free( Frame *frame )
 {
-  free.enqueue( frame );
+  free.push_back( frame );
 }
 
 void BufferPool::remove_from_freeable( Frame *frame )
 {
-  freeable.remove_specific( frame->get_element() );
+  freeable.remove( frame );
+}
+
+/* From the display thread, which is the only one that can wait on the
+   fence. A decoder may be waiting for just this frame. */
+void BufferPool::fence_passed( Frame *frame )
+{
+  MutexLock x( &mutex );
+  frame->set_fence( NULL );
+  signal();
+}
+
+void FrameList::push_back( Frame *frame )
+{
+  frame->prev = tail;
+  frame->next = NULL;
+
+  if ( tail ) {
+    tail->next = frame;
+  } else {
+    head = frame;
+  }
+  tail = frame;
+
+  count++;
+}
+
+Frame *FrameList::pop_front( void )
+{
+  Frame *frame = head;
+
+  if ( frame ) {
+    remove( frame );
+  }
+
+  return frame;
+}
+
+/* The oldest frame the display isn't loading textures from */
+Frame *FrameList::pop_first_unfenced( void )
+{
+  for ( Frame *frame = head; frame; frame = frame->next ) {
+    if ( !frame->fence ) {
+      remove( frame );
+      return frame;
+    }
+  }
+
+  return NULL;
+}
+
+void FrameList::remove( Frame *frame )
+{
+  ahabassert( count > 0 );
+
+  if ( frame->prev ) {
+    frame->prev->next = frame->next;
+  } else {
+    ahabassert( head == frame );
+    head = frame->next;
+  }
+
+  if ( frame->next ) {
+    frame->next->prev = frame->prev;
+  } else {
+    ahabassert( tail == frame );
+    tail = frame->prev;
+  }
+
+  frame->prev = frame->next = NULL;
+  count--;
 }
 
 void FrameHandle::set_frame( Frame *s_frame )
 {
-  ahabassert( locks == 0 );
+  ahabassert( get_lockcount() == 0 );
   frame = s_frame;
-  pthread_cond_broadcast( &activity );
 }
 
 void Frame::wait_rendered( void )
 {
+  if ( get_state() == RENDERED ) {
+    return;
+  }
+
+  MutexLock x( &mutex );
+
   while ( state != RENDERED ) {
-    pthread_cond_wait( &activity, pool->get_mutex() );
+    unixassert( pthread_cond_wait( &activity, &mutex ) );
   }
 }
 
+/* The caller holds a lock, so the frame can't be taken away while we
+   wait, and only this frame's rendering wakes us */
 void FrameHandle::wait_rendered( void )
 {
-  MutexLock x( pool->get_mutex() );
-
-  while ( !frame ) {
-    pthread_cond_wait( &activity, pool->get_mutex() );
-  }
-  /* now we have a frame and our mutex is locked so it can't be taken away */
-
+  ahabassert( get_lockcount() > 0 );
   frame->wait_rendered();
 }
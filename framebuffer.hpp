@@ -5,6 +5,8 @@
 #include "exceptions.hpp"
 #include "slicerow.hpp"
 #include "opq.hpp"
+#include "framecache.hpp"
+#include "spillcache.hpp"
 
 #include <stdint.h>
 #include <pthread.h>
@@ -12,6 +14,27 @@
 class Frame;
 class BufferPool;
 
+/* Doubly-linked list of frames through their own prev and next
+   pointers, oldest first. A frame is on at most one list at a time,
+   and the pool mutex protects them all, so nothing here allocates or
+   locks. */
+class FrameList
+{
+private:
+  Frame *head, *tail;
+  int count;
+
+public:
+  FrameList() : head( NULL ), tail( NULL ), count( 0 ) {}
+
+  void push_back( Frame *frame );
+  Frame *pop_front( void );
+  Frame *pop_first_unfenced( void );
+  void remove( Frame *frame );
+
+  int get_count( void ) { return count; }
+};
+
 class FrameHandle
 {
   friend class Frame;
@@ -21,10 +44,14 @@ private:
   Picture *pic;
   Frame *frame;
   int locks;
+  bool restoring; /* attach_frame() is copying into the frame */
 
-  pthread_cond_t activity;
+  CachedFrame *cached;
 
   void set_frame( Frame *s_frame );
+  bool attach_frame( void );
+  bool try_increment( void );
+  bool has_copy( void );
 
 public:
   void increment_lockcount( void );
@@ -32,9 +59,14 @@ public:
 
   bool increment_lockcount_if_renderable( void );
 
+  int get_lockcount( void ) { return __atomic_load_n( &locks, __ATOMIC_ACQUIRE ); }
+
   Frame *get_frame( void ) { ahabassert( frame ); return frame; }
   Picture *get_picture( void ) { ahabassert( pic ); return pic; }
 
+  CachedFrame *get_cached( void ) { return cached; }
+  void set_cached( CachedFrame *s_cached ) { cached = s_cached; }
+
   FrameHandle( BufferPool *s_pool, Picture *s_pic );
   ~FrameHandle();
 
@@ -44,24 +76,37 @@ public:
 class BufferPool
 {
 private:
-  uint num_frames, width, height;
+  uint num_frames, width, height, lowres;
   Frame **frames;
 
-  Queue<Frame> free;
-  Queue<Frame> freeable;
+  FrameList free;
+  FrameList freeable;
+
+  FrameCache *cache;
+  SpillCache *spill;
 
   pthread_mutex_t mutex;
   pthread_cond_t activity;
+  pthread_cond_t restores;
 
 public:
-  BufferPool( uint s_num_frames, uint mb_width, uint mb_height );
+  BufferPool( uint s_num_frames, uint mb_width, uint mb_height, uint s_lowres,
+	      size_t cache_budget );
   ~BufferPool();
 
   FrameHandle *make_handle( Picture *pic ) { return new FrameHandle( this, pic ); }
-  Frame *get_free_frame( void );
+  uint get_num_frames( void ) { return num_frames; }
+  Frame *get_frame( uint i ) { ahabassert( i < num_frames ); return frames[ i ]; }
+  uint get_lowres( void ) { return lowres; }
+  size_t get_frame_len( void );
+  FrameCache *get_cache( void ) { return cache; }
+  SpillCache *get_spill( void ) { return spill; }
+  void set_spill( SpillCache *s_spill ) { spill = s_spill; }
+  Frame *get_free_frame( FrameHandle **previous );
   void make_freeable( Frame *frame );
   void make_free( Frame *frame );
   void remove_from_freeable( Frame *frame );
+  void fence_passed( Frame *frame );
 
   pthread_mutex_t *get_mutex( void ) { return &mutex; }
 
@@ -71,62 +116,104 @@ public:
 	     free.get_count(), freeable.get_count() );
   }
 
+  /* A frame became free or freeable: enough for one waiter */
   void signal( void ) {
-    unixassert( pthread_cond_broadcast( &activity ) );
+    unixassert( pthread_cond_signal( &activity ) );
   }
 
   void wait( void ) {
     unixassert( pthread_cond_wait( &activity, &mutex ) );
   }
+
+  /* A handle is done restoring, one way or the other: for all who
+     wait on one, so apart from those waiting for a frame */
+  void restore_done( void ) {
+    unixassert( pthread_cond_broadcast( &restores ) );
+  }
+
+  void wait_restore( void ) {
+    unixassert( pthread_cond_wait( &restores, &mutex ) );
+  }
 };
 
 enum FrameState { FREE, LOCKED, RENDERED, FREEABLE };
 
 class Frame
 {
+  friend class FrameList;
+
 private:
   BufferPool *pool;
 
-  uint width, height;
+  uint width, height, mb_height, lowres;
+  uint stride;
   uint8_t *buf;
+  size_t buf_len;
+  uint gl_buffer; /* GL buffer object buf is mapped from, else 0 */
+  void *fence;    /* the display's GLsync, while textures load from buf */
   FrameState state;
 
   FrameHandle *handle;
 
   Frame *prev, *next;
 
+  /* for waiting on rendering, apart from the pool mutex */
+  pthread_mutex_t mutex;
   pthread_cond_t activity;
 
   SliceRow **slicerow;
 
-  QueueElement<Frame> *queue_element;
+  void set_state( FrameState s_state ) { __atomic_store_n( &state, s_state, __ATOMIC_RELEASE ); }
 
 public:
-  Frame( BufferPool *s_pool, uint mb_width, uint mb_height );
+  Frame( BufferPool *s_pool, uint mb_width, uint s_mb_height, uint s_lowres );
   ~Frame();
 
-  uint8_t *get_buf( void ) { return buf; }
+  /* Planes are 1/2 or 1/4 size in each dimension when lowres is 1 or 2 */
+  uint get_width( void ) { return width; }
+  uint get_height( void ) { return height; }
+  uint get_lowres( void ) { return lowres; }
+
+  /* Rows are padded so that every row of every plane starts on a
+     cache line: the luma stride is a multiple of 128 bytes, and the
+     chroma planes use half of it. */
+  uint get_stride( void ) { return stride; }
+  uint get_uv_stride( void ) { return stride / 2; }
+
   uint8_t *get_y( void ) { return buf; }
-  uint8_t *get_cb( void ) { return buf + width * height; }
-  uint8_t *get_cr( void ) { return buf + width * height + width * height / 4; }
+  uint8_t *get_cb( void ) { return buf + stride * height; }
+  uint8_t *get_cr( void ) { return buf + stride * height + stride * height / 4; }
+
+  void clear( void );
+
+  /* Moves the planes into memory the display mapped for us, before
+     anything is decoded. The display owns the mapping from then on. */
+  void use_buffer( uint8_t *s_buf, uint s_gl_buffer );
+  uint get_gl_buffer( void ) { return gl_buffer; }
+
+  /* Set by the display while its lock keeps the frame off the pool's
+     lists, and cleared under the pool mutex; the pool won't hand the
+     frame out for another picture until then */
+  void set_fence( void *s_fence ) { fence = s_fence; }
+  void *get_fence( void ) { return fence; }
 
   void lock( FrameHandle *s_handle,
-	     int f_code_fv, int f_code_bv,
+	     int f_code_fv, int f_code_bv, bool field_motion,
 	     Picture *forward, Picture *backward );
   void set_rendered( void );
+  void set_restored( void );
   void set_freeable( void );
   void relock( void );
   void free( void );
   void free_locked( void );
 
-  FrameState get_state( void ) { return state; }
+  /* Read without the pool mutex by holders of a lock */
+  FrameState get_state( void ) { return __atomic_load_n( &state, __ATOMIC_ACQUIRE ); }
+  FrameHandle *get_handle( void ) { return handle; }
 
   void wait_rendered( void );
 
   SliceRow *get_slicerow( uint row ) { return slicerow[ row ]; }
-
-  void set_element( QueueElement<Frame> *s_element ) { queue_element = s_element; }
-  QueueElement<Frame> *get_element( void ) { return queue_element; }
 };
 
 #endif
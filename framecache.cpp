@@ -0,0 +1,471 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "framecache.hpp"
+#include "framebuffer.hpp"
+#include "picture.hpp"
+#include "mutexobj.hpp"
+#include "exceptions.hpp"
+
+static const uint max_buffers = 4;
+
+/* The codec works on groups of 16 pixels along each row. Every pixel
+   is predicted by the one above it (zero above the first row), and
+   the residual is zigzag-mapped so that small differences of either
+   sign become small numbers. A group is stored as one byte giving the
+   number of significant bits b, then b bit-planes of two bytes each,
+   most significant first. Flat areas take one byte per 16 pixels, and
+   with SSE2 a group packs or unpacks in a handful of instructions. */
+
+static const uint8_t zero_row[ 16 ] = { 0 };
+
+static inline uint significant_bits( uint value )
+{
+  return value ? 32 - __builtin_clz( value ) : 0;
+}
+
+#ifdef __SSE2__
+
+static inline uint8_t *pack_group( const uint8_t *cur, const uint8_t *above,
+				   uint8_t *header, uint8_t *out )
+{
+  __m128i residual = _mm_sub_epi8( _mm_loadu_si128( (const __m128i *)cur ),
+				   _mm_loadu_si128( (const __m128i *)above ) );
+  __m128i zigzag = _mm_xor_si128( _mm_add_epi8( residual, residual ),
+				  _mm_cmpgt_epi8( _mm_setzero_si128(), residual ) );
+
+  __m128i any = _mm_or_si128( zigzag, _mm_srli_si128( zigzag, 8 ) );
+  any = _mm_or_si128( any, _mm_srli_si128( any, 4 ) );
+  any = _mm_or_si128( any, _mm_srli_si128( any, 2 ) );
+  any = _mm_or_si128( any, _mm_srli_si128( any, 1 ) );
+  uint bits = significant_bits( _mm_cvtsi128_si32( any ) & 0xff );
+
+  *header = bits;
+
+  /* Line the significant bits up at the top of each byte (nothing
+     carries into the next byte, as every value is below 1 << bits) and
+     write all eight planes without branching; only the first bits of
+     them are kept, the rest is overwritten by the next group. */
+  zigzag = _mm_sll_epi16( zigzag, _mm_cvtsi32_si128( 8 - bits ) );
+  for ( int k = 0; k < 8; k++ ) {
+    uint16_t mask = _mm_movemask_epi8( zigzag );
+    memcpy( out + 2 * k, &mask, 2 );
+    zigzag = _mm_add_epi8( zigzag, zigzag );
+  }
+
+  return out + 2 * bits;
+}
+
+static inline const uint8_t *unpack_group( uint bits, const uint8_t *in,
+					  const uint8_t *above, uint8_t *cur )
+{
+  const __m128i one = _mm_set1_epi8( 1 );
+  const __m128i bit = _mm_set_epi8( -128, 64, 32, 16, 8, 4, 2, 1,
+				    -128, 64, 32, 16, 8, 4, 2, 1 );
+
+  __m128i zigzag = _mm_setzero_si128();
+  for ( uint k = 0; k < bits; k++ ) {
+    /* spread the low mask byte over bytes 0-7 and the high one over 8-15 */
+    __m128i plane = _mm_cvtsi32_si128( in[ 0 ] | (in[ 1 ] << 8) );
+    plane = _mm_unpacklo_epi8( plane, plane );
+    plane = _mm_unpacklo_epi16( plane, plane );
+    plane = _mm_unpacklo_epi32( plane, plane );
+    plane = _mm_cmpeq_epi8( _mm_and_si128( plane, bit ), bit );
+
+    zigzag = _mm_or_si128( _mm_add_epi8( zigzag, zigzag ), _mm_and_si128( plane, one ) );
+    in += 2;
+  }
+
+  __m128i negative = _mm_cmpeq_epi8( _mm_and_si128( zigzag, one ), one );
+  __m128i residual = _mm_xor_si128( _mm_and_si128( _mm_srli_epi16( zigzag, 1 ),
+						   _mm_set1_epi8( 0x7f ) ),
+				    negative );
+  _mm_storeu_si128( (__m128i *)cur,
+		    _mm_add_epi8( residual, _mm_loadu_si128( (const __m128i *)above ) ) );
+
+  return in;
+}
+
+#else
+
+static inline uint8_t *pack_group( const uint8_t *cur, const uint8_t *above,
+				   uint8_t *header, uint8_t *out )
+{
+  uint8_t zigzag[ 16 ];
+  uint any = 0;
+
+  for ( int i = 0; i < 16; i++ ) {
+    int8_t residual = cur[ i ] - above[ i ];
+    zigzag[ i ] = (residual << 1) ^ (residual >> 7);
+    any |= zigzag[ i ];
+  }
+
+  uint bits = significant_bits( any );
+
+  *header = bits;
+  for ( int k = bits - 1; k >= 0; k-- ) {
+    uint mask = 0;
+    for ( int i = 0; i < 16; i++ ) {
+      mask |= ((zigzag[ i ] >> k) & 1) << i;
+    }
+    *out++ = mask;
+    *out++ = mask >> 8;
+  }
+
+  return out;
+}
+
+static inline const uint8_t *unpack_group( uint bits, const uint8_t *in,
+					  const uint8_t *above, uint8_t *cur )
+{
+  uint8_t zigzag[ 16 ] = { 0 };
+
+  for ( uint k = 0; k < bits; k++ ) {
+    uint mask = in[ 0 ] | (in[ 1 ] << 8);
+    for ( int i = 0; i < 16; i++ ) {
+      zigzag[ i ] = (zigzag[ i ] << 1) | ((mask >> i) & 1);
+    }
+    in += 2;
+  }
+
+  for ( int i = 0; i < 16; i++ ) {
+    cur[ i ] = above[ i ] + ((zigzag[ i ] >> 1) ^ -(zigzag[ i ] & 1));
+  }
+
+  return in;
+}
+
+#endif
+
+/* Each row is stored as the headers of all its groups followed by
+   their bit-planes, so that reading a header never waits for the size
+   of the group before it. width is a multiple of 16 (frame strides
+   are). Gives up, returning NULL, once the output passes limit; it
+   can run past it by one row's worst case. */
+static uint8_t *pack_plane( const uint8_t *plane, uint width, uint rows,
+			    uint8_t *out, const uint8_t *limit )
+{
+  for ( uint row = 0; row < rows; row++ ) {
+    const uint8_t *cur = plane + row * width;
+    uint8_t *header = out;
+    out += width / 16;
+    for ( uint x = 0; x < width; x += 16 ) {
+      out = pack_group( cur + x, row ? cur + x - width : zero_row, header++, out );
+    }
+
+    if ( out > limit ) {
+      return NULL;
+    }
+  }
+
+  return out;
+}
+
+static const uint8_t *unpack_plane( const uint8_t *in, uint width, uint rows, uint8_t *plane )
+{
+  for ( uint row = 0; row < rows; row++ ) {
+    uint8_t *cur = plane + row * width;
+    const uint8_t *header = in;
+    in += width / 16;
+    for ( uint x = 0; x < width; x += 16 ) {
+      in = unpack_group( *header++, in, row ? cur + x - width : zero_row, cur + x );
+    }
+  }
+
+  return in;
+}
+
+/* Planes laid out as in a Frame */
+static uint8_t *pack_frame( const uint8_t *planes, uint stride, uint height,
+			    uint8_t *out, const uint8_t *limit )
+{
+  const uint8_t *cb = planes + stride * height;
+  const uint8_t *cr = cb + stride * height / 4;
+
+  out = pack_plane( planes, stride, height, out, limit );
+  if ( out ) out = pack_plane( cb, stride / 2, height / 2, out, limit );
+  if ( out ) out = pack_plane( cr, stride / 2, height / 2, out, limit );
+  return out;
+}
+
+static void unpack_frame( const uint8_t *in, Frame *frame )
+{
+  in = unpack_plane( in, frame->get_stride(), frame->get_height(), frame->get_y() );
+  in = unpack_plane( in, frame->get_uv_stride(), frame->get_height() / 2, frame->get_cb() );
+  unpack_plane( in, frame->get_uv_stride(), frame->get_height() / 2, frame->get_cr() );
+}
+
+static double now( void )
+{
+  struct timespec ts;
+  unixassert( clock_gettime( CLOCK_MONOTONIC, &ts ) );
+  return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static void *compressor_thread( void *s_cache )
+{
+  ((FrameCache *)s_cache)->run_compressor();
+  return NULL;
+}
+
+CachedFrame::CachedFrame( FrameHandle *s_handle, uint8_t *s_raw )
+  : handle( s_handle ), raw( s_raw ), data( NULL ), len( 0 ), element( NULL ),
+    readers( 0 ), compressing( true )
+{
+}
+
+CachedFrame::~CachedFrame()
+{
+  free( data );
+}
+
+FrameCache::FrameCache( size_t s_budget, uint s_stride, uint s_height,
+			pthread_mutex_t *s_pool_mutex )
+  : budget( s_budget ), frame_len( 3 * s_stride * s_height / 2 ), used( 0 ), raw( 0 ),
+    stride( s_stride ), height( s_height ), lru( 0 ),
+    pending( max_buffers + 1 ), spare( new uint8_t *[ max_buffers ] ),
+    buffers( 0 ), num_spare( 0 ), shutdown( NULL, NULL ), pool_mutex( s_pool_mutex ),
+    stored( 0 ), restored( 0 ), evicted( 0 ), rejected( 0 ), skipped( 0 ),
+    compress_secs( 0 ), restore_secs( 0 )
+{
+  if ( budget ) {
+    unixassert( pthread_create( &compressor, NULL, compressor_thread, this ) );
+  }
+}
+
+FrameCache::~FrameCache()
+{
+  /* Let the compressor finish what is queued. The queue deletes the
+     copies still in it. */
+  if ( budget ) {
+    pending.enqueue( &shutdown );
+    unixassert( pthread_join( compressor, NULL ) );
+  }
+
+  for ( uint i = 0; i < num_spare; i++ ) {
+    free( spare[ i ] );
+  }
+  delete[] spare;
+}
+
+/* Claims a staging buffer for the frame about to be taken from the
+   handle, or returns NULL if it isn't kept. The pool mutex is held. */
+CachedFrame *FrameCache::stage( FrameHandle *handle )
+{
+  /* A frame restored from here still has its copy. Only reference
+     pictures are kept: their chains are what make re-decoding slow,
+     while a B picture is a single decode once they are back. */
+  if ( (!budget) || handle->get_cached()
+       || (handle->get_picture()->get_type() == B) ) {
+    return NULL;
+  }
+
+  uint8_t *staging;
+  if ( num_spare ) {
+    staging = spare[ --num_spare ];
+  } else if ( buffers < max_buffers ) {
+    staging = (uint8_t *)malloc( frame_len );
+    if ( !staging ) {
+      throw UnixError( ENOMEM );
+    }
+    buffers++;
+  } else {
+    /* The compressor is behind; decoding doesn't wait for it */
+    skipped++;
+    return NULL;
+  }
+
+  return new CachedFrame( handle, staging );
+}
+
+/* Called without the pool mutex, by the one thread that has the frame */
+void FrameCache::file( CachedFrame *copy, Frame *frame )
+{
+  memcpy( copy->raw, frame->get_y(), frame_len );
+
+  MutexLock x( pool_mutex );
+
+  /* The picture was decoded again and stored in the meantime */
+  if ( copy->handle->get_cached() ) {
+    spare[ num_spare++ ] = copy->raw;
+    delete copy;
+    return;
+  }
+
+  copy->handle->set_cached( copy );
+  pending.enqueue( copy );
+}
+
+/* Called without the pool mutex */
+bool FrameCache::restore( FrameHandle *handle, Frame *frame )
+{
+  CachedFrame *copy;
+  uint8_t *from_raw;
+
+  {
+    MutexLock x( pool_mutex );
+
+    copy = handle->get_cached();
+    if ( !copy ) {
+      return false;
+    }
+
+    /* Neither freed nor recycled until we are done with it. The raw
+       planes, while there are any, are the quicker to copy. */
+    copy->readers++;
+    from_raw = copy->raw;
+
+    /* Most recently used again */
+    if ( copy->element ) {
+      lru.remove_specific( copy->element );
+      copy->element = lru.enqueue( copy );
+    }
+  }
+
+  double start = now();
+  if ( from_raw ) {
+    memcpy( frame->get_y(), from_raw, frame_len );
+  } else {
+    unpack_frame( copy->data, frame );
+  }
+  double secs = now() - start;
+
+  MutexLock x( pool_mutex );
+
+  if ( !from_raw ) {
+    restore_secs += secs;
+  }
+  restored++;
+
+  copy->readers--;
+  settle( copy );
+
+  return true;
+}
+
+void FrameCache::run_compressor( void )
+{
+  while ( 1 ) {
+    CachedFrame *copy = pending.dequeue( true );
+    if ( copy == &shutdown ) {
+      return;
+    }
+
+    compress( copy );
+  }
+}
+
+/* Runs on the compressor thread, which has the staging buffer to
+   itself apart from restore()s reading it */
+void FrameCache::compress( CachedFrame *copy )
+{
+  /* Noise barely compresses, and restoring it would cost about as
+     much as decoding it again, so packing stops once it is clear the
+     copy won't be kept. Room for one row past the limit in the worst
+     case, where every group needs all eight bit-planes, and for the
+     last group's stray planes. Without the memory, the copy isn't
+     kept either. */
+  size_t limit = frame_len / 4 * 3;
+  uint8_t *data = (uint8_t *)malloc( limit + stride / 16 * 17 + 16 );
+
+  double start = now();
+  uint8_t *end = data ? pack_frame( copy->raw, stride, height, data, data + limit ) : NULL;
+  double secs = now() - start;
+
+  size_t len = end ? end - data : 0;
+  if ( end && (len <= budget) ) {
+    data = (uint8_t *)realloc( data, len );
+  } else {
+    free( data );
+    data = NULL;
+  }
+
+  MutexLock x( pool_mutex );
+
+  compress_secs += secs;
+  stored++;
+  copy->compressing = false;
+
+  if ( !data ) {
+    rejected++;
+    drop( copy );
+    return;
+  }
+
+  while ( used + len > budget ) {
+    evict_oldest();
+  }
+
+  copy->data = data;
+  copy->len = len;
+  copy->element = lru.enqueue( copy );
+  used += len;
+  raw += frame_len;
+
+  settle( copy );
+}
+
+void FrameCache::evict_oldest( void )
+{
+  CachedFrame *copy = lru.dequeue( false );
+  ahabassert( copy );
+
+  copy->element = NULL;
+  used -= copy->len;
+  raw -= frame_len;
+  evicted++;
+
+  drop( copy );
+}
+
+/* Takes the copy from its handle; it goes once nobody reads it. The
+   pool mutex is held. */
+void FrameCache::drop( CachedFrame *copy )
+{
+  copy->handle->set_cached( NULL );
+  copy->handle = NULL;
+
+  settle( copy );
+}
+
+/* Once the compressor has filed a copy and no restore() is reading it,
+   its staging buffer goes back to the spares, and a dropped copy is
+   deleted. The pool mutex is held. */
+void FrameCache::settle( CachedFrame *copy )
+{
+  if ( copy->readers || copy->compressing ) {
+    return;
+  }
+
+  if ( copy->raw ) {
+    spare[ num_spare++ ] = copy->raw;
+    copy->raw = NULL;
+  }
+
+  if ( !copy->handle ) {
+    delete copy;
+  }
+}
+
+void FrameCache::print_status( void )
+{
+  if ( !budget ) {
+    fprintf( stderr, "frame cache: disabled\n" );
+    return;
+  }
+
+  MutexLock x( pool_mutex );
+
+  fprintf( stderr, "frame cache: %d frames in %.1f of %.1f MiB (%.2f:1), %u evicted, %u not kept, %u skipped while the compressor was busy\n",
+	   lru.get_count(), used / 1048576.0, budget / 1048576.0,
+	   used ? (double)raw / used : 0, evicted, rejected, skipped );
+  fprintf( stderr, "frame cache: %.3f ms per frame to compress (%u), %.3f ms to restore (%u)\n",
+	   stored ? 1000 * compress_secs / stored : 0, stored,
+	   restored ? 1000 * restore_secs / restored : 0, restored );
+}
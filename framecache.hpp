@@ -0,0 +1,83 @@
+#ifndef FRAMECACHE_HPP
+#define FRAMECACHE_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <pthread.h>
+
+#include "opq.hpp"
+#include "ringqueue.hpp"
+
+class Frame;
+class FrameHandle;
+
+/* A copy of a rendered frame: its raw planes while they wait for the
+   compressor thread, and then the losslessly compressed planes */
+class CachedFrame
+{
+public:
+  FrameHandle *handle; /* NULL once dropped, until the last reader is done */
+  uint8_t *raw;  /* staging buffer, until compressed and unread */
+  uint8_t *data; /* compressed */
+  size_t len;
+  QueueElement<CachedFrame> *element;
+  uint readers;     /* restore()s copying out of it without the pool mutex */
+  bool compressing; /* the compressor has yet to file it */
+
+  CachedFrame( FrameHandle *s_handle, uint8_t *s_raw );
+  ~CachedFrame();
+};
+
+/* Second tier below the BufferPool. A rendered reference frame that is
+   about to be reused for another picture is compressed here first, so
+   that its picture can later be restored instead of re-decoded along
+   with its whole reference chain. The least recently used copies are dropped to
+   stay within the budget; a budget of zero disables the tier.
+
+   The decoder only copies the frame to a staging buffer; a thread of
+   its own compresses it, and until then the picture is restored from
+   the buffer. When all the buffers are busy, the frame is not kept.
+
+   Frames are copied in and out without the pool mutex. stage() is
+   called with it held and claims a staging buffer, and file() makes
+   the copy and then takes the mutex to hand it to the compressor.
+   restore() takes the mutex only to find and pin the copy, and to
+   unpin it; the compressor takes it to file its results. */
+class FrameCache
+{
+private:
+  size_t budget, frame_len, used, raw;
+  uint stride, height;
+  Queue<CachedFrame> lru;
+
+  RingQueue<CachedFrame> pending;
+  uint8_t **spare; /* idle staging buffers */
+  uint buffers, num_spare;
+  CachedFrame shutdown;
+
+  pthread_t compressor;
+  pthread_mutex_t *pool_mutex;
+
+  uint stored, restored, evicted, rejected, skipped;
+  double compress_secs, restore_secs;
+
+  void compress( CachedFrame *copy );
+  void evict_oldest( void );
+  void drop( CachedFrame *copy );
+  void settle( CachedFrame *copy );
+
+public:
+  FrameCache( size_t s_budget, uint s_stride, uint s_height, pthread_mutex_t *s_pool_mutex );
+  ~FrameCache();
+
+  CachedFrame *stage( FrameHandle *handle );
+  void file( CachedFrame *copy, Frame *frame );
+  bool restore( FrameHandle *handle, Frame *frame );
+
+  void run_compressor( void );
+
+  void print_status( void );
+};
+
+#endif
@@ -1,9 +0,0 @@
-#ifndef FRAMEQUEUE_HPP
-#define FRAMEQUEUE_HPP
-
-#include "opq.hpp"
-#include "framebuffer.hpp"
-
-#include "opq.cpp"
-
-#endif
@@ -0,0 +1,561 @@
+/*
+ * idct_avx2.cpp
+ *
+ * AVX2 inverse DCT, block copy/add and DC add. This is the SSE2 IDCT
+ * from idct_mmx.cpp computed with the same instructions on the same
+ * constants, so the results are bit-exact with mpeg2_idct_copy_sse2 and
+ * mpeg2_idct_add_sse2.
+ *
+ * Every AVX2 integer operation used here works within 128-bit lanes, so
+ * a 256-bit register holds one row (or column group) of two different
+ * blocks. The single-block kernels use that to do two rows of the row
+ * pass at once; the pair kernels transform two horizontally adjacent
+ * blocks (the left and right luma blocks of a macroblock) in one pass
+ * and read and write both blocks' 16 pixels of each row together.
+ *
+ * The add kernels also take shortcuts for sparse non-intra blocks, using
+ * the last scan position the block parser returns: a block whose
+ * coefficients all lie in the top left 4x4 (or 2x2) only needs the row
+ * pass on its first four (two) rows and half the column pass. Those
+ * shortcuts drop only terms that are exactly zero, so they stay
+ * bit-exact with the full transform.
+ */
+
+#include "config.h"
+
+#if defined(ARCH_X86) || defined(ARCH_X86_64)
+
+#pragma GCC target ("avx2")
+
+#include <inttypes.h>
+#include <immintrin.h>
+
+#include "mpeg2.h"
+#include "attributes.h"
+#include "mpeg2_internal.h"
+
+#define ROW_SHIFT 15
+#define COL_SHIFT 6
+
+#define round(bias) ((int)(((bias)+0.5) * (1<<ROW_SHIFT)))
+#define rounder_avx2(bias) {round (bias), round (bias), round (bias), round (bias)}
+
+#define avx2_table(c1,c2,c3,c4,c5,c6,c7) {  c4,  c2,  c4,  c6,   \
+					    c4, -c6,  c4, -c2,   \
+					    c4,  c6, -c4, -c2,   \
+					   -c4,  c2,  c4, -c6,   \
+					    c1,  c3,  c3, -c7,   \
+					    c5, -c1,  c7, -c5,   \
+					    c5,  c7, -c1, -c5,   \
+					    c7,  c3,  c3, -c1 }
+
+static const int16_t table04[] ATTR_ALIGN(16) =
+    avx2_table (22725, 21407, 19266, 16384, 12873,  8867, 4520);
+static const int16_t table17[] ATTR_ALIGN(16) =
+    avx2_table (31521, 29692, 26722, 22725, 17855, 12299, 6270);
+static const int16_t table26[] ATTR_ALIGN(16) =
+    avx2_table (29692, 27969, 25172, 21407, 16819, 11585, 5906);
+static const int16_t table35[] ATTR_ALIGN(16) =
+    avx2_table (26722, 25172, 22654, 19266, 15137, 10426, 5315);
+
+static const int32_t rounder0[] ATTR_ALIGN(16) =
+    rounder_avx2 ((1 << (COL_SHIFT - 1)) - 0.5);
+static const int32_t rounder4[] ATTR_ALIGN(16) = rounder_avx2 (0);
+static const int32_t rounder1[] ATTR_ALIGN(16) =
+    rounder_avx2 (1.25683487303);	/* C1*(C1/C4+C1+C7)/2 */
+static const int32_t rounder7[] ATTR_ALIGN(16) =
+    rounder_avx2 (-0.25);		/* C1*(C7/C4+C7-C1)/2 */
+static const int32_t rounder2[] ATTR_ALIGN(16) =
+    rounder_avx2 (0.60355339059);	/* C2 * (C6+C2)/2 */
+static const int32_t rounder6[] ATTR_ALIGN(16) =
+    rounder_avx2 (-0.25);		/* C2 * (C6-C2)/2 */
+static const int32_t rounder3[] ATTR_ALIGN(16) =
+    rounder_avx2 (0.087788325588);	/* C3*(-C3/C4+C3+C5)/2 */
+static const int32_t rounder5[] ATTR_ALIGN(16) =
+    rounder_avx2 (-0.441341716183);	/* C3*(-C5/C4+C5-C3)/2 */
+
+#define T1 ((short)13036)
+#define T2 ((short)27146)
+#define T3 ((short)43790)
+#define C4 ((short)23170)
+
+#define LOAD128(p) _mm_load_si128 ((const __m128i *) (p))
+#define BROADCAST128(p) _mm256_broadcastsi128_si256 (LOAD128 (p))
+#define PAIR128(lo,hi) \
+    _mm256_inserti128_si256 (_mm256_castsi128_si256 (lo), (hi), 1)
+
+/* Row IDCT of one row in each lane; see SSE2_IDCT_2ROW */
+static inline __m256i avx2_idct_row (const int16_t * const table,
+				     const __m256i row, const __m256i round)
+{
+    __m256i a, b, x02, x46, x13, x57;
+
+    x02 = _mm256_shuffle_epi32 (row, 0x00);
+    x46 = _mm256_shuffle_epi32 (row, 0x55);
+    x13 = _mm256_shuffle_epi32 (row, 0xaa);
+    x57 = _mm256_shuffle_epi32 (row, 0xff);
+
+    x02 = _mm256_madd_epi16 (x02, BROADCAST128 (table + 0*8));
+    x46 = _mm256_madd_epi16 (x46, BROADCAST128 (table + 1*8));
+    x13 = _mm256_madd_epi16 (x13, BROADCAST128 (table + 2*8));
+    x57 = _mm256_madd_epi16 (x57, BROADCAST128 (table + 3*8));
+
+    a = _mm256_add_epi32 (_mm256_add_epi32 (x02, round), x46);
+    b = _mm256_add_epi32 (x57, x13);
+
+    return _mm256_packs_epi32
+	(_mm256_srai_epi32 (_mm256_add_epi32 (a, b), ROW_SHIFT),
+	 _mm256_shuffle_epi32 (_mm256_srai_epi32 (_mm256_sub_epi32 (a, b),
+						  ROW_SHIFT), 0x1b));
+}
+
+/* avx2_idct_row for a row with only x0 to x3 set: the x46 and x57
+   products are zero. The two lanes may use different tables. */
+static inline __m256i avx2_idct_row_left (const int16_t * const table_lo,
+					  const int16_t * const table_hi,
+					  const __m256i row,
+					  const __m256i round)
+{
+    __m256i a, b, x02, x13;
+
+    x02 = _mm256_shuffle_epi32 (row, 0x00);
+    x13 = _mm256_shuffle_epi32 (row, 0xaa);
+
+    x02 = _mm256_madd_epi16 (x02, PAIR128 (LOAD128 (table_lo + 0*8),
+					   LOAD128 (table_hi + 0*8)));
+    x13 = _mm256_madd_epi16 (x13, PAIR128 (LOAD128 (table_lo + 2*8),
+					   LOAD128 (table_hi + 2*8)));
+
+    a = _mm256_add_epi32 (x02, round);
+    b = x13;
+
+    return _mm256_packs_epi32
+	(_mm256_srai_epi32 (_mm256_add_epi32 (a, b), ROW_SHIFT),
+	 _mm256_shuffle_epi32 (_mm256_srai_epi32 (_mm256_sub_epi32 (a, b),
+						  ROW_SHIFT), 0x1b));
+}
+
+/* Column IDCT; see sse2_idct_col. Works on 8 columns per 128-bit lane. */
+#define COLUMN_IDCT(idct_col, V, adds, subs, mulhi, srai, set1)		\
+static inline void idct_col (V * const x)				\
+{									\
+    const V t1 = set1 (T1);						\
+    const V t2 = set1 (T2);						\
+    const V t3 = set1 (T3);						\
+    const V c4 = set1 (C4);						\
+    V u17, v17, u35, v35, u26, v26, u04, v04, u12, v12;			\
+    V a0, a1, a2, a3, b0, b1, b2, b3;					\
+									\
+    v17 = subs (mulhi (t1, x[1]), x[7]);				\
+    u17 = adds (x[1], mulhi (t1, x[7]));				\
+    v35 = subs (adds (mulhi (t3, x[3]), x[3]), x[5]);			\
+    u35 = adds (adds (mulhi (t3, x[5]), x[5]), x[3]);			\
+    v26 = subs (mulhi (t2, x[2]), x[6]);				\
+    u26 = adds (mulhi (t2, x[6]), x[2]);				\
+									\
+    b0 = adds (u17, u35);						\
+    b3 = subs (v17, v35);						\
+    u12 = subs (u17, u35);						\
+    v12 = adds (v35, v17);						\
+    b1 = mulhi (c4, adds (u12, v12));					\
+    b2 = mulhi (c4, subs (u12, v12));					\
+    b1 = adds (b1, b1);							\
+    b2 = adds (b2, b2);							\
+									\
+    u04 = adds (x[0], x[4]);						\
+    v04 = subs (x[0], x[4]);						\
+    a0 = adds (u04, u26);						\
+    a1 = adds (v26, v04);						\
+    a2 = subs (v04, v26);						\
+    a3 = subs (u04, u26);						\
+									\
+    x[0] = srai (adds (a0, b0), COL_SHIFT);				\
+    x[1] = srai (adds (a1, b1), COL_SHIFT);				\
+    x[2] = srai (adds (a2, b2), COL_SHIFT);				\
+    x[3] = srai (adds (a3, b3), COL_SHIFT);				\
+    x[4] = srai (subs (a3, b3), COL_SHIFT);				\
+    x[5] = srai (subs (a2, b2), COL_SHIFT);				\
+    x[6] = srai (subs (a1, b1), COL_SHIFT);				\
+    x[7] = srai (subs (a0, b0), COL_SHIFT);				\
+}
+
+/* COLUMN_IDCT when rows 4 to 7 are zero. Zero rows only ever get
+   added, subtracted or multiplied, so dropping them is exact. */
+#define COLUMN_IDCT_4(idct_col, V, adds, subs, mulhi, srai, set1)	\
+static inline void idct_col (V * const x)				\
+{									\
+    const V t1 = set1 (T1);						\
+    const V t2 = set1 (T2);						\
+    const V t3 = set1 (T3);						\
+    const V c4 = set1 (C4);						\
+    V u17, v17, u35, v35, u26, v26, u12, v12;				\
+    V a0, a1, a2, a3, b0, b1, b2, b3;					\
+									\
+    v17 = mulhi (t1, x[1]);						\
+    u17 = x[1];								\
+    v35 = adds (mulhi (t3, x[3]), x[3]);				\
+    u35 = x[3];								\
+    v26 = mulhi (t2, x[2]);						\
+    u26 = x[2];								\
+									\
+    b0 = adds (u17, u35);						\
+    b3 = subs (v17, v35);						\
+    u12 = subs (u17, u35);						\
+    v12 = adds (v35, v17);						\
+    b1 = mulhi (c4, adds (u12, v12));					\
+    b2 = mulhi (c4, subs (u12, v12));					\
+    b1 = adds (b1, b1);							\
+    b2 = adds (b2, b2);							\
+									\
+    a0 = adds (x[0], u26);						\
+    a1 = adds (v26, x[0]);						\
+    a2 = subs (x[0], v26);						\
+    a3 = subs (x[0], u26);						\
+									\
+    x[0] = srai (adds (a0, b0), COL_SHIFT);				\
+    x[1] = srai (adds (a1, b1), COL_SHIFT);				\
+    x[2] = srai (adds (a2, b2), COL_SHIFT);				\
+    x[3] = srai (adds (a3, b3), COL_SHIFT);				\
+    x[4] = srai (subs (a3, b3), COL_SHIFT);				\
+    x[5] = srai (subs (a2, b2), COL_SHIFT);				\
+    x[6] = srai (subs (a1, b1), COL_SHIFT);				\
+    x[7] = srai (subs (a0, b0), COL_SHIFT);				\
+}
+
+COLUMN_IDCT (idct_col_128, __m128i, _mm_adds_epi16, _mm_subs_epi16,
+	     _mm_mulhi_epi16, _mm_srai_epi16, _mm_set1_epi16)
+COLUMN_IDCT (idct_col_256, __m256i, _mm256_adds_epi16, _mm256_subs_epi16,
+	     _mm256_mulhi_epi16, _mm256_srai_epi16, _mm256_set1_epi16)
+COLUMN_IDCT_4 (idct_col_4_128, __m128i, _mm_adds_epi16, _mm_subs_epi16,
+	       _mm_mulhi_epi16, _mm_srai_epi16, _mm_set1_epi16)
+COLUMN_IDCT_4 (idct_col_4_256, __m256i, _mm256_adds_epi16, _mm256_subs_epi16,
+	       _mm256_mulhi_epi16, _mm256_srai_epi16, _mm256_set1_epi16)
+
+/* One block: rows i and j of the row pass share a register */
+static inline void avx2_idct (const int16_t * const block, __m128i * const x)
+{
+#define ROWS(i,j,table)							\
+    do {								\
+	__m256i r = avx2_idct_row					\
+	    (table, PAIR128 (LOAD128 (block + i*8), LOAD128 (block + j*8)),\
+	     PAIR128 (LOAD128 (rounder##i), LOAD128 (rounder##j)));	\
+	x[i] = _mm256_castsi256_si128 (r);				\
+	x[j] = _mm256_extracti128_si256 (r, 1);				\
+    } while (0)
+
+    ROWS (0, 4, table04);
+    ROWS (1, 7, table17);
+    ROWS (2, 6, table26);
+    ROWS (3, 5, table35);
+#undef ROWS
+
+    idct_col_128 (x);
+}
+
+/* A row of zeros transforms to its rounder >> ROW_SHIFT in every
+   column: 1 for row 2, and 0 for rows 3 to 7 */
+#define ZERO_ROW(i) (rounder##i[0] >> ROW_SHIFT)
+
+/* One block with coefficients only in its top left 4x4 (rows == 4) or
+   2x2 (rows == 2) */
+static inline void avx2_idct_sparse (const int16_t * const block,
+				     __m128i * const x, const int rows)
+{
+    __m256i r;
+
+    r = avx2_idct_row_left (table04, table17,
+			    PAIR128 (LOAD128 (block), LOAD128 (block + 8)),
+			    PAIR128 (LOAD128 (rounder0), LOAD128 (rounder1)));
+    x[0] = _mm256_castsi256_si128 (r);
+    x[1] = _mm256_extracti128_si256 (r, 1);
+
+    if (rows == 2) {
+	x[2] = _mm_set1_epi16 (ZERO_ROW (2));
+	x[3] = _mm_set1_epi16 (ZERO_ROW (3));
+    } else {
+	r = avx2_idct_row_left (table26, table35,
+				PAIR128 (LOAD128 (block + 16),
+					 LOAD128 (block + 24)),
+				PAIR128 (LOAD128 (rounder2),
+					 LOAD128 (rounder3)));
+	x[2] = _mm256_castsi256_si128 (r);
+	x[3] = _mm256_extracti128_si256 (r, 1);
+    }
+
+    idct_col_4_128 (x);
+}
+
+/* Two blocks, 64 coefficients apart: the first in the low lanes */
+static inline void avx2_idct2 (const int16_t * const block, __m256i * const y)
+{
+    int i;
+
+    for (i = 0; i < 8; i++) {
+	static const int16_t * const tables[8] = {
+	    table04, table17, table26, table35,
+	    table04, table35, table26, table17
+	};
+	static const int32_t * const rounders[8] = {
+	    rounder0, rounder1, rounder2, rounder3,
+	    rounder4, rounder5, rounder6, rounder7
+	};
+
+	y[i] = avx2_idct_row (tables[i],
+			      PAIR128 (LOAD128 (block + i*8),
+				       LOAD128 (block + 64 + i*8)),
+			      BROADCAST128 (rounders[i]));
+    }
+
+    idct_col_256 (y);
+}
+
+/* As avx2_idct2, for two blocks with coefficients only in their top
+   left 4x4 */
+static inline void avx2_idct2_sparse (const int16_t * const block,
+				      __m256i * const y)
+{
+    int i;
+
+    for (i = 0; i < 4; i++) {
+	static const int16_t * const tables[4] = {
+	    table04, table17, table26, table35
+	};
+	static const int32_t * const rounders[4] = {
+	    rounder0, rounder1, rounder2, rounder3
+	};
+
+	y[i] = avx2_idct_row_left (tables[i], tables[i],
+				   PAIR128 (LOAD128 (block + i*8),
+					    LOAD128 (block + 64 + i*8)),
+				   BROADCAST128 (rounders[i]));
+    }
+
+    idct_col_4_256 (y);
+}
+
+static inline void avx2_block_zero (int16_t * const block, const int count)
+{
+    const __m256i zero = _mm256_setzero_si256 ();
+    int i;
+
+    for (i = 0; i < count; i += 16)
+	_mm256_storeu_si256 ((__m256i *) (block + i), zero);
+}
+
+static inline void avx2_block_copy (const __m128i * const x, uint8_t * dest,
+				    const int stride)
+{
+    int i;
+
+    for (i = 0; i < 8; i += 2) {
+	const __m128i p = _mm_packus_epi16 (x[i], x[i + 1]);
+	_mm_storel_epi64 ((__m128i *) dest, p);
+	_mm_storeh_pi ((__m64 *) (dest + stride), _mm_castsi128_ps (p));
+	dest += 2 * stride;
+    }
+}
+
+static inline void avx2_block_add (const __m128i * const x, uint8_t * dest,
+				   const int stride)
+{
+    int i;
+
+    for (i = 0; i < 8; i += 2) {
+	__m128i r0, r1;
+
+	r0 = _mm_cvtepu8_epi16 (_mm_loadl_epi64 ((const __m128i *) dest));
+	r1 = _mm_cvtepu8_epi16 (_mm_loadl_epi64 ((const __m128i *)
+						 (dest + stride)));
+	r0 = _mm_packus_epi16 (_mm_adds_epi16 (r0, x[i]),
+			       _mm_adds_epi16 (r1, x[i + 1]));
+	_mm_storel_epi64 ((__m128i *) dest, r0);
+	_mm_storeh_pi ((__m64 *) (dest + stride), _mm_castsi128_ps (r0));
+	dest += 2 * stride;
+    }
+}
+
+/* Rows of both blocks are packed as [ left r, left r+1 | right r,
+   right r+1 ]; reorder the quadwords so each row is 16 contiguous bytes */
+static inline void avx2_block_copy2 (const __m256i * const y, uint8_t * dest,
+				     const int stride)
+{
+    int i;
+
+    for (i = 0; i < 8; i += 2) {
+	__m256i p = _mm256_packus_epi16 (y[i], y[i + 1]);
+	p = _mm256_permute4x64_epi64 (p, 0xd8);
+	_mm_storeu_si128 ((__m128i *) dest, _mm256_castsi256_si128 (p));
+	_mm_storeu_si128 ((__m128i *) (dest + stride),
+			  _mm256_extracti128_si256 (p, 1));
+	dest += 2 * stride;
+    }
+}
+
+static inline void avx2_block_add2 (const __m256i * const y, uint8_t * dest,
+				    const int stride)
+{
+    int i;
+
+    for (i = 0; i < 8; i += 2) {
+	__m256i r0, r1;
+
+	r0 = _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i *) dest));
+	r1 = _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i *)
+						    (dest + stride)));
+	r0 = _mm256_packus_epi16 (_mm256_adds_epi16 (r0, y[i]),
+				  _mm256_adds_epi16 (r1, y[i + 1]));
+	r0 = _mm256_permute4x64_epi64 (r0, 0xd8);
+	_mm_storeu_si128 ((__m128i *) dest, _mm256_castsi256_si128 (r0));
+	_mm_storeu_si128 ((__m128i *) (dest + stride),
+			  _mm256_extracti128_si256 (r0, 1));
+	dest += 2 * stride;
+    }
+}
+
+/* Adds a DC term to 8 (or, for a pair, 16) pixels of each row with
+   unsigned saturation, as block_add_DC does */
+static inline void avx2_dc_add (const __m128i add, const __m128i sub,
+				uint8_t * dest, const int stride,
+				const int pair)
+{
+    int i;
+
+    for (i = 0; i < 8; i++) {
+	__m128i r;
+
+	if (pair)
+	    r = _mm_loadu_si128 ((const __m128i *) dest);
+	else
+	    r = _mm_loadl_epi64 ((const __m128i *) dest);
+	r = _mm_subs_epu8 (_mm_adds_epu8 (r, add), sub);
+	if (pair)
+	    _mm_storeu_si128 ((__m128i *) dest, r);
+	else
+	    _mm_storel_epi64 ((__m128i *) dest, r);
+	dest += stride;
+    }
+}
+
+static inline int dc_only (const int last, const int16_t * const block)
+{
+    return last == 129 && (block[0] & (7 << 4)) != (4 << 4);
+}
+
+/* Scan positions 0 to 9 lie in the top left 4x4 coefficients, and 0
+   to 1 in the top left 2x2, for both the zigzag and alternate scans.
+   Mismatch control may have set coefficient 63 regardless. Returns
+   how many rows of the block can be nonzero. */
+static inline int sparse_rows (const int last, const int16_t * const block)
+{
+    if (last > 129 + 9 || block[63])
+	return 8;
+    return (last > 129 + 1) ? 4 : 2;
+}
+
+static inline __m128i dc_value (int16_t * const block)
+{
+    const int16_t dc = (block[0] + 64) >> 7;
+
+    block[0] = block[63] = 0;
+    return _mm_set1_epi16 (dc);
+}
+
+static inline void avx2_block_add_DC (int16_t * const block, uint8_t * dest,
+				      const int stride)
+{
+    const __m128i dc = dc_value (block);
+    const __m128i zero = _mm_setzero_si128 ();
+
+    avx2_dc_add (_mm_packus_epi16 (dc, dc),
+		 _mm_packus_epi16 (_mm_sub_epi16 (zero, dc),
+				   _mm_sub_epi16 (zero, dc)),
+		 dest, stride, 0);
+}
+
+static inline void avx2_block_add_DC2 (int16_t * const block, uint8_t * dest,
+				       const int stride)
+{
+    const __m128i dc0 = dc_value (block);
+    const __m128i dc1 = dc_value (block + 64);
+    const __m128i zero = _mm_setzero_si128 ();
+
+    avx2_dc_add (_mm_packus_epi16 (dc0, dc1),
+		 _mm_packus_epi16 (_mm_sub_epi16 (zero, dc0),
+				   _mm_sub_epi16 (zero, dc1)),
+		 dest, stride, 1);
+}
+
+void mpeg2_idct_copy_avx2 (int16_t * const block, uint8_t * const dest,
+			   const int stride)
+{
+    __m128i x[8];
+
+    avx2_idct (block, x);
+    avx2_block_copy (x, dest, stride);
+    avx2_block_zero (block, 64);
+}
+
+void mpeg2_idct_add_avx2 (const int last, int16_t * const block,
+			  uint8_t * const dest, const int stride)
+{
+    if (!dc_only (last, block)) {
+	const int rows = sparse_rows (last, block);
+	__m128i x[8];
+
+	if (rows == 8) {
+	    avx2_idct (block, x);
+	    avx2_block_add (x, dest, stride);
+	    avx2_block_zero (block, 64);
+	} else if (rows == 4) {
+	    avx2_idct_sparse (block, x, 4);
+	    avx2_block_add (x, dest, stride);
+	    avx2_block_zero (block, 32);
+	} else {
+	    avx2_idct_sparse (block, x, 2);
+	    avx2_block_add (x, dest, stride);
+	    avx2_block_zero (block, 16);
+	}
+    } else
+	avx2_block_add_DC (block, dest, stride);
+}
+
+void mpeg2_idct_copy2_avx2 (int16_t * const block, uint8_t * const dest,
+			    const int stride)
+{
+    __m256i y[8];
+
+    avx2_idct2 (block, y);
+    avx2_block_copy2 (y, dest, stride);
+    avx2_block_zero (block, 128);
+}
+
+void mpeg2_idct_add2_avx2 (const int last0, const int last1,
+			   int16_t * const block, uint8_t * const dest,
+			   const int stride)
+{
+    const int dc0 = dc_only (last0, block);
+    const int dc1 = dc_only (last1, block + 64);
+
+    if (!dc0 && !dc1) {
+	__m256i y[8];
+
+	if (sparse_rows (last0, block) == 8 ||
+	    sparse_rows (last1, block + 64) == 8) {
+	    avx2_idct2 (block, y);
+	    avx2_block_add2 (y, dest, stride);
+	    avx2_block_zero (block, 128);
+	} else {
+	    avx2_idct2_sparse (block, y);
+	    avx2_block_add2 (y, dest, stride);
+	    avx2_block_zero (block, 32);
+	    avx2_block_zero (block + 64, 32);
+	}
+    } else if (dc0 && dc1)
+	avx2_block_add_DC2 (block, dest, stride);
+    else {
+	mpeg2_idct_add_avx2 (last0, block, dest, stride);
+	mpeg2_idct_add_avx2 (last1, block + 64, dest + 8, stride);
+    }
+}
+
+#endif
@@ -0,0 +1,122 @@
+/*
+ * idct_lowres.cpp
+ *
+ * Reduced-size inverse DCTs for half- and quarter-resolution decoding.
+ * Only the low-frequency 4x4 (or 2x2) corner of each 8x8 block is used,
+ * which reconstructs the block sampled at the centre of every 2x2 (or
+ * 4x4) group of full-resolution pixels.
+ *
+ * The coefficients arrive the way the MMX/SSE2 IDCT wants them: scaled
+ * by 16 and with the columns of each row permuted (see mpeg2_scan_norm).
+ */
+
+#include <string.h>
+#include <inttypes.h>
+
+#include "mpeg2.h"
+#include "attributes.h"
+#include "mpeg2_internal.h"
+
+/* column c of a row is stored at (c >> 1) | ((c & 1) << 2) */
+#define COEF(block,row,col) ((block)[(row) * 8 + (((col) >> 1) | (((col) & 1) << 2))])
+
+/* (1/2) * C(u) * cos ((2x+1) * u * pi / 8), scaled by 4096 */
+#define W_A 1448	/* 0.353553 */
+#define W_B 1892	/* 0.461940 */
+#define W_C 784		/* 0.191342 */
+
+#define CLIP(x) (((x) < 0) ? 0 : (((x) > 255) ? 255 : (x)))
+
+static inline void idct4_1d (int x0, int x1, int x2, int x3, int * out)
+{
+    const int e0 = W_A * (x0 + x2);
+    const int e1 = W_A * (x0 - x2);
+    const int o0 = W_B * x1 + W_C * x3;
+    const int o1 = W_C * x1 - W_B * x3;
+
+    out[0] = e0 + o0;
+    out[1] = e1 + o1;
+    out[2] = e1 - o1;
+    out[3] = e0 - o0;
+}
+
+static inline void idct4x4 (const int16_t * const block, int out[4][4])
+{
+    int tmp[4][4];
+    int col[4];
+    int i;
+
+    for (i = 0; i < 4; i++) {
+	idct4_1d (COEF (block, i, 0), COEF (block, i, 1),
+		  COEF (block, i, 2), COEF (block, i, 3), tmp[i]);
+	tmp[i][0] = (tmp[i][0] + 2048) >> 12;
+	tmp[i][1] = (tmp[i][1] + 2048) >> 12;
+	tmp[i][2] = (tmp[i][2] + 2048) >> 12;
+	tmp[i][3] = (tmp[i][3] + 2048) >> 12;
+    }
+
+    for (i = 0; i < 4; i++) {
+	idct4_1d (tmp[0][i], tmp[1][i], tmp[2][i], tmp[3][i], col);
+	/* undo the 4096 scale of the constants and the 16 of the input */
+	out[0][i] = (col[0] + 32768) >> 16;
+	out[1][i] = (col[1] + 32768) >> 16;
+	out[2][i] = (col[2] + 32768) >> 16;
+	out[3][i] = (col[3] + 32768) >> 16;
+    }
+}
+
+static inline void idct2x2 (const int16_t * const block, int out[2][2])
+{
+    const int a = COEF (block, 0, 0), b = COEF (block, 0, 1);
+    const int c = COEF (block, 1, 0), d = COEF (block, 1, 1);
+
+    /* each term weighs 1/8, and the input is scaled by 16 */
+    out[0][0] = (a + b + c + d + 64) >> 7;
+    out[0][1] = (a - b + c - d + 64) >> 7;
+    out[1][0] = (a + b - c - d + 64) >> 7;
+    out[1][1] = (a - b - c + d + 64) >> 7;
+}
+
+void mpeg2_idct_copy_lowres (int16_t * const block, uint8_t * dest,
+			     const int stride, const int lowres)
+{
+    int i, j;
+
+    if (lowres == 1) {
+	int out[4][4];
+	idct4x4 (block, out);
+	for (i = 0; i < 4; i++, dest += stride)
+	    for (j = 0; j < 4; j++)
+		dest[j] = CLIP (out[i][j]);
+    } else {
+	int out[2][2];
+	idct2x2 (block, out);
+	for (i = 0; i < 2; i++, dest += stride)
+	    for (j = 0; j < 2; j++)
+		dest[j] = CLIP (out[i][j]);
+    }
+
+    memset (block, 0, 64 * sizeof (int16_t));
+}
+
+void mpeg2_idct_add_lowres (int16_t * const block, uint8_t * dest,
+			    const int stride, const int lowres)
+{
+    int i, j;
+
+    if (lowres == 1) {
+	int out[4][4];
+	idct4x4 (block, out);
+	for (i = 0; i < 4; i++, dest += stride)
+	    for (j = 0; j < 4; j++)
+		dest[j] = CLIP (dest[j] + out[i][j]);
+    } else {
+	int out[2][2];
+	idct2x2 (block, out);
+	for (i = 0; i < 2; i++, dest += stride)
+	    for (j = 0; j < 2; j++)
+		dest[j] = CLIP (dest[j] + out[i][j]);
+    }
+
+    memset (block, 0, 64 * sizeof (int16_t));
+}
@@ -1254,6 +1254,30 @@ static inline void block_add_DC (int16_t * const block, uint8_t * dest,
     movq_r2m (mm3, *(dest + 2*stride));
 }
 
+/* As block_add_DC, but in xmm registers so no emms is needed after */
+static inline void sse2_block_add_DC (int16_t * const block, uint8_t * dest,
+				      const int stride)
+{
+    int i;
+
+    movd_v2r ((block[0] + 64) >> 7, xmm0);
+    pxor_r2r (xmm1, xmm1);
+    punpcklwd_r2r (xmm0, xmm0);
+    pshufd_r2r (xmm0, xmm0, 0x00);
+    psubsw_r2r (xmm0, xmm1);
+    packuswb_r2r (xmm0, xmm0);
+    packuswb_r2r (xmm1, xmm1);
+    block[0] = 0;
+    block[63] = 0;
+    for (i = 0; i < 8; i++) {
+	movq_m2r (*dest, xmm2);
+	paddusb_r2r (xmm0, xmm2);
+	psubusb_r2r (xmm1, xmm2);
+	movq_r2m (xmm2, *dest);
+	dest += stride;
+    }
+}
+
 void mpeg2_idct_copy_sse2 (int16_t * const block, uint8_t * const dest,
 			   const int stride)
 {
@@ -1270,9 +1294,28 @@ void mpeg2_idct_add_sse2 (const int last, int16_t * const block,
 	sse2_block_add (block, dest, stride);
 	sse2_block_zero (block);
     } else
-	block_add_DC (block, dest, stride, CPU_MMXEXT);
+	sse2_block_add_DC (block, dest, stride);
+}
+
+/* Two horizontally adjacent blocks, 64 coefficients apart */
+#define declare_idct_pair(cpu)						\
+void mpeg2_idct_copy2_##cpu (int16_t * const block, uint8_t * const dest, \
+			     const int stride)				\
+{									\
+    mpeg2_idct_copy_##cpu (block, dest, stride);			\
+    mpeg2_idct_copy_##cpu (block + 64, dest + 8, stride);		\
+}									\
+									\
+void mpeg2_idct_add2_##cpu (const int last0, const int last1,		\
+			    int16_t * const block, uint8_t * const dest, \
+			    const int stride)				\
+{									\
+    mpeg2_idct_add_##cpu (last0, block, dest, stride);			\
+    mpeg2_idct_add_##cpu (last1, block + 64, dest + 8, stride);	\
 }
 
+declare_idct_pair (sse2)
+
 
 declare_idct (mmxext_idct, mmxext_table,
 	      mmxext_row_head, mmxext_row, mmxext_row_tail, mmxext_row_mid)
@@ -1319,6 +1362,9 @@ void mpeg2_idct_add_mmx (const int last, int16_t * const block,
 	block_add_DC (block, dest, stride, CPU_MMX);
 }
 
+declare_idct_pair (mmxext)
+declare_idct_pair (mmx)
+
 /*
 void mpeg2_idct_mmx_init (void)
 {
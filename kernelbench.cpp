@@ -0,0 +1,721 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <x86intrin.h>
+
+#include "libmpeg2.h"
+
+#include "file.hpp"
+#include "es.hpp"
+#include "mpegheader.hpp"
+#include "exceptions.hpp"
+#include "framebuffer.hpp"
+#include "picture.hpp"
+
+/* Times the IDCT, motion compensation and coefficient parsing kernels
+   one at a time. Their inputs are captured from a real stream by
+   decoding it through the MPEG2_CAPTURE build of slicedecode.cpp, and
+   each kernel set the CPU supports is checked against a plain C
+   reference along the way. */
+
+void progress_bar( off_t, off_t ) {}
+
+static const int max_samples = 32768;
+static const int max_vlc_bytes = 256; /* more than any one block needs */
+static const int passes = 5;
+
+enum { IDCT_COPY, IDCT_ADD, IDCT_COPY2, IDCT_ADD2, IDCT_KINDS };
+static const char *idct_names[ IDCT_KINDS ] = { "copy", "add", "copy2", "add2" };
+
+static const char *vlc_names[ 3 ] = { "intra B14", "intra B15", "non-intra" };
+
+struct IDCTSample
+{
+  int16_t block[ 128 ];
+  int last[ 2 ];
+  int stride;
+  int dest_align;
+};
+
+struct MCSample
+{
+  int stride, height;
+  int dest_align, ref_align;
+};
+
+struct VLCSample
+{
+  uint32_t bitstream_buf;
+  int bitstream_bits;
+  uint32_t offset, len; /* in vlc_bytes */
+  const uint8_t *scan;
+  int16_t dc;
+  uint16_t quant_matrix[ 64 ];
+};
+
+/* Everything the capture hooks saw, up to max_samples of each kind */
+struct Samples
+{
+  IDCTSample *idct[ IDCT_KINDS ];
+  int num_idct[ IDCT_KINDS ];
+
+  MCSample *mc[ 16 ]; /* put entries 0-7, then avg 0-7, as in mpeg2_mc_t */
+  int num_mc[ 16 ];
+
+  VLCSample *vlc[ 3 ];
+  int num_vlc[ 3 ];
+  uint8_t *vlc_bytes;
+  uint32_t vlc_bytes_used;
+
+  int max_stride;
+};
+
+static Samples samples;
+static const mpeg2_kernels_t *real_kernels;
+
+static int alignment( const void *ptr )
+{
+  return (uintptr_t)ptr & 63;
+}
+
+static void note_stride( int stride )
+{
+  if ( stride > samples.max_stride ) {
+    samples.max_stride = stride;
+  }
+}
+
+static IDCTSample *capture_idct( int kind, const int16_t *block, int blocks,
+				 uint8_t *dest, int stride )
+{
+  if ( samples.num_idct[ kind ] == max_samples ) {
+    return NULL;
+  }
+
+  IDCTSample *s = &samples.idct[ kind ][ samples.num_idct[ kind ]++ ];
+  memcpy( s->block, block, blocks * 64 * sizeof( int16_t ) );
+  s->stride = stride;
+  s->dest_align = alignment( dest );
+  note_stride( stride );
+  return s;
+}
+
+static void capture_idct_copy( int16_t *block, uint8_t *dest, int stride )
+{
+  capture_idct( IDCT_COPY, block, 1, dest, stride );
+  real_kernels->idct_copy( block, dest, stride );
+}
+
+static void capture_idct_add( int last, int16_t *block, uint8_t *dest, int stride )
+{
+  IDCTSample *s = capture_idct( IDCT_ADD, block, 1, dest, stride );
+  if ( s ) {
+    s->last[ 0 ] = last;
+  }
+  real_kernels->idct_add( last, block, dest, stride );
+}
+
+static void capture_idct_copy2( int16_t *block, uint8_t *dest, int stride )
+{
+  capture_idct( IDCT_COPY2, block, 2, dest, stride );
+  real_kernels->idct_copy2( block, dest, stride );
+}
+
+static void capture_idct_add2( int last0, int last1, int16_t *block,
+			       uint8_t *dest, int stride )
+{
+  IDCTSample *s = capture_idct( IDCT_ADD2, block, 2, dest, stride );
+  if ( s ) {
+    s->last[ 0 ] = last0;
+    s->last[ 1 ] = last1;
+  }
+  real_kernels->idct_add2( last0, last1, block, dest, stride );
+}
+
+static mpeg2_mc_fct *mc_entry( const mpeg2_mc_t *mc, int entry )
+{
+  return (entry < 8) ? mc->put[ entry ] : mc->avg[ entry - 8 ];
+}
+
+static void capture_mc( int entry, uint8_t *dest, const uint8_t *ref,
+			int stride, int height )
+{
+  if ( samples.num_mc[ entry ] < max_samples ) {
+    MCSample *s = &samples.mc[ entry ][ samples.num_mc[ entry ]++ ];
+    s->stride = stride;
+    s->height = height;
+    s->dest_align = alignment( dest );
+    s->ref_align = alignment( ref );
+    note_stride( stride );
+  }
+
+  mc_entry( real_kernels->mc, entry )( dest, ref, stride, height );
+}
+
+/* The C reference: (a+b+1)>>1 at half-pel positions and (a+b+c+d+2)>>2
+   at the centre, then averaged with dest for the avg entries */
+static inline void reference_mc( int entry, uint8_t *dest, const uint8_t *ref,
+				 int stride, int height )
+{
+  int width = (entry & 4) ? 8 : 16;
+  int dx = entry & 1;
+  int dy = (entry >> 1) & 1;
+  bool avg = entry >= 8;
+
+  for ( int row = 0; row < height; row++ ) {
+    for ( int i = 0; i < width; i++ ) {
+      const uint8_t *p = ref + i;
+      int val;
+      if ( dx && dy ) {
+	val = (p[ 0 ] + p[ 1 ] + p[ stride ] + p[ stride + 1 ] + 2) >> 2;
+      } else if ( dx || dy ) {
+	val = (p[ 0 ] + p[ dx + dy * stride ] + 1) >> 1;
+      } else {
+	val = p[ 0 ];
+      }
+      dest[ i ] = avg ? (dest[ i ] + val + 1) >> 1 : val;
+    }
+    ref += stride;
+    dest += stride;
+  }
+}
+
+#define MC_ENTRY( n )							\
+  static void capture_mc_##n( uint8_t *dest, const uint8_t *ref,	\
+			      int stride, int height )			\
+  { capture_mc( n, dest, ref, stride, height ); }			\
+  static void reference_mc_##n( uint8_t *dest, const uint8_t *ref,	\
+				int stride, int height )		\
+  { reference_mc( n, dest, ref, stride, height ); }
+
+MC_ENTRY( 0 ) MC_ENTRY( 1 ) MC_ENTRY( 2 ) MC_ENTRY( 3 )
+MC_ENTRY( 4 ) MC_ENTRY( 5 ) MC_ENTRY( 6 ) MC_ENTRY( 7 )
+MC_ENTRY( 8 ) MC_ENTRY( 9 ) MC_ENTRY( 10 ) MC_ENTRY( 11 )
+MC_ENTRY( 12 ) MC_ENTRY( 13 ) MC_ENTRY( 14 ) MC_ENTRY( 15 )
+
+static mpeg2_mc_t capture_mc_table = {
+  { capture_mc_0, capture_mc_1, capture_mc_2, capture_mc_3,
+    capture_mc_4, capture_mc_5, capture_mc_6, capture_mc_7 },
+  { capture_mc_8, capture_mc_9, capture_mc_10, capture_mc_11,
+    capture_mc_12, capture_mc_13, capture_mc_14, capture_mc_15 } };
+
+static mpeg2_mc_t reference_mc_table = {
+  { reference_mc_0, reference_mc_1, reference_mc_2, reference_mc_3,
+    reference_mc_4, reference_mc_5, reference_mc_6, reference_mc_7 },
+  { reference_mc_8, reference_mc_9, reference_mc_10, reference_mc_11,
+    reference_mc_12, reference_mc_13, reference_mc_14, reference_mc_15 } };
+
+void mpeg2_capture_slice( mpeg2_decoder_t *decoder )
+{
+  decoder->idct_copy = capture_idct_copy;
+  decoder->idct_add = capture_idct_add;
+  decoder->idct_copy2 = capture_idct_copy2;
+  decoder->idct_add2 = capture_idct_add2;
+  decoder->mc_put = capture_mc_table.put;
+  decoder->mc_avg = capture_mc_table.avg;
+}
+
+void mpeg2_capture_block( const mpeg2_decoder_t *decoder, int parser,
+			  const int16_t *block, const uint16_t *quant_matrix )
+{
+  if ( samples.num_vlc[ parser ] == max_samples ) {
+    return;
+  }
+
+  VLCSample *s = &samples.vlc[ parser ][ samples.num_vlc[ parser ]++ ];
+  s->bitstream_buf = decoder->bitstream_buf;
+  s->bitstream_bits = decoder->bitstream_bits;
+  s->offset = samples.vlc_bytes_used;
+  /* The parser may already have read past the end, which it treats as zeros */
+  ptrdiff_t len = decoder->bit_ptr_end - decoder->bitstream_ptr;
+  s->len = (len < 0) ? 0 : (len > max_vlc_bytes) ? max_vlc_bytes : len;
+  s->scan = decoder->scan;
+  s->dc = block[ 0 ];
+  memcpy( s->quant_matrix, quant_matrix, sizeof( s->quant_matrix ) );
+
+  memcpy( samples.vlc_bytes + s->offset, decoder->bitstream_ptr, s->len );
+  samples.vlc_bytes_used += s->len;
+}
+
+/* The C reference IDCT, in double precision. The block is in the
+   permuted order the SIMD IDCTs use (column c stored at
+   (c>>1)|((c&1)<<2)) and scaled by 16. */
+static void reference_idct( const int16_t *block, int out[ 64 ] )
+{
+  static double basis[ 8 ][ 8 ];
+  static bool initialized = false;
+
+  if ( !initialized ) {
+    for ( int x = 0; x < 8; x++ ) {
+      for ( int u = 0; u < 8; u++ ) {
+	basis[ x ][ u ] = (u ? 0.5 : sqrt( 0.125 )) * cos( (2 * x + 1) * u * M_PI / 16 );
+      }
+    }
+    initialized = true;
+  }
+
+  double rows[ 8 ][ 8 ];
+  for ( int v = 0; v < 8; v++ ) {
+    for ( int x = 0; x < 8; x++ ) {
+      double sum = 0;
+      for ( int u = 0; u < 8; u++ ) {
+	sum += basis[ x ][ u ] * block[ 8 * v + ((u >> 1) | ((u & 1) << 2)) ];
+      }
+      rows[ v ][ x ] = sum / 16;
+    }
+  }
+
+  for ( int y = 0; y < 8; y++ ) {
+    for ( int x = 0; x < 8; x++ ) {
+      double sum = 0;
+      for ( int v = 0; v < 8; v++ ) {
+	sum += basis[ y ][ v ] * rows[ v ][ x ];
+      }
+      out[ 8 * y + x ] = (int)floor( sum + 0.5 );
+    }
+  }
+}
+
+static uint8_t clip( int val )
+{
+  return (val < 0) ? 0 : (val > 255) ? 255 : val;
+}
+
+static void reference_idct_copy( int16_t *block, uint8_t *dest, int stride )
+{
+  int out[ 64 ];
+  reference_idct( block, out );
+  for ( int i = 0; i < 64; i++ ) {
+    dest[ (i / 8) * stride + (i % 8) ] = clip( out[ i ] );
+  }
+  memset( block, 0, 64 * sizeof( int16_t ) );
+}
+
+static void reference_idct_add( int, int16_t *block, uint8_t *dest, int stride )
+{
+  int out[ 64 ];
+  reference_idct( block, out );
+  for ( int i = 0; i < 64; i++ ) {
+    uint8_t *pixel = dest + (i / 8) * stride + (i % 8);
+    *pixel = clip( *pixel + out[ i ] );
+  }
+  memset( block, 0, 64 * sizeof( int16_t ) );
+}
+
+static void reference_idct_copy2( int16_t *block, uint8_t *dest, int stride )
+{
+  reference_idct_copy( block, dest, stride );
+  reference_idct_copy( block + 64, dest + 8, stride );
+}
+
+static void reference_idct_add2( int last0, int last1, int16_t *block,
+				 uint8_t *dest, int stride )
+{
+  reference_idct_add( last0, block, dest, stride );
+  reference_idct_add( last1, block + 64, dest + 8, stride );
+}
+
+static const mpeg2_kernels_t reference_kernels = {
+  "c", 0, reference_idct_copy, reference_idct_add,
+  reference_idct_copy2, reference_idct_add2, &reference_mc_table, false };
+
+/* Best of several passes, in nanoseconds and TSC cycles */
+class Stopwatch
+{
+private:
+  double start_ns, best_ns;
+  uint64_t start_cycles, best_cycles;
+
+  static double now( void )
+  {
+    struct timespec ts;
+    unixassert( clock_gettime( CLOCK_MONOTONIC, &ts ) );
+    return ts.tv_sec * 1000000000.0 + ts.tv_nsec;
+  }
+
+public:
+  Stopwatch() : start_ns( 0 ), best_ns( 1e300 ), start_cycles( 0 ), best_cycles( UINT64_MAX ) {}
+
+  void start( void )
+  {
+    start_ns = now();
+    start_cycles = __rdtsc();
+  }
+
+  void stop( void )
+  {
+    uint64_t cycles = __rdtsc() - start_cycles;
+    double ns = now() - start_ns;
+    if ( ns < best_ns ) best_ns = ns;
+    if ( cycles < best_cycles ) best_cycles = cycles;
+  }
+
+  double get_ns( void ) { return best_ns; }
+  double get_cycles( void ) { return best_cycles; }
+};
+
+/* Work areas the kernels are replayed into: destination (and reference)
+   addresses walk across a few macroblock rows of a frame, keeping the
+   captured stride and alignment within a cache line. The area stays in
+   cache, so the times are for the kernels rather than for memory. */
+static int16_t work_block[ 128 ] ATTR_ALIGN(64);
+static uint8_t *dest_frame, *ref_frame;
+static const int frame_mb_rows = 4;
+static const int frame_rows = 16 * (frame_mb_rows + 1) + 1;
+
+static int frame_position( int i, int stride )
+{
+  int across = (stride > 128) ? stride / 64 - 1 : 1;
+  return ((i / across) % frame_mb_rows) * 16 * stride + (i % across) * 64;
+}
+
+static void idct_pass( const mpeg2_kernels_t *k, int kind, bool run )
+{
+  const IDCTSample *s = samples.idct[ kind ];
+  size_t size = (kind >= IDCT_COPY2 ? 128 : 64) * sizeof( int16_t );
+
+  for ( int i = 0; i < samples.num_idct[ kind ]; i++, s++ ) {
+    memcpy( work_block, s->block, size );
+    uint8_t *dest = dest_frame + frame_position( i, s->stride ) + s->dest_align;
+    if ( !run ) continue;
+
+    switch ( kind ) {
+    case IDCT_COPY: k->idct_copy( work_block, dest, s->stride ); break;
+    case IDCT_ADD: k->idct_add( s->last[ 0 ], work_block, dest, s->stride ); break;
+    case IDCT_COPY2: k->idct_copy2( work_block, dest, s->stride ); break;
+    case IDCT_ADD2: k->idct_add2( s->last[ 0 ], s->last[ 1 ], work_block, dest, s->stride ); break;
+    }
+  }
+}
+
+static void mc_pass( const mpeg2_kernels_t *k, int entry )
+{
+  const MCSample *s = samples.mc[ entry ];
+  mpeg2_mc_fct *fct = mc_entry( k->mc, entry );
+
+  for ( int i = 0; i < samples.num_mc[ entry ]; i++, s++ ) {
+    int pos = frame_position( i, s->stride );
+    fct( dest_frame + pos + s->dest_align, ref_frame + pos + s->ref_align,
+	 s->stride, s->height );
+  }
+}
+
+static mpeg2_decoder_t vlc_decoder;
+static int16_t parse_block[ 64 ] ATTR_ALIGN(16);
+
+static void vlc_pass( int parser, bool run )
+{
+  const VLCSample *s = samples.vlc[ parser ];
+  mpeg2_decoder_t *d = &vlc_decoder;
+
+  for ( int i = 0; i < samples.num_vlc[ parser ]; i++, s++ ) {
+    memset( parse_block, 0, sizeof( parse_block ) );
+    parse_block[ 0 ] = s->dc;
+    d->bitstream_buf = s->bitstream_buf;
+    d->bitstream_bits = s->bitstream_bits;
+    d->bitstream_ptr = samples.vlc_bytes + s->offset;
+    d->bit_ptr_end = d->bitstream_ptr + s->len;
+    d->scan = s->scan;
+    if ( !run ) continue;
+
+    switch ( parser ) {
+    case MPEG2_BLOCK_INTRA_B14: mpeg2_get_intra_block_B14( d, parse_block, s->quant_matrix ); break;
+    case MPEG2_BLOCK_INTRA_B15: mpeg2_get_intra_block_B15( d, parse_block, s->quant_matrix ); break;
+    case MPEG2_BLOCK_NON_INTRA: mpeg2_get_non_intra_block( d, parse_block, s->quant_matrix ); break;
+    }
+  }
+}
+
+/* Largest per-pixel difference from the C reference, and how many
+   pixels differ at all */
+class Difference
+{
+public:
+  int max, pixels, beyond_one, total;
+
+  Difference() : max( 0 ), pixels( 0 ), beyond_one( 0 ), total( 0 ) {}
+
+  void compare( const uint8_t *a, const uint8_t *b, int width, int height, int stride )
+  {
+    for ( int row = 0; row < height; row++ ) {
+      for ( int i = 0; i < width; i++ ) {
+	int diff = abs( a[ row * stride + i ] - b[ row * stride + i ] );
+	if ( diff > max ) max = diff;
+	if ( diff ) pixels++;
+	if ( diff > 1 ) beyond_one++;
+	total++;
+      }
+    }
+  }
+
+  void print( void )
+  {
+    if ( !pixels ) {
+      printf( "   exact\n" );
+    } else {
+      printf( "   max %d, %.3f%% of pixels differ, %.3f%% by more than 1\n",
+	      max, 100.0 * pixels / total, 100.0 * beyond_one / total );
+    }
+  }
+};
+
+static const int check_stride = 32;
+static const int max_mc_checks = 4096;
+
+static void fill( uint8_t *buf, int len )
+{
+  static uint32_t seed = 1;
+  for ( int i = 0; i < len; i++ ) {
+    seed = seed * 1103515245 + 12345;
+    buf[ i ] = seed >> 24;
+  }
+}
+
+static Difference idct_check( const mpeg2_kernels_t *k, int kind )
+{
+  Difference diff;
+  int width = (kind >= IDCT_COPY2) ? 16 : 8;
+  uint8_t expected[ 8 * check_stride ], actual[ 8 * check_stride ];
+  int16_t block[ 128 ] ATTR_ALIGN(64);
+
+  for ( int i = 0; i < samples.num_idct[ kind ]; i++ ) {
+    const IDCTSample *s = &samples.idct[ kind ][ i ];
+    fill( expected, sizeof( expected ) );
+    memcpy( actual, expected, sizeof( actual ) );
+
+    memcpy( work_block, s->block, sizeof( work_block ) );
+    memcpy( block, s->block, sizeof( block ) );
+
+    switch ( kind ) {
+    case IDCT_COPY:
+      reference_kernels.idct_copy( work_block, expected, check_stride );
+      k->idct_copy( block, actual, check_stride );
+      break;
+    case IDCT_ADD:
+      reference_kernels.idct_add( s->last[ 0 ], work_block, expected, check_stride );
+      k->idct_add( s->last[ 0 ], block, actual, check_stride );
+      break;
+    case IDCT_COPY2:
+      reference_kernels.idct_copy2( work_block, expected, check_stride );
+      k->idct_copy2( block, actual, check_stride );
+      break;
+    case IDCT_ADD2:
+      reference_kernels.idct_add2( s->last[ 0 ], s->last[ 1 ], work_block, expected, check_stride );
+      k->idct_add2( s->last[ 0 ], s->last[ 1 ], block, actual, check_stride );
+      break;
+    }
+
+    if ( k->emms ) _mm_empty();
+
+    diff.compare( expected, actual, width, 8, check_stride );
+  }
+
+  return diff;
+}
+
+static Difference mc_check( const mpeg2_kernels_t *k, int entry )
+{
+  Difference diff;
+  int width = (entry & 4) ? 8 : 16;
+  uint8_t ref[ 17 * check_stride ];
+  uint8_t expected[ 16 * check_stride ], actual[ 16 * check_stride ];
+
+  for ( int i = 0; (i < samples.num_mc[ entry ]) && (i < max_mc_checks); i++ ) {
+    int height = samples.mc[ entry ][ i ].height;
+    fill( ref, sizeof( ref ) );
+    fill( expected, sizeof( expected ) );
+    memcpy( actual, expected, sizeof( actual ) );
+
+    mc_entry( reference_kernels.mc, entry )( expected, ref, check_stride, height );
+    mc_entry( k->mc, entry )( actual, ref, check_stride, height );
+    if ( k->emms ) _mm_empty();
+
+    diff.compare( expected, actual, width, height, check_stride );
+  }
+
+  return diff;
+}
+
+static void print_row( const char *kernel, const char *set, int calls,
+		       double ns, double cycles, int pixels )
+{
+  printf( "  %-10s %-7s %7d %9.1f %12.3f", kernel, set, calls,
+	  ns / calls, cycles / pixels );
+}
+
+int main( int argc, char *argv[] )
+{
+  if ( (argc != 2) && (argc != 3) ) {
+    fprintf( stderr, "USAGE: %s FILENAME [PICTURES]\n", argv[ 0 ] );
+    fprintf( stderr, "Captures kernel inputs from the first PICTURES pictures (default 60)\n" );
+    exit( 1 );
+  }
+
+  File *file = new File( argv[ 1 ] );
+  ES *stream = new ES( file, &progress_bar, 0 );
+
+  int pictures = (argc == 3) ? atoi( argv[ 2 ] ) : 60;
+  if ( (pictures <= 0) || (pictures > (int)stream->get_num_pictures()) ) {
+    pictures = stream->get_num_pictures();
+  }
+
+  /* Capture */
+  for ( int kind = 0; kind < IDCT_KINDS; kind++ ) {
+    samples.idct[ kind ] = new IDCTSample[ max_samples ];
+  }
+  for ( int entry = 0; entry < 16; entry++ ) {
+    samples.mc[ entry ] = new MCSample[ max_samples ];
+  }
+  for ( int parser = 0; parser < 3; parser++ ) {
+    samples.vlc[ parser ] = new VLCSample[ max_samples ];
+  }
+  samples.vlc_bytes = new uint8_t[ 3 * max_samples * max_vlc_bytes ];
+
+  real_kernels = mpeg2_kernels();
+
+  for ( int i = 0; i < pictures; i++ ) {
+    stream->get_picture_displayed( i )->lock_and_decodeall();
+    stream->get_picture_displayed( i )->get_framehandle()->decrement_lockcount();
+  }
+
+  printf( "Captured from %d pictures of %s, timed as best of %d passes.\n",
+	  pictures, argv[ 1 ], passes );
+  printf( "Cycles are TSC cycles; the setup each call needs (restoring the\n"
+	  "coefficients, resetting the bitstream) is timed separately and\n"
+	  "subtracted.\n" );
+
+  /* The sets to compare: the C reference, then what this CPU supports */
+  int num_sets;
+  const mpeg2_kernels_t *all_sets = mpeg2_kernel_sets( &num_sets );
+  const mpeg2_kernels_t **sets = new const mpeg2_kernels_t *[ num_sets + 1 ];
+  int count = 0;
+  uint32_t accel = mpeg2_detect_accel( 0 );
+
+  sets[ count++ ] = &reference_kernels;
+  for ( int i = 0; i < num_sets; i++ ) {
+    if ( accel & all_sets[ i ].accel ) {
+      sets[ count++ ] = &all_sets[ i ];
+    }
+  }
+
+  int stride = (samples.max_stride + 63) & ~63;
+  size_t frame_size = stride * frame_rows;
+  dest_frame = new uint8_t[ frame_size ];
+  ref_frame = new uint8_t[ frame_size ];
+  fill( dest_frame, frame_size );
+  fill( ref_frame, frame_size );
+
+  /* IDCT */
+  printf( "\nIDCT         set       calls   ns/call cycles/pixel   vs C reference\n" );
+  for ( int kind = 0; kind < IDCT_KINDS; kind++ ) {
+    int calls = samples.num_idct[ kind ];
+    if ( !calls ) continue;
+
+    Stopwatch setup;
+    for ( int pass = 0; pass < passes; pass++ ) {
+      setup.start();
+      idct_pass( NULL, kind, false );
+      setup.stop();
+    }
+
+    for ( int i = 0; i < count; i++ ) {
+      Stopwatch watch;
+      for ( int pass = 0; pass < passes; pass++ ) {
+	watch.start();
+	idct_pass( sets[ i ], kind, true );
+	if ( sets[ i ]->emms ) _mm_empty();
+	watch.stop();
+      }
+
+      int pixels = calls * ((kind >= IDCT_COPY2) ? 128 : 64);
+      print_row( idct_names[ kind ], sets[ i ]->name, calls,
+		 watch.get_ns() - setup.get_ns(),
+		 watch.get_cycles() - setup.get_cycles(), pixels );
+      if ( i == 0 ) {
+	printf( "   -\n" );
+      } else {
+	idct_check( sets[ i ], kind ).print();
+      }
+    }
+  }
+
+  /* Motion compensation */
+  static const char *mc_positions[ 4 ] = { "o", "x", "y", "xy" };
+  printf( "\nMC           set       calls   ns/call cycles/pixel   vs C reference\n" );
+  for ( int entry = 0; entry < 16; entry++ ) {
+    const MCSample *s = samples.mc[ entry ];
+    int calls = samples.num_mc[ entry ];
+    if ( !calls ) continue;
+
+    int pixels = 0;
+    for ( int i = 0; i < calls; i++ ) {
+      pixels += s[ i ].height * ((entry & 4) ? 8 : 16);
+    }
+
+    char name[ 16 ];
+    snprintf( name, 16, "%s %s %d", (entry < 8) ? "put" : "avg",
+	      mc_positions[ entry & 3 ], (entry & 4) ? 8 : 16 );
+
+    for ( int i = 0; i < count; i++ ) {
+      Stopwatch watch;
+      for ( int pass = 0; pass < passes; pass++ ) {
+	watch.start();
+	mc_pass( sets[ i ], entry );
+	if ( sets[ i ]->emms ) _mm_empty();
+	watch.stop();
+      }
+
+      print_row( name, sets[ i ]->name, calls, watch.get_ns(),
+		 watch.get_cycles(), pixels );
+      if ( i == 0 ) {
+	printf( "   -\n" );
+      } else {
+	mc_check( sets[ i ], entry ).print();
+      }
+    }
+  }
+
+  /* Coefficient parsing */
+  printf( "\nParse        set       calls   ns/call cycles/pixel\n" );
+  for ( int parser = 0; parser < 3; parser++ ) {
+    int calls = samples.num_vlc[ parser ];
+    if ( !calls ) continue;
+
+    Stopwatch setup, watch;
+    for ( int pass = 0; pass < passes; pass++ ) {
+      setup.start();
+      vlc_pass( parser, false );
+      setup.stop();
+
+      watch.start();
+      vlc_pass( parser, true );
+      watch.stop();
+    }
+
+    print_row( vlc_names[ parser ], "c", calls,
+	       watch.get_ns() - setup.get_ns(),
+	       watch.get_cycles() - setup.get_cycles(), 64 * calls );
+    printf( "\n" );
+  }
+
+  delete[] sets;
+  delete[] dest_frame;
+  delete[] ref_frame;
+  delete[] samples.vlc_bytes;
+  for ( int parser = 0; parser < 3; parser++ ) {
+    delete[] samples.vlc[ parser ];
+  }
+  for ( int entry = 0; entry < 16; entry++ ) {
+    delete[] samples.mc[ entry ];
+  }
+  for ( int kind = 0; kind < IDCT_KINDS; kind++ ) {
+    delete[] samples.idct[ kind ];
+  }
+
+  delete stream;
+  delete file;
+
+  return 0;
+}
@@ -0,0 +1,161 @@
+/*
+ * motion_comp_avx2.cpp
+ *
+ * AVX2 motion compensation. A 16-pixel block is handled two rows per
+ * register (one row in each 128-bit lane), and an 8-pixel block two
+ * rows per 128-bit register. Bit-exact with motion_comp_sse2.cpp.
+ */
+
+#include "config.h"
+
+#if defined(ARCH_X86) || defined(ARCH_X86_64)
+
+#pragma GCC target ("avx2")
+
+#include <inttypes.h>
+#include <immintrin.h>
+
+#include "mpeg2.h"
+#include "attributes.h"
+#include "mpeg2_internal.h"
+
+/* Two 16-pixel rows, stride apart, in one register */
+static inline __m256i load16x2 (const uint8_t * const p, const int stride)
+{
+    return _mm256_inserti128_si256
+	(_mm256_castsi128_si256 (_mm_loadu_si128 ((const __m128i *) p)),
+	 _mm_loadu_si128 ((const __m128i *) (p + stride)), 1);
+}
+
+static inline void store16x2 (uint8_t * const p, const int stride,
+			      const __m256i x)
+{
+    _mm_storeu_si128 ((__m128i *) p, _mm256_castsi256_si128 (x));
+    _mm_storeu_si128 ((__m128i *) (p + stride),
+		      _mm256_extracti128_si256 (x, 1));
+}
+
+/* Two 8-pixel rows, stride apart, in one register */
+static inline __m128i load8x2 (const uint8_t * const p, const int stride)
+{
+    return _mm_castpd_si128
+	(_mm_loadh_pd (_mm_castsi128_pd (_mm_loadl_epi64 ((const __m128i *) p)),
+		       (const double *) (p + stride)));
+}
+
+static inline void store8x2 (uint8_t * const p, const int stride,
+			     const __m128i x)
+{
+    _mm_storel_epi64 ((__m128i *) p, x);
+    _mm_storeh_pd ((double *) (p + stride), _mm_castsi128_pd (x));
+}
+
+/* (a+b+c+d+2)>>2 */
+static inline __m256i avg4_256 (const __m256i a, const __m256i b,
+				const __m256i c, const __m256i d)
+{
+    const __m256i ab = _mm256_avg_epu8 (a, b);
+    const __m256i cd = _mm256_avg_epu8 (c, d);
+    __m256i k;
+
+    k = _mm256_or_si256 (_mm256_xor_si256 (a, b), _mm256_xor_si256 (c, d));
+    k = _mm256_and_si256 (k, _mm256_xor_si256 (ab, cd));
+    k = _mm256_and_si256 (k, _mm256_set1_epi8 (1));
+    return _mm256_subs_epu8 (_mm256_avg_epu8 (ab, cd), k);
+}
+
+static inline __m128i avg4_128 (const __m128i a, const __m128i b,
+				const __m128i c, const __m128i d)
+{
+    const __m128i ab = _mm_avg_epu8 (a, b);
+    const __m128i cd = _mm_avg_epu8 (c, d);
+    __m128i k;
+
+    k = _mm_or_si128 (_mm_xor_si128 (a, b), _mm_xor_si128 (c, d));
+    k = _mm_and_si128 (k, _mm_xor_si128 (ab, cd));
+    k = _mm_and_si128 (k, _mm_set1_epi8 (1));
+    return _mm_subs_epu8 (_mm_avg_epu8 (ab, cd), k);
+}
+
+static inline __m256i pred16x2 (const uint8_t * const ref, const int stride,
+				const int dx, const int dy)
+{
+    if (dx && dy)
+	return avg4_256 (load16x2 (ref, stride), load16x2 (ref + 1, stride),
+			 load16x2 (ref + stride, stride),
+			 load16x2 (ref + stride + 1, stride));
+    else if (dx || dy)
+	return _mm256_avg_epu8 (load16x2 (ref, stride),
+				load16x2 (ref + dx + dy * stride, stride));
+    else
+	return load16x2 (ref, stride);
+}
+
+static inline __m128i pred8x2 (const uint8_t * const ref, const int stride,
+			       const int dx, const int dy)
+{
+    if (dx && dy)
+	return avg4_128 (load8x2 (ref, stride), load8x2 (ref + 1, stride),
+			 load8x2 (ref + stride, stride),
+			 load8x2 (ref + stride + 1, stride));
+    else if (dx || dy)
+	return _mm_avg_epu8 (load8x2 (ref, stride),
+			     load8x2 (ref + dx + dy * stride, stride));
+    else
+	return load8x2 (ref, stride);
+}
+
+static inline void MC_16_avx2 (int height, uint8_t * dest,
+			       const uint8_t * ref, const int stride,
+			       const int dx, const int dy, const int avg)
+{
+    do {
+	__m256i p = pred16x2 (ref, stride, dx, dy);
+	if (avg)
+	    p = _mm256_avg_epu8 (p, load16x2 (dest, stride));
+	store16x2 (dest, stride, p);
+	ref += 2 * stride;
+	dest += 2 * stride;
+    } while (height -= 2);
+}
+
+static inline void MC_8_avx2 (int height, uint8_t * dest,
+			      const uint8_t * ref, const int stride,
+			      const int dx, const int dy, const int avg)
+{
+    do {
+	__m128i p = pred8x2 (ref, stride, dx, dy);
+	if (avg)
+	    p = _mm_avg_epu8 (p, load8x2 (dest, stride));
+	store8x2 (dest, stride, p);
+	ref += 2 * stride;
+	dest += 2 * stride;
+    } while (height -= 2);
+}
+
+#define MC_FUNC(op,avg,xy,dx,dy)					\
+static void MC_##op##_##xy##_16_avx2 (uint8_t * dest,			\
+				      const uint8_t * ref,		\
+				      int stride, int height)		\
+{									\
+    MC_16_avx2 (height, dest, ref, stride, dx, dy, avg);		\
+}									\
+static void MC_##op##_##xy##_8_avx2 (uint8_t * dest,			\
+				     const uint8_t * ref,		\
+				     int stride, int height)		\
+{									\
+    MC_8_avx2 (height, dest, ref, stride, dx, dy, avg);			\
+}
+
+MC_FUNC (put, 0, o, 0, 0)
+MC_FUNC (put, 0, x, 1, 0)
+MC_FUNC (put, 0, y, 0, 1)
+MC_FUNC (put, 0, xy, 1, 1)
+MC_FUNC (avg, 1, o, 0, 0)
+MC_FUNC (avg, 1, x, 1, 0)
+MC_FUNC (avg, 1, y, 0, 1)
+MC_FUNC (avg, 1, xy, 1, 1)
+
+MPEG2_MC_EXTERN (avx2)
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ * motion_comp_lowres.cpp
+ *
+ * Motion compensation for half- and quarter-resolution decoding. The
+ * half-pel vectors of the full-size picture land on 1/4 (or 1/8) pel
+ * positions of the reduced picture, so the prediction is a bilinear
+ * interpolation with those weights rather than the MPEG-2 half-pel
+ * average.
+ */
+
+#include <inttypes.h>
+
+#include "mpeg2.h"
+#include "attributes.h"
+#include "mpeg2_internal.h"
+
+#define MC_LOOP(interp)						\
+do {									\
+    int i, j;								\
+    if (avg)								\
+	for (i = 0; i < height; i++, dest += stride, ref += stride)	\
+	    for (j = 0; j < width; j++)					\
+		dest[j] = (dest[j] + (interp) + 1) >> 1;		\
+    else								\
+	for (i = 0; i < height; i++, dest += stride, ref += stride)	\
+	    for (j = 0; j < width; j++)					\
+		dest[j] = (interp);					\
+} while (0)
+
+/* The interpolation only reads the neighbouring row or column when its
+   weight is non-zero, so a block at the edge of the picture never
+   touches memory outside the plane. */
+void mpeg2_mc_lowres (uint8_t * dest, const uint8_t * ref, const int stride,
+		      const int width, const int height,
+		      const int fx, const int fy, const int lowres,
+		      const int avg)
+{
+    const int one = 2 << lowres;
+    const int shift = 2 * (lowres + 1);
+    const int round = 1 << (shift - 1);
+    const int A = (one - fx) * (one - fy);
+    const int B = fx * (one - fy);
+    const int C = (one - fx) * fy;
+    const int D = fx * fy;
+
+    if (D)
+	MC_LOOP ((A * ref[j] + B * ref[j + 1] + C * ref[j + stride] +
+		  D * ref[j + stride + 1] + round) >> shift);
+    else if (B)
+	MC_LOOP ((A * ref[j] + B * ref[j + 1] + round) >> shift);
+    else if (C)
+	MC_LOOP ((A * ref[j] + C * ref[j + stride] + round) >> shift);
+    else
+	MC_LOOP (ref[j]);
+}
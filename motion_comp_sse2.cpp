@@ -0,0 +1,137 @@
+/*
+ * motion_comp_sse2.cpp
+ *
+ * SSE2 motion compensation. A 16-pixel row is one register, and an
+ * 8-pixel block is handled two rows per register. Nothing here touches
+ * the MMX registers, so no emms is needed afterwards.
+ *
+ * The results are bit-exact with mpeg2_mc_mmxext (and the C reference):
+ * half-pel positions are (a+b+1)>>1 via pavgb, and the centre position
+ * is (a+b+c+d+2)>>2, computed as the average of two averages minus a
+ * correction bit where both rounded up.
+ */
+
+#include "config.h"
+
+#if defined(ARCH_X86) || defined(ARCH_X86_64)
+
+#include <inttypes.h>
+#include <emmintrin.h>
+
+#include "mpeg2.h"
+#include "attributes.h"
+#include "mpeg2_internal.h"
+
+#define LOAD16(p) _mm_loadu_si128 ((const __m128i *) (p))
+#define STORE16(p,x) _mm_storeu_si128 ((__m128i *) (p), (x))
+
+/* Two 8-pixel rows, stride apart, in one register */
+static inline __m128i load8x2 (const uint8_t * const p, const int stride)
+{
+    return _mm_castpd_si128
+	(_mm_loadh_pd (_mm_castsi128_pd (_mm_loadl_epi64 ((const __m128i *) p)),
+		       (const double *) (p + stride)));
+}
+
+static inline void store8x2 (uint8_t * const p, const int stride,
+			     const __m128i x)
+{
+    _mm_storel_epi64 ((__m128i *) p, x);
+    _mm_storeh_pd ((double *) (p + stride), _mm_castsi128_pd (x));
+}
+
+/* (a+b+c+d+2)>>2 */
+static inline __m128i avg4 (const __m128i a, const __m128i b,
+			    const __m128i c, const __m128i d)
+{
+    const __m128i ab = _mm_avg_epu8 (a, b);
+    const __m128i cd = _mm_avg_epu8 (c, d);
+    __m128i k;
+
+    k = _mm_or_si128 (_mm_xor_si128 (a, b), _mm_xor_si128 (c, d));
+    k = _mm_and_si128 (k, _mm_xor_si128 (ab, cd));
+    k = _mm_and_si128 (k, _mm_set1_epi8 (1));
+    return _mm_subs_epu8 (_mm_avg_epu8 (ab, cd), k);
+}
+
+/* Prediction from offsets dx, dy in {0, 1} */
+static inline __m128i pred16 (const uint8_t * const ref, const int stride,
+			      const int dx, const int dy)
+{
+    if (dx && dy)
+	return avg4 (LOAD16 (ref), LOAD16 (ref + 1),
+		     LOAD16 (ref + stride), LOAD16 (ref + stride + 1));
+    else if (dx || dy)
+	return _mm_avg_epu8 (LOAD16 (ref), LOAD16 (ref + dx + dy * stride));
+    else
+	return LOAD16 (ref);
+}
+
+static inline __m128i pred8x2 (const uint8_t * const ref, const int stride,
+			       const int dx, const int dy)
+{
+    if (dx && dy)
+	return avg4 (load8x2 (ref, stride), load8x2 (ref + 1, stride),
+		     load8x2 (ref + stride, stride),
+		     load8x2 (ref + stride + 1, stride));
+    else if (dx || dy)
+	return _mm_avg_epu8 (load8x2 (ref, stride),
+			     load8x2 (ref + dx + dy * stride, stride));
+    else
+	return load8x2 (ref, stride);
+}
+
+static inline void MC_16_sse2 (int height, uint8_t * dest,
+			       const uint8_t * ref, const int stride,
+			       const int dx, const int dy, const int avg)
+{
+    do {
+	__m128i p = pred16 (ref, stride, dx, dy);
+	if (avg)
+	    p = _mm_avg_epu8 (p, LOAD16 (dest));
+	STORE16 (dest, p);
+	ref += stride;
+	dest += stride;
+    } while (--height);
+}
+
+static inline void MC_8_sse2 (int height, uint8_t * dest,
+			      const uint8_t * ref, const int stride,
+			      const int dx, const int dy, const int avg)
+{
+    do {
+	__m128i p = pred8x2 (ref, stride, dx, dy);
+	if (avg)
+	    p = _mm_avg_epu8 (p, load8x2 (dest, stride));
+	store8x2 (dest, stride, p);
+	ref += 2 * stride;
+	dest += 2 * stride;
+    } while (height -= 2);
+}
+
+#define MC_FUNC(op,avg,xy,dx,dy)					\
+static void MC_##op##_##xy##_16_sse2 (uint8_t * dest,			\
+				      const uint8_t * ref,		\
+				      int stride, int height)		\
+{									\
+    MC_16_sse2 (height, dest, ref, stride, dx, dy, avg);		\
+}									\
+static void MC_##op##_##xy##_8_sse2 (uint8_t * dest,			\
+				     const uint8_t * ref,		\
+				     int stride, int height)		\
+{									\
+    MC_8_sse2 (height, dest, ref, stride, dx, dy, avg);			\
+}
+
+MC_FUNC (put, 0, o, 0, 0)
+MC_FUNC (put, 0, x, 1, 0)
+MC_FUNC (put, 0, y, 0, 1)
+MC_FUNC (put, 0, xy, 1, 1)
+MC_FUNC (avg, 1, o, 0, 0)
+MC_FUNC (avg, 1, x, 1, 0)
+MC_FUNC (avg, 1, y, 0, 1)
+MC_FUNC (avg, 1, xy, 1, 1)
+
+MPEG2_MC_EXTERN (sse2)
+
+#endif
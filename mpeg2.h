@@ -158,6 +158,8 @@ void mpeg2_custom_fbuf (mpeg2dec_t * mpeg2dec, int custom_fbuf);
 #define MPEG2_ACCEL_X86_MMXEXT 4
 #define MPEG2_ACCEL_X86_SSE2 8
 #define MPEG2_ACCEL_X86_SSE3 16
+#define MPEG2_ACCEL_X86_AVX2 32
+#define MPEG2_ACCEL_X86_AVX512 64
 #define MPEG2_ACCEL_PPC_ALTIVEC 1
 #define MPEG2_ACCEL_ALPHA 1
 #define MPEG2_ACCEL_ALPHA_MVI 2
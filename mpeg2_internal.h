@@ -67,6 +67,9 @@ typedef void motion_parser_t (mpeg2_decoder_t * decoder,
 			      motion_t * motion,
 			      mpeg2_mc_fct * const * table);
 
+typedef void slice_decoder_t (mpeg2_decoder_t * decoder, int code,
+			      const uint8_t * buffer);
+
 struct mpeg2_decoder_s {
     /* first, state that carries information from one macroblock to the */
     /* next inside a slice, and is never used outside of mpeg2_slice() */
@@ -97,11 +100,14 @@ struct mpeg2_decoder_s {
     motion_t f_motion;
     motion_parser_t * motion_parser[5];
 
+    /* Slice::decode () specialized for this picture (see slice_setup) */
+    slice_decoder_t * slice_decoder;
+
     /* predictor for DC coefficients in intra blocks */
     int16_t dc_dct_pred[3];
 
-    /* DCT coefficients */
-  int16_t DCTblock[64] ATTR_ALIGN(64);
+    /* DCT coefficients; the second block is used by the pair IDCTs */
+  int16_t DCTblock[128] ATTR_ALIGN(64);
   //int16_t DCTblock[64] __attribute__ ((aligned (64)));
 
     uint8_t * picture_dest[3];
@@ -127,7 +133,7 @@ struct mpeg2_decoder_s {
 
     /* picture header stuff */
 
-    /* what type of picture this is (I, P, B, D) */
+    /* what type of picture this is (I, P, B) */
     int coding_type;
 
     /* picture coding extension stuff */
@@ -153,13 +159,29 @@ struct mpeg2_decoder_s {
 
     int second_field;
 
-    int mpeg1;
-
     /* XXX: stuff due to xine shit */
     int8_t q_scale_type;
 
-    /* Ahab field */
+    /* Ahab fields */
     bool invalid;
+
+    /* write only the DC term of each intra block, one pixel per block,
+       into 1/8-scale planes at picture_dest (see slice_dc_only) */
+    bool dc_only;
+
+    /* reconstruct at 1/2 (1) or 1/4 (2) size; strides and destinations
+       are in reduced pixels, offset and motion stay full size */
+    int lowres;
+
+    /* kernels for this CPU, copied from mpeg2_kernels () */
+    void (* idct_copy) (int16_t * block, uint8_t * dest, int stride);
+    void (* idct_add) (int last, int16_t * block, uint8_t * dest, int stride);
+    void (* idct_copy2) (int16_t * block, uint8_t * dest, int stride);
+    void (* idct_add2) (int last0, int last1, int16_t * block,
+			uint8_t * dest, int stride);
+    mpeg2_mc_fct * const * mc_put;
+    mpeg2_mc_fct * const * mc_avg;
+    bool emms;
 };
 
 typedef struct {
@@ -275,14 +297,37 @@ extern const uint8_t mpeg2_scan_alt[64];
 void mpeg2_idct_copy_sse2 (int16_t * block, uint8_t * dest, int stride);
 void mpeg2_idct_add_sse2 (int last, int16_t * block,
 			  uint8_t * dest, int stride);
+void mpeg2_idct_copy2_sse2 (int16_t * block, uint8_t * dest, int stride);
+void mpeg2_idct_add2_sse2 (int last0, int last1, int16_t * block,
+			   uint8_t * dest, int stride);
 void mpeg2_idct_copy_mmxext (int16_t * block, uint8_t * dest, int stride);
 void mpeg2_idct_add_mmxext (int last, int16_t * block,
 			    uint8_t * dest, int stride);
+void mpeg2_idct_copy2_mmxext (int16_t * block, uint8_t * dest, int stride);
+void mpeg2_idct_add2_mmxext (int last0, int last1, int16_t * block,
+			     uint8_t * dest, int stride);
 void mpeg2_idct_copy_mmx (int16_t * block, uint8_t * dest, int stride);
 void mpeg2_idct_add_mmx (int last, int16_t * block,
 			 uint8_t * dest, int stride);
+void mpeg2_idct_copy2_mmx (int16_t * block, uint8_t * dest, int stride);
+void mpeg2_idct_add2_mmx (int last0, int last1, int16_t * block,
+			  uint8_t * dest, int stride);
 void mpeg2_idct_mmx_init (void);
 
+/* idct_avx2.cpp */
+void mpeg2_idct_copy_avx2 (int16_t * block, uint8_t * dest, int stride);
+void mpeg2_idct_add_avx2 (int last, int16_t * block,
+			  uint8_t * dest, int stride);
+void mpeg2_idct_copy2_avx2 (int16_t * block, uint8_t * dest, int stride);
+void mpeg2_idct_add2_avx2 (int last0, int last1, int16_t * block,
+			   uint8_t * dest, int stride);
+
+/* idct_lowres.cpp */
+void mpeg2_idct_copy_lowres (int16_t * block, uint8_t * dest, int stride,
+			     int lowres);
+void mpeg2_idct_add_lowres (int16_t * block, uint8_t * dest, int stride,
+			    int lowres);
+
 /* idct_altivec.c */
 void mpeg2_idct_copy_altivec (int16_t * block, uint8_t * dest, int stride);
 void mpeg2_idct_add_altivec (int last, int16_t * block,
@@ -313,13 +358,55 @@ typedef struct {
      MC_avg_o_8_##x,  MC_avg_x_8_##x,  MC_avg_y_8_##x,  MC_avg_xy_8_##x}  \
 };
 
+/* motion_comp_lowres.cpp */
+void mpeg2_mc_lowres (uint8_t * dest, const uint8_t * ref, int stride,
+		      int width, int height, int fx, int fy, int lowres,
+		      int avg);
+
 extern mpeg2_mc_t mpeg2_mc_c;
 extern mpeg2_mc_t mpeg2_mc_mmx;
 extern mpeg2_mc_t mpeg2_mc_mmxext;
+extern mpeg2_mc_t mpeg2_mc_sse2;
+extern mpeg2_mc_t mpeg2_mc_avx2;
 extern mpeg2_mc_t mpeg2_mc_3dnow;
 extern mpeg2_mc_t mpeg2_mc_altivec;
 extern mpeg2_mc_t mpeg2_mc_alpha;
 extern mpeg2_mc_t mpeg2_mc_vis;
 extern mpeg2_mc_t mpeg2_mc_arm;
 
+/* cpu_accel.cpp: one IDCT and motion compensation kernel set */
+typedef struct {
+    const char * name;
+    uint32_t accel;		/* MPEG2_ACCEL_* flag the set needs */
+    void (* idct_copy) (int16_t * block, uint8_t * dest, int stride);
+    void (* idct_add) (int last, int16_t * block, uint8_t * dest, int stride);
+    void (* idct_copy2) (int16_t * block, uint8_t * dest, int stride);
+    void (* idct_add2) (int last0, int last1, int16_t * block,
+			uint8_t * dest, int stride);
+    const mpeg2_mc_t * mc;
+    bool emms;			/* uses MMX registers */
+} mpeg2_kernels_t;
+
+const mpeg2_kernels_t * mpeg2_kernels (void);
+const mpeg2_kernels_t * mpeg2_kernel_sets (int * count);
+void mpeg2_use_kernels (const mpeg2_kernels_t * kernels);
+
+/* slicedecode.cpp, only when built with MPEG2_CAPTURE for kernelbench:
+   hooks called at the start of each slice and before each block is
+   parsed, and out-of-line copies of the block parsers */
+#define MPEG2_BLOCK_INTRA_B14 0
+#define MPEG2_BLOCK_INTRA_B15 1
+#define MPEG2_BLOCK_NON_INTRA 2
+
+void mpeg2_capture_slice (mpeg2_decoder_t * decoder);
+void mpeg2_capture_block (const mpeg2_decoder_t * decoder, int parser,
+			  const int16_t * block,
+			  const uint16_t * quant_matrix);
+void mpeg2_get_intra_block_B14 (mpeg2_decoder_t * decoder, int16_t * dest,
+				const uint16_t * quant_matrix);
+void mpeg2_get_intra_block_B15 (mpeg2_decoder_t * decoder, int16_t * dest,
+				const uint16_t * quant_matrix);
+int mpeg2_get_non_intra_block (mpeg2_decoder_t * decoder, int16_t * dest,
+			       const uint16_t * quant_matrix);
+
 #endif /* LIBMPEG2_MPEG2_INTERNAL_H */
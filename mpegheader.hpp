@@ -67,9 +67,11 @@ public:
 
 class Sequence : public MPEGHeader
 {
+public:
+  enum AspectRatio { SAR1x1, DAR4x3, DAR16x9, DAR221x100 };
+
 private:
   uint horizontal_size_value, vertical_size_value;
-  enum AspectRatio { SAR1x1, DAR4x3, DAR16x9, DAR221x100 };
   AspectRatio aspect;
   uint8_t frame_rate_code;
 
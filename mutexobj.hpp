@@ -18,4 +18,19 @@ public:
   }
 };
 
+/* Lets go of a mutex the caller holds for the length of a block */
+class MutexUnlock {
+private:
+  pthread_mutex_t *mutex;
+
+public:
+  MutexUnlock( pthread_mutex_t *s_mutex ) {
+    mutex = s_mutex;
+    unixassert( pthread_mutex_unlock( mutex ) );
+  }
+  ~MutexUnlock() {
+    unixassert( pthread_mutex_lock( mutex ) );
+  }
+};
+
 #endif
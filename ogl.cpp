@@ -11,15 +11,19 @@
 #include <math.h>
 #include <pthread.h>
 #include <unistd.h>
-#include <sys/time.h>
+#include <time.h>
+#include <errno.h>
+#include <EGL/eglext.h>
 
 #include "ahab_fragment_program.hpp"
 #include "exceptions.hpp"
 #include "colorimetry.hpp"
+#include "mutexobj.hpp"
 
 #include "displayopq.hpp"
 
 const int opqueue_len = 8;
+const uint telemetry_frames = 4096; /* a minute or so */
 
 static void *thread_helper( void *ogl )
 {
@@ -32,13 +36,19 @@ static void *thread_helper( void *ogl )
 OpenGLDisplay::OpenGLDisplay( char *display_name,
 			      double movie_sar,
 			      uint s_framewidth, uint s_frameheight,
-			      uint s_dispwidth, uint s_dispheight )
-  : opq( opqueue_len )
+			      uint s_dispwidth, uint s_dispheight,
+			      uint s_lowres, BufferPool *s_frame_pool )
+  : opq( opqueue_len ), timings( telemetry_frames ),
+    frame_pool( s_frame_pool ), ready( false )
 {
+  state.output = OUTPUT_WINDOW;
   state.framewidth = s_framewidth;
   state.frameheight = s_frameheight;
   state.dispwidth = s_dispwidth;
   state.dispheight = s_dispheight;
+  state.lowres = s_lowres;
+  state.texwidth = s_framewidth >> s_lowres;
+  state.texheight = s_frameheight >> s_lowres;
   
   if ( 0 == XInitThreads() ) {
     fprintf( stderr, "XInitThreads() failed." );
@@ -89,11 +99,13 @@ OpenGLDisplay::OpenGLDisplay( char *display_name,
 
   ahabassert( state.GetSync );
 
-  state.last_mbc = -1;
-  state.last_us = -1;
+  /* From the same extension, but optional: without them frames are
+     swapped as they come */
+  state.SwapBuffersMsc = (int64_t (*)(Display*, GLXDrawable, int64_t, int64_t, int64_t))glXGetProcAddress( (GLubyte *) "glXSwapBuffersMscOML" );
+  state.WaitForSbc = (Bool (*)(Display*, GLXDrawable, int64_t, int64_t*, int64_t*, int64_t*))glXGetProcAddress( (GLubyte *) "glXWaitForSbcOML" );
+  state.retrace_us = 0;
 
-  unixassert( pthread_create( &thread_handle, NULL,
-			      thread_helper, this ) );
+  start();
 
   int prio = sched_get_priority_max( SCHED_FIFO );
   ahabassert( prio != -1 );
@@ -105,6 +117,80 @@ OpenGLDisplay::OpenGLDisplay( char *display_name,
 				     SCHED_FIFO, &params ) );
 }
 
+/* Without X: nothing to size for, so frames are painted (if at all)
+   at their display size, and the thread keeps the default policy */
+OpenGLDisplay::OpenGLDisplay( DisplayOutput s_output, double refresh_hz,
+			      uint s_framewidth, uint s_frameheight,
+			      uint s_dispwidth, uint s_dispheight,
+			      uint s_lowres, BufferPool *s_frame_pool )
+  : opq( opqueue_len ), timings( telemetry_frames ),
+    frame_pool( s_frame_pool ), ready( false )
+{
+  ahabassert( s_output != OUTPUT_WINDOW );
+  ahabassert( refresh_hz > 0 );
+
+  state.output = s_output;
+  state.framewidth = s_framewidth;
+  state.frameheight = s_frameheight;
+  state.dispwidth = s_dispwidth;
+  state.dispheight = s_dispheight;
+  state.lowres = s_lowres;
+  state.texwidth = s_framewidth >> s_lowres;
+  state.texheight = s_frameheight >> s_lowres;
+
+  state.display = NULL;
+  state.sar = 1;
+  state.width = state.dispwidth;
+  state.height = state.dispheight;
+  state.GetSync = NULL;
+  state.SwapBuffersMsc = NULL;
+  state.WaitForSbc = NULL;
+  state.refresh_us = lrint( 1000000.0 / refresh_hz );
+  state.retrace_us = state.refresh_us;
+
+  fprintf( stderr, "Headless display (%s), %dx%d at a simulated %.2f Hz.\n",
+	   s_output == OUTPUT_OFFSCREEN ? "offscreen" : "checksum",
+	   state.width, state.height, refresh_hz );
+
+  start();
+}
+
+void OpenGLDisplay::start( void )
+{
+  state.last_mbc = -1;
+  state.last_ust = -1;
+  state.last_us = -1;
+  state.anchor_msc = 0;
+  state.anchor_due_us = 0;
+  state.held_us = 0;
+
+  state.use_pbo = false;
+  state.next_pbo = 0;
+  state.frames_mapped = 0;
+  state.pool = NULL;
+  state.fenced = NULL;
+  state.frames_drawn = 0;
+  state.upload_us = state.paint_us = 0;
+  state.frames_timed = 0;
+  state.first_swap_us = state.latency_us = state.max_latency_us = 0;
+  state.retrace_origin_us = 0;
+  state.checksum = 0xcbf29ce484222325ULL;
+  state.timings = &timings;
+
+  unixassert( pthread_mutex_init( &ready_mutex, NULL ) );
+  unixassert( pthread_cond_init( &ready_cond, NULL ) );
+
+  unixassert( pthread_create( &thread_handle, NULL,
+			      thread_helper, this ) );
+
+  /* The frames have to be in their GL buffers before anything is
+     decoded into them */
+  MutexLock x( &ready_mutex );
+  while ( !ready ) {
+    unixassert( pthread_cond_wait( &ready_cond, &ready_mutex ) );
+  }
+}
+
 void OpenGLDisplay::init_context( void ) {
   int attributes[] = { GLX_RGBA,
 		       GLX_DOUBLEBUFFER, True,
@@ -134,13 +220,84 @@ void OpenGLDisplay::init_context( void ) {
 
   GLcheck( "glXMakeCurrent" );
 
+  init_rendering();
+}
+
+/* An OpenGL context with no surface at all (EGL_MESA_platform_surfaceless,
+   or the default display where that is missing), painting into a
+   framebuffer object of the window's size */
+void OpenGLDisplay::init_offscreen( void )
+{
+  PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display
+    = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress( "eglGetPlatformDisplayEXT" );
+
+  egl_display = EGL_NO_DISPLAY;
+  if ( get_platform_display ) {
+    egl_display = get_platform_display( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL );
+  }
+  if ( egl_display == EGL_NO_DISPLAY ) {
+    egl_display = eglGetDisplay( EGL_DEFAULT_DISPLAY );
+  }
+
+  EGLint major, minor;
+  if ( (egl_display == EGL_NO_DISPLAY) || !eglInitialize( egl_display, &major, &minor ) ) {
+    fprintf( stderr, "Could not initialize EGL.\n" );
+    throw DisplayError();
+  }
+
+  if ( !eglBindAPI( EGL_OPENGL_API ) ) {
+    fprintf( stderr, "EGL has no desktop OpenGL.\n" );
+    throw DisplayError();
+  }
+
+  /* needs EGL_KHR_no_config_context and EGL_KHR_surfaceless_context */
+  egl_context = eglCreateContext( egl_display, (EGLConfig)0, EGL_NO_CONTEXT, NULL );
+  if ( (egl_context == EGL_NO_CONTEXT)
+       || !eglMakeCurrent( egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, egl_context ) ) {
+    fprintf( stderr, "No surfaceless EGL context.\n" );
+    throw DisplayError();
+  }
+
+  fprintf( stderr, "Offscreen OpenGL: %s.\n", glGetString( GL_RENDERER ) );
+
+  glGenRenderbuffers( 1, &renderbuffer );
+  glBindRenderbuffer( GL_RENDERBUFFER, renderbuffer );
+  glRenderbufferStorage( GL_RENDERBUFFER, GL_RGBA8, state.width, state.height );
+  glGenFramebuffers( 1, &framebuffer );
+  glBindFramebuffer( GL_FRAMEBUFFER, framebuffer );
+  glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			     GL_RENDERBUFFER, renderbuffer );
+  if ( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE ) {
+    fprintf( stderr, "Offscreen framebuffer incomplete.\n" );
+    throw DisplayError();
+  }
+  glDrawBuffer( GL_COLOR_ATTACHMENT0 );
+
+  GLcheck( "init_offscreen" );
+
+  init_rendering();
+}
+
+/* Textures, buffers and shader, once a context is current */
+void OpenGLDisplay::init_rendering( void )
+{
   /* initialize textures */
   init_tex( GL_TEXTURE0, GL_LUMINANCE8, &state.Y_tex,
-	    state.framewidth, state.frameheight, GL_LINEAR );
+	    state.texwidth, state.texheight, GL_LINEAR );
   init_tex( GL_TEXTURE1, GL_LUMINANCE8, &state.Cb_tex,
-	    state.framewidth/2, state.frameheight/2, GL_LINEAR );
+	    state.texwidth/2, state.texheight/2, GL_LINEAR );
   init_tex( GL_TEXTURE2, GL_LUMINANCE8, &state.Cr_tex,
-	    state.framewidth/2, state.frameheight/2, GL_LINEAR );
+	    state.texwidth/2, state.texheight/2, GL_LINEAR );
+
+  /* pixel buffer objects, where the driver has them (GL 2.1) */
+  const char *extensions = (const char *)glGetString( GL_EXTENSIONS );
+  if ( extensions && strstr( extensions, "GL_ARB_pixel_buffer_object" ) ) {
+    glGenBuffers( num_pbos, state.pbo );
+    state.use_pbo = true;
+  } else {
+    fprintf( stderr, "No pixel buffer objects, uploading frames directly.\n" );
+  }
+  GLcheck( "glGenBuffers" );
 
   /* load the shader */
   GLint errorloc;  
@@ -170,10 +327,14 @@ void OpenGLDisplay::init_context( void ) {
 
 void OpcodeState::reset_viewport( void )
 {
-  glXSwapBuffers( display, window );
+  if ( output == OUTPUT_WINDOW ) {
+    glXSwapBuffers( display, window );
+  }
   glFinish();
   OpenGLDisplay::GLcheck( "reset_viewport: glFinish" );
-  XSync( display, False );
+  if ( output == OUTPUT_WINDOW ) {
+    XSync( display, False );
+  }
   glLoadIdentity();
   glViewport( 0, 0, width, height );
   glMatrixMode( GL_PROJECTION );
@@ -199,7 +360,10 @@ void OpcodeState::window_setup( void )
 
 OpenGLDisplay::~OpenGLDisplay()
 {
-  opq.flush();
+  /* Without a window, what was sent is still drawn and counted */
+  if ( state.output == OUTPUT_WINDOW ) {
+    opq.flush();
+  }
 
   DisplayOperation *shutdown = new ShutDown();
   opq.enqueue( shutdown );
@@ -208,13 +372,44 @@ OpenGLDisplay::~OpenGLDisplay()
 
   delete shutdown; /* Doesn't get deleted by loop because opcode execute() exits first. */
 
-  glDeleteProgramsARB( 1, &shader );
-  glDeleteTextures( 1, &state.Y_tex );
-  glDeleteTextures( 1, &state.Cb_tex );
-  glDeleteTextures( 1, &state.Cr_tex );
-  glXDestroyContext( state.display, state.context );
-  XDestroyWindow( state.display, state.window );
-  XCloseDisplay( state.display );
+  state.report_times();
+
+  /* AHAB_TELEMETRY names a file for the frame timing summary, or is
+     "-" for stderr */
+  const char *telemetry = getenv( "AHAB_TELEMETRY" );
+  if ( telemetry ) {
+    FILE *f = strcmp( telemetry, "-" ) ? fopen( telemetry, "w" ) : stderr;
+    if ( f ) {
+      timings.write_json( f );
+      if ( f != stderr ) {
+	fclose( f );
+      }
+    } else {
+      perror( telemetry );
+    }
+  }
+
+  if ( state.output == OUTPUT_WINDOW ) {
+    if ( state.use_pbo ) {
+      glDeleteBuffers( num_pbos, state.pbo );
+    }
+
+    glDeleteProgramsARB( 1, &shader );
+    glDeleteTextures( 1, &state.Y_tex );
+    glDeleteTextures( 1, &state.Cb_tex );
+    glDeleteTextures( 1, &state.Cr_tex );
+    /* Takes the mapped frames' buffers with it */
+    glXDestroyContext( state.display, state.context );
+    XDestroyWindow( state.display, state.window );
+    XCloseDisplay( state.display );
+  } else if ( state.output == OUTPUT_OFFSCREEN ) {
+    /* Likewise, along with everything else in the context */
+    eglDestroyContext( egl_display, egl_context );
+    eglTerminate( egl_display );
+  }
+
+  unixassert( pthread_cond_destroy( &ready_cond ) );
+  unixassert( pthread_mutex_destroy( &ready_mutex ) );
 }
 
 void OpenGLDisplay::init_tex( GLenum tnum, GLint internalformat, GLuint *tex,
@@ -235,76 +430,158 @@ void OpenGLDisplay::init_tex( GLenum tnum, GLint internalformat, GLuint *tex,
   GLcheck( "init_tex" );
 }
 
-void OpcodeState::paint( void )
+/* The retrace on which a frame due at due_us should first be shown,
+   or 0 for the next one: the first at or after its due time, counted
+   in retraces from an anchor frame by stream time (which already
+   counts repeated fields). So the cadence follows the content rather
+   than when each frame arrived: 24p on a 60 Hz display goes 3, 2, 3, 2.
+   The anchor is where its frame fell between retraces, and moves when
+   that strays more than a retrace from the wall clock, as after a
+   seek or a pause. Also notes in held_us how long the swap will be
+   held back past the retrace it could otherwise have made. */
+int64_t OpcodeState::target_msc( int64_t due_us )
 {
+  held_us = 0;
+
+  if ( (!due_us) || (last_mbc == -1) || (retrace_us <= 0) ) {
+    anchor_due_us = 0;
+    return 0;
+  }
+
+  double wall = last_mbc + (due_us - last_us) / retrace_us;
+  double paced = anchor_msc + (due_us - anchor_due_us) / retrace_us;
+
+  if ( (!anchor_due_us) || (fabs( paced - wall ) > 1) ) {
+    anchor_msc = paced = wall;
+    anchor_due_us = due_us;
+  }
+
+  int64_t target = (int64_t)ceil( paced );
+
+  int64_t next = last_mbc + 1 + (int64_t)floor( (PresentationClock::now() - last_us) / retrace_us );
+  if ( target > next ) {
+    held_us = (target - next) * retrace_us;
+  }
+
+  /* Late: as soon as possible, and never two frames on one retrace */
+  return target > last_mbc ? target : last_mbc + 1;
+}
+
+void OpcodeState::paint( int64_t due_us )
+{
+  if ( output == OUTPUT_CHECKSUM ) {
+    wait_retrace( target_msc( due_us ) );
+    return;
+  }
+
   glPushMatrix();
   glLoadIdentity();
   glTranslatef( 0, 0, 0 );
   glBegin( GL_POLYGON );
 
   const double ff = 1.0/128; /* Mesa fudge factor */
-  const double xoffset = 0.25; /* MPEG-2 style 4:2:0 subsampling */
+
+  /* Texture coordinates are in texels of the (possibly reduced) frame */
+  const double tw = (double)dispwidth / (1 << lowres);
+  const double th = (double)dispheight / (1 << lowres);
+  const double xoffset = 0.25 / (1 << lowres); /* MPEG-2 style 4:2:0 subsampling */
 
   glMultiTexCoord2d( GL_TEXTURE0, ff, ff );
   glMultiTexCoord2d( GL_TEXTURE1, xoffset+ff, ff );
   glMultiTexCoord2d( GL_TEXTURE2, xoffset+ff, ff );
   glVertex2s( 0, 0 );
 
-  glMultiTexCoord2d( GL_TEXTURE0, dispwidth+ff, ff );
-  glMultiTexCoord2d( GL_TEXTURE1, dispwidth/2 + xoffset + ff, ff );
-  glMultiTexCoord2d( GL_TEXTURE2, dispwidth/2 + xoffset + ff, ff );
+  glMultiTexCoord2d( GL_TEXTURE0, tw+ff, ff );
+  glMultiTexCoord2d( GL_TEXTURE1, tw/2 + xoffset + ff, ff );
+  glMultiTexCoord2d( GL_TEXTURE2, tw/2 + xoffset + ff, ff );
   glVertex2s( width, 0 );
 
-  glMultiTexCoord2d( GL_TEXTURE0, dispwidth+ff, dispheight+ff );
-  glMultiTexCoord2d( GL_TEXTURE1, dispwidth/2 + xoffset + ff, dispheight/2 + ff);
-  glMultiTexCoord2d( GL_TEXTURE2, dispwidth/2 + xoffset + ff, dispheight/2 + ff);
+  glMultiTexCoord2d( GL_TEXTURE0, tw+ff, th+ff );
+  glMultiTexCoord2d( GL_TEXTURE1, tw/2 + xoffset + ff, th/2 + ff);
+  glMultiTexCoord2d( GL_TEXTURE2, tw/2 + xoffset + ff, th/2 + ff);
   glVertex2s( width, height);
 
-  glMultiTexCoord2d( GL_TEXTURE0, ff, dispheight+ff );
-  glMultiTexCoord2d( GL_TEXTURE1, xoffset+ff, dispheight/2 + ff );
-  glMultiTexCoord2d( GL_TEXTURE2, xoffset+ff, dispheight/2 + ff );
+  glMultiTexCoord2d( GL_TEXTURE0, ff, th+ff );
+  glMultiTexCoord2d( GL_TEXTURE1, xoffset+ff, th/2 + ff );
+  glMultiTexCoord2d( GL_TEXTURE2, xoffset+ff, th/2 + ff );
   glVertex2s( 0, height);
 
   glEnd();
 
   glPopMatrix();
 
-  glXSwapBuffers( display, window );
+  if ( output == OUTPUT_OFFSCREEN ) {
+    glFinish();
+    OpenGLDisplay::GLcheck( "offscreen paint" );
+    retire_fence();
+    wait_retrace( target_msc( due_us ) );
+    return;
+  }
 
-  OpenGLDisplay::GLcheck( "glXSwapBuffers" );
+  /* Skipped retraces and uneven intervals show up in the frame
+     timings that DrawAndUnlockFrame records from these */
 
-  glFinish();
+  int64_t ust, mbc, sbc, us;
 
-  /* Check if we stuttered */  
+  /* Queue the swap for its retrace and sleep until it happens, rather
+     than swapping now and spinning in glFinish() */
+  int64_t swap = -1;
+  if ( SwapBuffersMsc && WaitForSbc ) {
+    swap = SwapBuffersMsc( display, window, target_msc( due_us ), 0, 0 );
+    OpenGLDisplay::GLcheck( "glXSwapBuffersMscOML" );
+  }
 
-  int64_t ust, mbc, sbc, us;
-  struct timeval now;
+  if ( swap < 0 ) {
+    glXSwapBuffers( display, window );
+    OpenGLDisplay::GLcheck( "glXSwapBuffers" );
+  }
 
-  gettimeofday( &now, NULL );
-  us = 1000000 * now.tv_sec + now.tv_usec;
-  long us_diff = us - last_us;
+  retire_fence();
 
-  GetSync( display, window, &ust, &mbc, &sbc );
+  if ( (swap < 0) || !WaitForSbc( display, window, swap, &ust, &mbc, &sbc ) ) {
+    glFinish();
+    GetSync( display, window, &ust, &mbc, &sbc );
+  }
 
-  bool msg = false;
+  us = PresentationClock::now();
 
-  if ( (last_mbc != -1) && (mbc != last_mbc + 1) ) {
-    long int diff = mbc - last_mbc;
-    fprintf( stderr, "[Skipped %ld retraces.]", diff );
-    msg = true;
+  if ( (last_mbc != -1) && (mbc > last_mbc) ) {
+    int64_t retrace = (ust - last_ust) / (mbc - last_mbc);
+    clock.report_retrace( retrace );
+    retrace_us = retrace_us > 0 ? retrace_us + (retrace - retrace_us) / 16 : retrace;
   }
 
-  if ( (last_us != -1) && ( (us_diff < 8000) || (us_diff > 24000) ) ) {
-    fprintf( stderr, "%s[Time diff was %ld us.]", msg ? " " : "", (long)us_diff );
-    msg = true;
+  last_mbc = mbc;
+  last_ust = ust;
+  last_us = us;
+}
+
+/* Without a window, stands in for a swap with vsync: returns at the
+   next retrace of a simulated display, or at the target one if that
+   is later, so at most one frame is presented per retrace */
+void OpcodeState::wait_retrace( int64_t target )
+{
+  int64_t us = PresentationClock::now();
+
+  if ( last_mbc == -1 ) {
+    retrace_origin_us = us;
+    clock.report_retrace( refresh_us );
   }
 
-  if ( msg ) {
-    fprintf( stderr, "\n" );
+  int64_t mbc = (us - retrace_origin_us) / refresh_us + 1;
+  if ( target > mbc ) {
+    mbc = target;
   }
+  int64_t ust = retrace_origin_us + mbc * refresh_us;
+
+  struct timespec ts;
+  ts.tv_sec = ust / 1000000;
+  ts.tv_nsec = (ust % 1000000) * 1000;
+  while ( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL ) == EINTR ) {}
 
   last_mbc = mbc;
-  last_us = us;
+  last_ust = ust;
+  last_us = ust;
 }
 
 typedef struct
@@ -419,6 +696,10 @@ void OpcodeState::load_matrix_coefficients( double green[ 3 ],
 					    double blue[ 3 ],
 					    double red[ 3 ] )
 {
+  if ( output == OUTPUT_CHECKSUM ) {
+    return;
+  }
+
   glProgramLocalParameter4dARB( GL_FRAGMENT_PROGRAM_ARB, 0,
 				green[ 0 ], green[ 1 ], green[ 2 ], 0 );
   glProgramLocalParameter4dARB( GL_FRAGMENT_PROGRAM_ARB, 1,
@@ -429,35 +710,239 @@ void OpcodeState::load_matrix_coefficients( double green[ 3 ],
 }
 
 void OpcodeState::load_tex( GLenum tnum, GLuint tex,
-			     uint width, uint height, uint8_t *data )
+			     uint width, uint height, uint stride, const GLvoid *data )
 {
   glActiveTexture( tnum );
   OpenGLDisplay::GLcheck( "glActiveTexture" );
   glBindTexture( GL_TEXTURE_RECTANGLE_ARB, tex );
   OpenGLDisplay::GLcheck( "glBindTexture" );
+  glPixelStorei( GL_UNPACK_ROW_LENGTH, stride );
+  OpenGLDisplay::GLcheck( "glPixelStorei" );
   glTexSubImage2D( GL_TEXTURE_RECTANGLE_ARB, 0, 0, 0, width, height,
 		   GL_LUMINANCE, GL_UNSIGNED_BYTE, data );
   OpenGLDisplay::GLcheck( "glTexSubImage2D" );
 }
 
-void OpcodeState::draw( uint8_t *ycbcr )
+/* Frame rows are padded to stride bytes (stride / 2 for chroma). Once
+   this returns the frame has been copied and may be unlocked.
+
+   With pixel buffer objects, the planes are copied into the next
+   buffer in turn, after orphaning its old storage so that we never
+   wait for the GPU to finish reading it; the texture updates then
+   come from the buffer without blocking. Otherwise glTexSubImage2D
+   copies from the frame itself before returning. */
+void OpcodeState::upload( uint8_t *y, uint8_t *cb, uint8_t *cr, uint stride )
 {
-  load_tex( GL_TEXTURE0, Y_tex, framewidth, frameheight, ycbcr );
-  load_tex( GL_TEXTURE1, Cb_tex, framewidth/2, frameheight/2,
-	    ycbcr + framewidth * frameheight );
-  load_tex( GL_TEXTURE2, Cr_tex, framewidth/2, frameheight/2,
-	    ycbcr + framewidth * frameheight + framewidth * frameheight / 4);
-  
-  paint();
+  size_t y_len = stride * texheight;
+  size_t c_len = (stride / 2) * (texheight / 2);
+
+  if ( use_pbo ) {
+    glBindBuffer( GL_PIXEL_UNPACK_BUFFER, pbo[ next_pbo ] );
+    next_pbo = (next_pbo + 1) % num_pbos;
+    glBufferData( GL_PIXEL_UNPACK_BUFFER, y_len + 2 * c_len, NULL, GL_STREAM_DRAW );
+    uint8_t *mapped = (uint8_t *)glMapBuffer( GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY );
+    OpenGLDisplay::GLcheck( "glMapBuffer" );
+
+    if ( mapped ) {
+      memcpy( mapped, y, y_len );
+      memcpy( mapped + y_len, cb, c_len );
+      memcpy( mapped + y_len + c_len, cr, c_len );
+      glUnmapBuffer( GL_PIXEL_UNPACK_BUFFER );
+
+      /* offsets into the bound buffer */
+      load_planes( (GLvoid *)0, (GLvoid *)y_len, (GLvoid *)(y_len + c_len), stride );
+      glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+      return;
+    }
+
+    glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+  }
+
+  load_planes( y, cb, cr, stride );
+}
+
+/* For a frame from map_frames(), which already lives in GL buffer
+   memory: the textures load from it with no copy on our side. The
+   frame must not be written again until the GPU has read it, so it
+   is left carrying a fence, and may be unlocked at once as in
+   upload(); the pool doesn't hand it out again until retire_fence()
+   has seen the fence pass. */
+void OpcodeState::upload_mapped( Frame *frame )
+{
+  uint stride = frame->get_stride();
+  size_t y_len = stride * texheight;
+  size_t c_len = (stride / 2) * (texheight / 2);
+
+  glBindBuffer( GL_PIXEL_UNPACK_BUFFER, frame->get_gl_buffer() );
+  load_planes( (GLvoid *)0, (GLvoid *)y_len, (GLvoid *)(y_len + c_len), stride );
+  glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+
+  ahabassert( !fenced );
+  frame->set_fence( glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 ) );
+  glFlush();
+  OpenGLDisplay::GLcheck( "glFenceSync" );
+  fenced = frame;
+}
+
+/* Only a thread with the context can wait on the fence, so it is ours
+   to do rather than the decoder's. paint() calls this once the swap
+   is queued, when the display thread would only be sleeping until
+   the retrace anyway; the texture load was submitted before the draw,
+   so it has usually passed by then. */
+void OpcodeState::retire_fence( void )
+{
+  if ( !fenced ) {
+    return;
+  }
+
+  GLsync fence = (GLsync)fenced->get_fence();
+  GLenum result = glClientWaitSync( fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000 );
+  OpenGLDisplay::GLcheck( "glClientWaitSync" );
+
+  if ( (result != GL_ALREADY_SIGNALED) && (result != GL_CONDITION_SATISFIED) ) {
+    glFinish();
+  }
+
+  glDeleteSync( fence );
+  pool->fence_passed( fenced );
+  fenced = NULL;
+}
+
+void OpcodeState::load_planes( const GLvoid *y, const GLvoid *cb, const GLvoid *cr, uint stride )
+{
+  load_tex( GL_TEXTURE0, Y_tex, texwidth, texheight, stride, y );
+  load_tex( GL_TEXTURE1, Cb_tex, texwidth/2, texheight/2, stride/2, cb );
+  load_tex( GL_TEXTURE2, Cr_tex, texwidth/2, texheight/2, stride/2, cr );
+}
+
+/* Replaces the pool's frame memory with persistently mapped pixel
+   buffers (ARB_buffer_storage), so pictures are decoded where the
+   textures load from and upload() has nothing to copy. The mappings
+   are coherent, so decoder writes need no flush before a fence. The
+   decoder also reads reference frames back out of them, so the
+   buffers ask for client memory, which stays cached on drivers that
+   take the hint. Returns the number of frames mapped; any others keep
+   their own memory and go through upload(). */
+uint OpcodeState::map_frames( BufferPool *pool )
+{
+  const char *extensions = (const char *)glGetString( GL_EXTENSIONS );
+  if ( !extensions || !strstr( extensions, "GL_ARB_buffer_storage" ) ) {
+    fprintf( stderr, "No ARB_buffer_storage, decoding into ordinary frames.\n" );
+    return 0;
+  }
+
+  const GLbitfield access = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT
+    | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  size_t len = pool->get_frame_len();
+  uint mapped;
+
+  for ( mapped = 0; mapped < pool->get_num_frames(); mapped++ ) {
+    GLuint buffer;
+    glGenBuffers( 1, &buffer );
+    glBindBuffer( GL_PIXEL_UNPACK_BUFFER, buffer );
+    glBufferStorage( GL_PIXEL_UNPACK_BUFFER, len, NULL, access | GL_CLIENT_STORAGE_BIT );
+    uint8_t *buf = (uint8_t *)glMapBufferRange( GL_PIXEL_UNPACK_BUFFER, 0, len, access );
+    glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+    OpenGLDisplay::GLcheck( "glMapBufferRange" );
+
+    if ( !buf ) {
+      glDeleteBuffers( 1, &buffer );
+      break;
+    }
+
+    pool->get_frame( mapped )->use_buffer( buf, buffer );
+  }
+
+  if ( mapped < pool->get_num_frames() ) {
+    fprintf( stderr, "Mapped %u of %u frames into GL buffers.\n",
+	     mapped, pool->get_num_frames() );
+  }
+
+  return mapped;
+}
+
+/* Without GL, frames are only hashed: the visible part of each plane,
+   eight bytes at a time, folded into one checksum of everything drawn */
+static uint64_t hash_plane( uint64_t hash, const uint8_t *plane,
+			    uint width, uint height, uint stride )
+{
+  const uint64_t multiplier = 0x9e3779b97f4a7c15ULL;
+
+  for ( uint row = 0; row < height; row++ ) {
+    const uint8_t *p = plane + row * stride;
+    uint x = 0;
+
+    for ( ; x + 8 <= width; x += 8 ) {
+      uint64_t word;
+      memcpy( &word, p + x, 8 );
+      hash = (hash ^ word) * multiplier;
+      hash ^= hash >> 32;
+    }
+
+    for ( ; x < width; x++ ) {
+      hash = (hash ^ p[ x ]) * multiplier;
+    }
+  }
+
+  return hash;
+}
+
+void OpcodeState::checksum_frame( Frame *frame )
+{
+  uint w = frame->get_width(), h = frame->get_height();
+
+  checksum = hash_plane( checksum, frame->get_y(), w, h, frame->get_stride() );
+  checksum = hash_plane( checksum, frame->get_cb(), w / 2, h / 2, frame->get_uv_stride() );
+  checksum = hash_plane( checksum, frame->get_cr(), w / 2, h / 2, frame->get_uv_stride() );
+}
+
+void OpcodeState::report_times( void )
+{
+  if ( frames_drawn ) {
+    const char *path = frames_mapped ? "mapped" : (use_pbo ? "PBO" : "direct");
+    fprintf( stderr, "Display thread: %u frames, %.2f ms upload (%s) + %.2f ms paint per frame.\n",
+	     frames_drawn, upload_us / 1000.0 / frames_drawn,
+	     output == OUTPUT_CHECKSUM ? "checksum" : path,
+	     paint_us / 1000.0 / frames_drawn );
+  }
+
+  if ( frames_timed > 1 ) {
+    fprintf( stderr, "Display thread: %u frames played at %.2f per second, %.2f ms mean and %.2f ms worst from decoder to swap.\n",
+	     frames_timed, (frames_timed - 1) * 1000000.0 / (last_us - first_swap_us),
+	     latency_us / 1000.0 / frames_timed, max_latency_us / 1000.0 );
+  }
+
+  if ( output == OUTPUT_CHECKSUM ) {
+    fprintf( stderr, "Display thread: checksum %016llx (depends on which frames were dropped).\n",
+	     (unsigned long long)checksum );
+  }
 }
 
 void OpenGLDisplay::loop( void )
 {
-  state.window_setup();
-  XMapRaised( state.display, state.window );
+  if ( state.output == OUTPUT_WINDOW ) {
+    state.window_setup();
+    XMapRaised( state.display, state.window );
+
+    init_context();
+  } else if ( state.output == OUTPUT_OFFSCREEN ) {
+    init_offscreen();
+  }
 
-  init_context();
-  state.reset_viewport();
+  if ( state.output != OUTPUT_CHECKSUM ) {
+    state.reset_viewport();
+
+    if ( frame_pool ) {
+      state.pool = frame_pool;
+      state.frames_mapped = state.map_frames( frame_pool );
+    }
+  }
+
+  {
+    MutexLock x( &ready_mutex );
+    ready = true;
+    unixassert( pthread_cond_signal( &ready_cond ) );
+  }
 
   while ( 1 ) {
     DisplayOperation *op = opq.dequeue( true );
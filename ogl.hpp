@@ -6,27 +6,49 @@
 #include <GL/glext.h>
 #include <GL/glx.h>
 #include <GL/glu.h>
+#include <EGL/egl.h>
 #include <stdint.h>
 
 #include "displayopq.hpp"
+#include "presentationclock.hpp"
 #include "displayop.hpp"
+#include "telemetry.hpp"
+
+/* Pixel buffer objects that uploads take turns in */
+const int num_pbos = 3;
+
+/* Where frames go. Without a window, no X server is needed, and
+   frames are presented at a simulated refresh rate: OUTPUT_CHECKSUM
+   only checksums each frame and releases it, OUTPUT_OFFSCREEN also
+   uploads and paints it in an offscreen EGL context. */
+enum DisplayOutput { OUTPUT_WINDOW, OUTPUT_CHECKSUM, OUTPUT_OFFSCREEN };
 
 class OpcodeState {
 private:
   static void load_tex( GLenum tnum, GLuint tex,
-			uint width, uint height, uint8_t *data );
+			uint width, uint height, uint stride, const GLvoid *data );
+  void load_planes( const GLvoid *y, const GLvoid *cb, const GLvoid *cr, uint stride );
 
 public:
+  DisplayOutput output;
   Display *display;
   Window window;
   GLXContext context;
   uint width, height; /* window size on screen */
   uint framewidth, frameheight; /* luma matrix dimensions */
   uint dispwidth, dispheight; /* MPEG-2 intended display size */
+  uint lowres; /* frames are decoded at framewidth >> lowres etc. */
+  uint texwidth, texheight; /* luma texture dimensions */
   double sar;
 
-  void draw( uint8_t *ycbcr );
-  void paint( void );
+  void upload( uint8_t *y, uint8_t *cb, uint8_t *cr, uint stride );
+  void upload_mapped( Frame *frame );
+  void retire_fence( void );
+  uint map_frames( BufferPool *pool );
+  void checksum_frame( Frame *frame );
+  void paint( int64_t due_us = 0 );
+  int64_t target_msc( int64_t due_us );
+  void wait_retrace( int64_t target );
   void window_setup( void );
   void reset_viewport( void );
 
@@ -38,9 +60,40 @@ public:
 				 double red[ 3 ] );
   GLuint Y_tex, Cb_tex, Cr_tex;
 
+  bool use_pbo; /* else uploads come straight from the frame */
+  GLuint pbo[ num_pbos ];
+  int next_pbo;
+  uint frames_mapped; /* pool frames decoded straight into GL buffers */
+  BufferPool *pool;
+  Frame *fenced; /* textures are loading from its buffer */
+
+  /* display thread time for frames, reported at exit */
+  uint frames_drawn;
+  int64_t upload_us, paint_us;
+  void report_times( void );
+
+  FrameTimingLog *timings;
+
+  /* from being sent by the decoder to the swap, for timed pictures */
+  uint frames_timed;
+  int64_t first_swap_us, latency_us, max_latency_us;
+
+  /* without a window */
+  int64_t refresh_us, retrace_origin_us;
+  uint64_t checksum; /* of every frame drawn, in order */
+
   Bool (*GetSync)(Display*, GLXDrawable, int64_t*, int64_t*, int64_t*);
+  int64_t (*SwapBuffersMsc)(Display*, GLXDrawable, int64_t, int64_t, int64_t);
+  Bool (*WaitForSbc)(Display*, GLXDrawable, int64_t, int64_t*, int64_t*, int64_t*);
+  double retrace_us; /* measured, or the simulated refresh */
+  double anchor_msc; /* fractional, see target_msc() */
+  int64_t anchor_due_us;
+  int64_t held_us;
   int64_t last_mbc;
+  int64_t last_ust;
   int64_t last_us;
+
+  PresentationClock clock;
 };
 
 class OpenGLDisplay {
@@ -49,7 +102,14 @@ class OpenGLDisplay {
 
   GLuint shader;
 
+  EGLDisplay egl_display;
+  EGLContext egl_context;
+  GLuint framebuffer, renderbuffer;
+
+  void start( void );
   void init_context( void );
+  void init_offscreen( void );
+  void init_rendering( void );
   static void init_tex( GLenum tnum, GLint internalformat, GLuint *tex,
 			uint width, uint height, GLint interp );
 
@@ -57,10 +117,23 @@ class OpenGLDisplay {
   pthread_t thread_handle;
   Queue<DisplayOperation> opq;
 
+  FrameTimingLog timings;
+
+  /* frames to map before the decoder starts, and the wait for it */
+  BufferPool *frame_pool;
+  bool ready;
+  pthread_mutex_t ready_mutex;
+  pthread_cond_t ready_cond;
+
  public:
   OpenGLDisplay( char *display_name, double movie_sar,
 		 uint s_framewidth, uint s_frameheight,
-		 uint s_dispwidth, uint s_dispheight );
+		 uint s_dispwidth, uint s_dispheight,
+		 uint s_lowres, BufferPool *s_frame_pool );
+  OpenGLDisplay( DisplayOutput s_output, double refresh_hz,
+		 uint s_framewidth, uint s_frameheight,
+		 uint s_dispwidth, uint s_dispheight,
+		 uint s_lowres, BufferPool *s_frame_pool );
   ~OpenGLDisplay();
   bool getevent( bool block, XEvent *ev );
   void makeevent( void );
@@ -68,6 +141,8 @@ class OpenGLDisplay {
   void loop( void );
 
   Queue<DisplayOperation> *get_queue() { return &opq; }
+  PresentationClock *get_clock() { return &state.clock; }
+  FrameTimingLog *get_timings() { return &timings; }
 
   static void GLcheck( const char *where ) {
     GLenum GLerror;
@@ -2,6 +2,8 @@
 #define OPQ_CPP
 
 #include <pthread.h>
+#include <time.h>
+#include <errno.h>
 
 #include "opq.hpp"
 #include "exceptions.hpp"
@@ -20,7 +22,15 @@ Queue<T>::Queue( int s_max_size )
     enqueue_callback( NULL )
 {
   unixassert( pthread_mutex_init( &mutex, NULL ) );
-  unixassert( pthread_cond_init( &write_activity, NULL ) );
+
+  /* dequeue_timeout() waits on write_activity against a monotonic
+     deadline, so a wall-clock step can't stretch or cut the wait */
+  pthread_condattr_t attr;
+  unixassert( pthread_condattr_init( &attr ) );
+  unixassert( pthread_condattr_setclock( &attr, CLOCK_MONOTONIC ) );
+  unixassert( pthread_cond_init( &write_activity, &attr ) );
+  unixassert( pthread_condattr_destroy( &attr ) );
+
   unixassert( pthread_cond_init( &read_activity, NULL ) );
 }
 
@@ -169,8 +179,6 @@ void Queue<T>::remove_specific( QueueElement<T> *op )
 template <class T>
 T *Queue<T>::dequeue( bool wait )
 {
-  QueueElement<T> *ret_elem;
-  T *ret;
   MutexLock x( &mutex );
 
   if ( (!wait) && (count == 0 ) ) {
@@ -181,6 +189,47 @@ T *Queue<T>::dequeue( bool wait )
     unixassert( pthread_cond_wait( &write_activity, &mutex ) );      
   }
 
+  return remove_tail();
+}
+
+template <class T>
+T *Queue<T>::dequeue_timeout( int64_t timeout_us )
+{
+  MutexLock x( &mutex );
+
+  if ( (count == 0) && (timeout_us > 0) ) {
+    struct timespec deadline;
+    unixassert( clock_gettime( CLOCK_MONOTONIC, &deadline ) );
+    deadline.tv_sec += timeout_us / 1000000;
+    deadline.tv_nsec += 1000 * (timeout_us % 1000000);
+    if ( deadline.tv_nsec >= 1000000000 ) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000;
+    }
+
+    while ( count == 0 ) {
+      int ret = pthread_cond_timedwait( &write_activity, &mutex, &deadline );
+      if ( ret == ETIMEDOUT ) {
+	break;
+      }
+      unixassert( ret );
+    }
+  }
+
+  if ( count == 0 ) {
+    return NULL;
+  }
+
+  return remove_tail();
+}
+
+/* Caller must hold the mutex */
+template <class T>
+T *Queue<T>::remove_tail( void )
+{
+  QueueElement<T> *ret_elem;
+  T *ret;
+
   ret_elem = tail;
   tail = tail->prev;
   if ( tail ) {
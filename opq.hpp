@@ -3,6 +3,7 @@
 
 #include <pthread.h>
 #include <sys/types.h>
+#include <stdint.h>
 
 #include "mutexobj.hpp"
 
@@ -34,6 +35,8 @@ private:
   void (*enqueue_callback)(void *obj);
   void *obj;
 
+  T *remove_tail( void );
+
 public:
   Queue( int s_max_size );
   Queue() { Queue( 0 ); }
@@ -44,6 +47,7 @@ public:
   void remove_specific( QueueElement<T> *op );
 
   T *dequeue( bool wait );
+  T *dequeue_timeout( int64_t timeout_us );
 
   void flush_type( T *h );
   void flush( void );  
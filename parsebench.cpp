@@ -19,7 +19,7 @@ int main( int argc, char *argv[] )
   assert( argc == 2 );
 
   File *file = new File( argv[ 1 ] );
-  ES *stream = new ES( file, &progress_bar );
+  ES *stream = new ES( file, &progress_bar, 0 );
 
   unixassert( clock_gettime( CLOCK_REALTIME, &finish ) );
 
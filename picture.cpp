@@ -195,10 +195,11 @@ void Picture::print_info( void ) {
 
 void Picture::setup_decoder( mpeg2_decoder_t *d, uint8_t *current_fbuf[3],
 			     uint8_t *forward_fbuf[3],
-			     uint8_t *backward_fbuf[3] )
+			     uint8_t *backward_fbuf[3],
+			     int stride, int lowres )
 {
   d->picture_structure = get_extension()->picture_structure;
-  d->stride_frame = 16 * get_sequence()->get_mb_width();
+  d->stride_frame = stride << lowres;
   d->width = 16 * get_sequence()->get_mb_width();
   d->height = 16 * get_sequence()->get_mb_height();
   d->coding_type = type;
@@ -213,7 +214,6 @@ void Picture::setup_decoder( mpeg2_decoder_t *d, uint8_t *current_fbuf[3],
   d->top_field_first = get_extension()->top_field_first;
   d->convert = NULL;
   d->convert_id = NULL;
-  d->mpeg1 = 0;
   
   d->f_motion.f_code[ 0 ] = get_extension()->f_code_fh - 1;
   d->f_motion.f_code[ 1 ] = get_extension()->f_code_fv - 1;
@@ -234,10 +234,7 @@ void Picture::setup_decoder( mpeg2_decoder_t *d, uint8_t *current_fbuf[3],
   d->chroma_quantizer[ 0 ] = d->quantizer_prescale[ 0 ];
   d->chroma_quantizer[ 1 ] = d->quantizer_prescale[ 1 ];
 
-  int stride, height;
-  
-  stride = d->stride_frame;
-  height = d->height;
+  int height = d->height;
   
   d->picture_dest[0] = current_fbuf[0];
   d->picture_dest[1] = current_fbuf[1];
@@ -253,7 +250,7 @@ void Picture::setup_decoder( mpeg2_decoder_t *d, uint8_t *current_fbuf[3],
   
   d->stride = stride;
   d->uv_stride = stride >> 1;
-  d->slice_stride = 16 * stride;
+  d->slice_stride = (16 >> lowres) * stride;
   d->slice_uv_stride =
     d->slice_stride >> (2 - d->chroma_format);
   d->limit_x = 2 * d->width - 32;
@@ -262,10 +259,22 @@ void Picture::setup_decoder( mpeg2_decoder_t *d, uint8_t *current_fbuf[3],
   d->limit_y = height - 16;
 
   d->invalid = false;
+  d->dc_only = false;
+  d->lowres = lowres;
+
+  const mpeg2_kernels_t *kernels = mpeg2_kernels();
+  d->idct_copy = kernels->idct_copy;
+  d->idct_add = kernels->idct_add;
+  d->idct_copy2 = kernels->idct_copy2;
+  d->idct_add2 = kernels->idct_add2;
+  d->mc_put = kernels->mc->put;
+  d->mc_avg = kernels->mc->avg;
+  d->emms = kernels->emms;
 
-  memset( d->DCTblock, 0, 64 * sizeof( int16_t ) );
+  memset( d->DCTblock, 0, sizeof( d->DCTblock ) );
 
   motion_setup( d );
+  slice_setup( d );
 }
 
 void Picture::start_parallel_decode( DecodeEngine *engine, bool leave_locked )
@@ -286,6 +295,12 @@ void Picture::start_parallel_decode( DecodeEngine *engine, bool leave_locked )
 	fh->increment_lockcount();
       }
       return;
+    } else if ( fh->increment_lockcount_if_renderable() ) {
+      /* Another thread finished decoding since we checked above */
+      if ( !leave_locked ) {
+	fh->decrement_lockcount();
+      }
+      return;
     } else {
       decoding++;
     }
@@ -314,19 +329,16 @@ void Picture::start_parallel_decode( DecodeEngine *engine, bool leave_locked )
   uint8_t *fwdf[3] = { fwd->get_y(), fwd->get_cb(), fwd->get_cr() };
   uint8_t *backf[3] = { back->get_y(), back->get_cb(), back->get_cr() };
 
-  uint height = 16 * get_sequence()->get_mb_height();
-  uint width = 16 * get_sequence()->get_mb_width();
-
   if ( problem() ) {
-    memset( curf[0], 128, 3 * height * width / 2 );
+    cur->clear();
   }
 
   mpeg2_decoder_t *topdown_d, *bottomup_d;
   unixassert( posix_memalign( (void **)&topdown_d, 64, sizeof( mpeg2_decoder_t ) ) );
   unixassert( posix_memalign( (void **)&bottomup_d, 64, sizeof( mpeg2_decoder_t ) ) );
 
-  setup_decoder( topdown_d, curf, fwdf, backf );
-  setup_decoder( bottomup_d, curf, fwdf, backf );
+  setup_decoder( topdown_d, curf, fwdf, backf, cur->get_stride(), cur->get_lowres() );
+  setup_decoder( bottomup_d, curf, fwdf, backf, cur->get_stride(), cur->get_lowres() );
 
   DecodeSlices *topdown = new DecodeSlices( this, TOPDOWN, topdown_d, cur, fwd, back );
   DecodeSlices *bottomup = new DecodeSlices( this, BOTTOMUP, bottomup_d, cur, fwd, back );
@@ -514,49 +526,82 @@ void Picture::lock_and_decodeall( void )
   uint8_t *fwdf[3] = { fwd->get_y(), fwd->get_cb(), fwd->get_cr() };
   uint8_t *backf[3] = { back->get_y(), back->get_cb(), back->get_cr() };
 
-  uint height = 16 * get_sequence()->get_mb_height();
-  uint width = 16 * get_sequence()->get_mb_width();
-
   if ( problem() ) {
-    memset( cur->get_y(), 128, height * width );
-    memset( cur->get_cb(), 128, height * width / 4 );
-    memset( cur->get_cr(), 128, height * width / 4 );
+    cur->clear();
   }
 
+  mpeg2_decoder_t d;
+  setup_decoder( &d, curf, fwdf, backf, cur->get_stride(), cur->get_lowres() );
+
+  decode_all_slices( &d );
+
+  fh->get_frame()->set_rendered();
+
+  if ( forward_reference ) forward_reference->get_framehandle()->decrement_lockcount();  
+  if ( backward_reference ) backward_reference->get_framehandle()->decrement_lockcount();
+
+  /* leave myself locked */
+}
+
+void Picture::decode_all_slices( mpeg2_decoder_t *d )
+{
   uint rows = get_sequence()->get_mb_height();
 
-  mpeg2_decoder_t d;
-  setup_decoder( &d, curf, fwdf, backf );
+  if ( slices_start == slices_end ) {
+    return;
+  }
+
+  /* One mapping for all the slices, as in decoder_internal() */
+  MapHandle *chunk = file->map( slices_start, slices_end - slices_start );
 
   for ( uint row = 0; row < rows; row++ ) {
     Slice *s = get_first_slice_in_row( row );
     while ( s != NULL ) {
-      MapHandle *chunk = s->map_chunk();
+      off_t slice_offset = s->get_location() - slices_start;
 
-      d.bitstream_buf = 0;
-      d.bitstream_bits = 0;
-      d.bitstream_ptr = chunk->get_buf() + 4;
-      d.bit_ptr_end = chunk->get_buf() + chunk->get_len();
+      d->bitstream_buf = 0;
+      d->bitstream_bits = 0;
+      d->bitstream_ptr = chunk->get_buf() + slice_offset + 4;
+      d->bit_ptr_end = chunk->get_buf() + slice_offset + s->get_len();
 
-      s->decode( &d, s->get_val(), chunk->get_buf() + 4 );
+      s->decode( d, s->get_val(), chunk->get_buf() + slice_offset + 4 );
 
-      if ( d.invalid ) {
+      if ( d->invalid ) {
 	invalid = true;
-	d.invalid = false;
+	d->invalid = false;
       }
 
-      delete chunk;
-
       s = s->get_next_in_row();
     }
   }
 
-  fh->get_frame()->set_rendered();
+  delete chunk;
+}
 
-  if ( forward_reference ) forward_reference->get_framehandle()->decrement_lockcount();  
-  if ( backward_reference ) backward_reference->get_framehandle()->decrement_lockcount();
+void Picture::decode_dc_only( uint8_t *y, uint8_t *cb, uint8_t *cr )
+{
+  ahabassert( type == I );
 
-  /* leave myself locked */
+  uint luma_size = 4 * get_sequence()->get_mb_width() * get_sequence()->get_mb_height();
+
+  if ( problem() ) {
+    memset( y, 128, luma_size );
+    memset( cb, 128, luma_size / 4 );
+    memset( cr, 128, luma_size / 4 );
+  }
+
+  /* An I picture has no references. Each macroblock writes its pixels
+     at its own place in the small planes (see slice_dc_only), so the
+     per-row destination pointers are kept from moving at all. */
+  uint8_t *dcf[3] = { y, cb, cr };
+
+  mpeg2_decoder_t d;
+  setup_decoder( &d, dcf, dcf, dcf, 2 * get_sequence()->get_mb_width(), 0 );
+  d.slice_stride = d.slice_uv_stride = 0;
+  d.dc_only = true;
+  slice_setup( &d );
+
+  decode_all_slices( &d );
 }
 
 void Picture::init_fh( BufferPool *pool )
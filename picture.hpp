@@ -42,9 +42,13 @@ private:
   void setup_decoder( mpeg2_decoder_t *d,
 		      uint8_t *current_fbuf[3],
 		      uint8_t *forward_fbuf[3],
-		      uint8_t *backward_fbuf[3] );
+		      uint8_t *backward_fbuf[3],
+		      int stride, int lowres );
 
   static void motion_setup( mpeg2_decoder_t *d );
+  static void slice_setup( mpeg2_decoder_t *d );
+
+  void decode_all_slices( mpeg2_decoder_t *d );
 
   FrameHandle *fh;
 
@@ -122,6 +126,7 @@ public:
 
   int get_f_code_fv( void ) { return get_extension()->f_code_fv; }
   int get_f_code_bv( void ) { return get_extension()->f_code_bv; }
+  bool get_field_motion( void ) { return !get_extension()->frame_pred_frame_dct; }
 
   FrameHandle *get_framehandle( void ) { return fh; }
 
@@ -134,6 +139,14 @@ public:
   virtual void link( void );
 
   void lock_and_decodeall();
+
+  /* I pictures only: decode just the DC coefficients into 1/8-scale
+     planes of (2 * mb_width) x (2 * mb_height) luma and
+     mb_width x mb_height chroma. No frame from the pool is used.
+     Every coefficient still has to be parsed, which dominates, so
+     this is less than twice as fast as decoding the picture in full;
+     for thumbnails (export -s), not for the controller's previews. */
+  void decode_dc_only( uint8_t *y, uint8_t *cb, uint8_t *cr );
   void start_parallel_decode( DecodeEngine *engine, bool leave_locked );
   void decoder_internal( DecodeSlices *job );
   void decoder_cleanup_internal( bool leave_locked );
@@ -0,0 +1,65 @@
+#include <time.h>
+
+#include "presentationclock.hpp"
+#include "exceptions.hpp"
+#include "mutexobj.hpp"
+
+PresentationClock::PresentationClock()
+  : origin_us( 0 ), latency_us( 0 ), retrace_us( 0 ), late( 0 )
+{
+  unixassert( pthread_mutex_init( &mutex, NULL ) );
+}
+
+PresentationClock::~PresentationClock()
+{
+  unixassert( pthread_mutex_destroy( &mutex ) );
+}
+
+int64_t PresentationClock::now( void )
+{
+  struct timespec ts;
+  unixassert( clock_gettime( CLOCK_MONOTONIC, &ts ) );
+  return 1000000 * (int64_t)ts.tv_sec + ts.tv_nsec / 1000;
+}
+
+/* Present stream_time now */
+void PresentationClock::start( double stream_time )
+{
+  origin_us = now() - (int64_t)(stream_time * 1000000.0);
+}
+
+int64_t PresentationClock::get_latency( void )
+{
+  MutexLock x( &mutex );
+  return latency_us;
+}
+
+uint PresentationClock::take_late( void )
+{
+  MutexLock x( &mutex );
+  uint ret = late;
+  late = 0;
+  return ret;
+}
+
+void PresentationClock::report_retrace( int64_t s_retrace_us )
+{
+  MutexLock x( &mutex );
+  retrace_us = s_retrace_us;
+}
+
+void PresentationClock::report_swap( int64_t sent_us, int64_t due_us,
+				     int64_t shown_us, int64_t held_us )
+{
+  MutexLock x( &mutex );
+
+  /* Moving average over roughly the last eight pictures. Sending a
+     picture earlier would not have shown it any sooner than its
+     target retrace, so time held for that isn't latency. */
+  latency_us += (shown_us - held_us - sent_us - latency_us) / 8;
+
+  /* A swap can land up to one retrace after the deadline */
+  if ( shown_us > due_us + retrace_us ) {
+    late++;
+  }
+}
@@ -0,0 +1,42 @@
+#ifndef PRESENTATIONCLOCK_HPP
+#define PRESENTATIONCLOCK_HPP
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/* Maps stream presentation times (Picture::get_time()) onto
+   CLOCK_MONOTONIC while playing. The display thread reports when
+   each timed picture actually reached the screen, and the retrace
+   period read from the OML sync counters; the decoder uses these
+   to decide when to send a picture and whether it can still make
+   its deadline. */
+class PresentationClock {
+private:
+  pthread_mutex_t mutex;
+
+  int64_t origin_us; /* monotonic time of stream time zero */
+
+  int64_t latency_us; /* smoothed time from sending a picture to its swap,
+			 less any time it was held for its retrace */
+  int64_t retrace_us;
+  uint late;
+
+public:
+  PresentationClock();
+  ~PresentationClock();
+
+  static int64_t now( void );
+
+  /* Called by the decoder */
+  void start( double stream_time );
+  int64_t due( double stream_time ) { return origin_us + (int64_t)(stream_time * 1000000.0); }
+  int64_t get_latency( void );
+  uint take_late( void );
+
+  /* Called by the display */
+  void report_retrace( int64_t s_retrace_us );
+  void report_swap( int64_t sent_us, int64_t due_us, int64_t shown_us, int64_t held_us );
+};
+
+#endif
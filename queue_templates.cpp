@@ -4,10 +4,14 @@
 #include "framebuffer.hpp"
 #include "decodeengine.hpp"
 #include "controllerop.hpp"
+#include "ringqueue.cpp"
 
-template class Queue<DecoderJob>;
 template class Queue<DecoderOperation>;
 template class Queue<DisplayOperation>;
-template class Queue<Frame>;
-template class Queue<ReadyThread>;
+template class Queue<CachedFrame>;
 template class Queue<ControllerOperation>;
+
+template class RingQueue<DecoderJob>;
+template class RingQueue<ReadyThread>;
+template class RingQueue<SpillWrite>;
+template class RingQueue<CachedFrame>;
@@ -0,0 +1,174 @@
+#ifndef RINGQUEUE_CPP
+#define RINGQUEUE_CPP
+
+#include <unistd.h>
+#include <limits.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "ringqueue.hpp"
+#include "exceptions.hpp"
+
+inline uint32_t EventCount::prepare_wait( void )
+{
+  __atomic_add_fetch( &waiters, 1, __ATOMIC_SEQ_CST );
+  /* the caller's check after this must not be seen before it */
+  __atomic_thread_fence( __ATOMIC_SEQ_CST );
+  return __atomic_load_n( &sequence, __ATOMIC_ACQUIRE );
+}
+
+inline void EventCount::cancel_wait( void )
+{
+  __atomic_sub_fetch( &waiters, 1, __ATOMIC_RELAXED );
+}
+
+inline void EventCount::wait( uint32_t key )
+{
+  /* Returns at once if a notify() came after prepare_wait() */
+  syscall( SYS_futex, &sequence, FUTEX_WAIT_PRIVATE, key, NULL, NULL, 0 );
+  __atomic_sub_fetch( &waiters, 1, __ATOMIC_RELAXED );
+}
+
+inline void EventCount::notify( void )
+{
+  /* pairs with the fence in prepare_wait(): either the waiter sees the
+     change, or we see the waiter */
+  __atomic_thread_fence( __ATOMIC_SEQ_CST );
+  if ( __atomic_load_n( &waiters, __ATOMIC_RELAXED ) ) {
+    __atomic_add_fetch( &sequence, 1, __ATOMIC_RELEASE );
+    syscall( SYS_futex, &sequence, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0 );
+  }
+}
+
+template <class T>
+RingQueue<T>::RingQueue( uint s_capacity )
+  : cells( NULL ), mask( 0 ), enqueue_pos( 0 ), dequeue_pos( 0 ),
+    readable(), writable()
+{
+  uint capacity = 2;
+  while ( capacity < s_capacity ) {
+    capacity *= 2;
+  }
+
+  mask = capacity - 1;
+  cells = new Cell[ capacity ];
+  for ( uint i = 0; i < capacity; i++ ) {
+    cells[ i ].sequence = i;
+    cells[ i ].element = NULL;
+  }
+}
+
+template <class T>
+RingQueue<T>::~RingQueue()
+{
+  T *op;
+  while ( (op = try_dequeue()) ) {
+    delete op;
+  }
+
+  delete[] cells;
+}
+
+template <class T>
+bool RingQueue<T>::try_enqueue( T *h )
+{
+  uint64_t pos = __atomic_load_n( &enqueue_pos, __ATOMIC_RELAXED );
+  Cell *cell;
+
+  while ( 1 ) {
+    cell = &cells[ pos & mask ];
+    int64_t diff = (int64_t)__atomic_load_n( &cell->sequence, __ATOMIC_ACQUIRE ) - (int64_t)pos;
+
+    if ( diff == 0 ) {
+      /* our turn at this cell, if no other producer claims it first */
+      if ( __atomic_compare_exchange_n( &enqueue_pos, &pos, pos + 1, true,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED ) ) {
+	break;
+      }
+    } else if ( diff < 0 ) {
+      /* the cell has not been consumed since last time around */
+      return false;
+    } else {
+      pos = __atomic_load_n( &enqueue_pos, __ATOMIC_RELAXED );
+    }
+  }
+
+  cell->element = h;
+  __atomic_store_n( &cell->sequence, pos + 1, __ATOMIC_RELEASE );
+
+  readable.notify();
+  return true;
+}
+
+template <class T>
+T *RingQueue<T>::try_dequeue( void )
+{
+  uint64_t pos = __atomic_load_n( &dequeue_pos, __ATOMIC_RELAXED );
+  Cell *cell;
+
+  while ( 1 ) {
+    cell = &cells[ pos & mask ];
+    int64_t diff = (int64_t)__atomic_load_n( &cell->sequence, __ATOMIC_ACQUIRE ) - (int64_t)(pos + 1);
+
+    if ( diff == 0 ) {
+      if ( __atomic_compare_exchange_n( &dequeue_pos, &pos, pos + 1, true,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED ) ) {
+	break;
+      }
+    } else if ( diff < 0 ) {
+      /* empty */
+      return NULL;
+    } else {
+      pos = __atomic_load_n( &dequeue_pos, __ATOMIC_RELAXED );
+    }
+  }
+
+  T *ret = cell->element;
+  /* free for the producer one lap ahead */
+  __atomic_store_n( &cell->sequence, pos + mask + 1, __ATOMIC_RELEASE );
+
+  writable.notify();
+  return ret;
+}
+
+template <class T>
+void RingQueue<T>::enqueue( T *h )
+{
+  while ( !try_enqueue( h ) ) {
+    uint32_t key = writable.prepare_wait();
+    if ( try_enqueue( h ) ) {
+      writable.cancel_wait();
+      return;
+    }
+    writable.wait( key );
+  }
+}
+
+template <class T>
+T *RingQueue<T>::dequeue( bool wait )
+{
+  T *ret = try_dequeue();
+
+  while ( wait && !ret ) {
+    uint32_t key = readable.prepare_wait();
+    ret = try_dequeue();
+    if ( ret ) {
+      readable.cancel_wait();
+      break;
+    }
+    readable.wait( key );
+    ret = try_dequeue();
+  }
+
+  return ret;
+}
+
+template <class T>
+int RingQueue<T>::get_count( void )
+{
+  uint64_t out = __atomic_load_n( &dequeue_pos, __ATOMIC_RELAXED );
+  uint64_t in = __atomic_load_n( &enqueue_pos, __ATOMIC_RELAXED );
+  return in > out ? in - out : 0;
+}
+
+#endif
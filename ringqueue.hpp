@@ -0,0 +1,76 @@
+#ifndef RINGQUEUE_HPP
+#define RINGQUEUE_HPP
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/* Lets threads sleep until some condition they check without a lock
+   may have changed. A waiter calls prepare_wait(), checks once more,
+   and then either cancel_wait()s or wait()s with the key; a thread
+   that changes the condition calls notify() afterwards. notify() is a
+   fence and a load when nobody is waiting. */
+class EventCount
+{
+private:
+  uint32_t sequence;
+  uint32_t waiters;
+
+public:
+  EventCount() : sequence( 0 ), waiters( 0 ) {}
+
+  uint32_t prepare_wait( void );
+  void cancel_wait( void );
+  void wait( uint32_t key );
+  void notify( void );
+};
+
+/* Bounded multi-producer, multi-consumer FIFO of pointers, without
+   locks (D. Vyukov's ring: every cell carries a sequence number that
+   says whose turn it is). Nothing is allocated after construction.
+   enqueue() waits while the ring is full and dequeue( true ) while it
+   is empty, on EventCounts.
+
+   For hand-offs between threads. Queue<T> remains for queues that
+   need remove_specific(), leapfrog_enqueue(), flush_type() or
+   hookup(). */
+template <class T>
+class RingQueue
+{
+private:
+  struct Cell {
+    uint64_t sequence;
+    T *element;
+  };
+
+  Cell *cells;
+  uint64_t mask;
+
+  /* Padded apart, as producers and consumers each hammer one of
+     them. (Padding rather than alignment, which new does not honour
+     before C++17.) */
+  uint8_t pad0[ 64 ];
+  uint64_t enqueue_pos;
+  uint8_t pad1[ 64 - sizeof( uint64_t ) ];
+  uint64_t dequeue_pos;
+  uint8_t pad2[ 64 - sizeof( uint64_t ) ];
+
+  EventCount readable, writable;
+
+  RingQueue( const RingQueue & );
+  RingQueue & operator=( const RingQueue & );
+
+public:
+  RingQueue( uint s_capacity );
+  ~RingQueue();
+
+  bool try_enqueue( T *h );
+  void enqueue( T *h );
+
+  T *try_dequeue( void );
+  T *dequeue( bool wait );
+
+  /* May be stale by the time it returns */
+  int get_count( void );
+};
+
+#endif
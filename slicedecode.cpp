@@ -35,11 +35,31 @@
 
 #include <stdio.h>
 
-extern mpeg2_mc_t mpeg2_mc;
-
 #include "vlc.h"
 #include "mmx.h"
 
+/* The MMX kernel sets share registers with the FPU */
+#define mpeg2_emms()				\
+do {						\
+    if (decoder->emms)				\
+	emms ();				\
+} while (0)
+
+#ifdef MPEG2_CAPTURE
+/* kernelbench links a copy of this file built with these hooks, to
+   collect kernel inputs from real streams */
+#define CAPTURE_SLICE(decoder) mpeg2_capture_slice (decoder)
+#define CAPTURE_BLOCK(decoder,parser,block,quant_matrix)	\
+    mpeg2_capture_block (decoder, parser, block, quant_matrix)
+#else
+#define CAPTURE_SLICE(decoder) do {} while (0)
+#define CAPTURE_BLOCK(decoder,parser,block,quant_matrix) do {} while (0)
+#endif
+
+/* Ahab only decodes frame pictures (field pictures are rejected when
+ * the picture coding extension is parsed), so the field picture cases
+ * of libmpeg2 are gone and the rest is resolved at compile time. */
+template <int CODING_TYPE, bool FRAME_PRED_FRAME_DCT>
 static inline int get_macroblock_modes (mpeg2_decoder_t * const decoder)
 {
 #define bit_buf (decoder->bitstream_buf)
@@ -48,15 +68,14 @@ static inline int get_macroblock_modes (mpeg2_decoder_t * const decoder)
     int macroblock_modes;
     const MBtab * tab;
 
-    switch (decoder->coding_type) {
+    switch (CODING_TYPE) {
     case I_TYPE:
 
 	tab = MB_I + UBITS (bit_buf, 1);
 	DUMPBITS (bit_buf, bits, tab->len);
 	macroblock_modes = tab->modes;
 
-	if ((! (decoder->frame_pred_frame_dct)) &&
-	    (decoder->picture_structure == FRAME_PICTURE)) {
+	if (! FRAME_PRED_FRAME_DCT) {
 	    macroblock_modes |= UBITS (bit_buf, 1) * DCT_TYPE_INTERLACED;
 	    DUMPBITS (bit_buf, bits, 1);
 	}
@@ -69,13 +88,7 @@ static inline int get_macroblock_modes (mpeg2_decoder_t * const decoder)
 	DUMPBITS (bit_buf, bits, tab->len);
 	macroblock_modes = tab->modes;
 
-	if (decoder->picture_structure != FRAME_PICTURE) {
-	    if (macroblock_modes & MACROBLOCK_MOTION_FORWARD) {
-		macroblock_modes |= UBITS (bit_buf, 2) << MOTION_TYPE_SHIFT;
-		DUMPBITS (bit_buf, bits, 2);
-	    }
-	    return macroblock_modes | MACROBLOCK_MOTION_FORWARD;
-	} else if (decoder->frame_pred_frame_dct) {
+	if (FRAME_PRED_FRAME_DCT) {
 	    if (macroblock_modes & MACROBLOCK_MOTION_FORWARD)
 		macroblock_modes |= MC_FRAME << MOTION_TYPE_SHIFT;
 	    return macroblock_modes | MACROBLOCK_MOTION_FORWARD;
@@ -97,13 +110,7 @@ static inline int get_macroblock_modes (mpeg2_decoder_t * const decoder)
 	DUMPBITS (bit_buf, bits, tab->len);
 	macroblock_modes = tab->modes;
 
-	if (decoder->picture_structure != FRAME_PICTURE) {
-	    if (! (macroblock_modes & MACROBLOCK_INTRA)) {
-		macroblock_modes |= UBITS (bit_buf, 2) << MOTION_TYPE_SHIFT;
-		DUMPBITS (bit_buf, bits, 2);
-	    }
-	    return macroblock_modes;
-	} else if (decoder->frame_pred_frame_dct) {
+	if (FRAME_PRED_FRAME_DCT) {
 	    /* if (! (macroblock_modes & MACROBLOCK_INTRA)) */
 	    macroblock_modes |= MC_FRAME << MOTION_TYPE_SHIFT;
 	    return macroblock_modes;
@@ -120,11 +127,6 @@ static inline int get_macroblock_modes (mpeg2_decoder_t * const decoder)
 	    return macroblock_modes;
 	}
 
-    case D_TYPE:
-
-	DUMPBITS (bit_buf, bits, 1);
-	return MACROBLOCK_INTRA;
-
     default:
 	return 0;
     }
@@ -341,33 +343,150 @@ do {						\
 	val = (SBITS (val, 1) ^ 2047) << 4;	\
 } while (0)
 
+/*
+ * One lookup on the next DCT_MULTI_BITS bits resolves every short code
+ * that fits in them, signs included, up to DCT_MULTI_CODES codes and a
+ * following end of block. The tables are built at startup from the
+ * single-code tables below, so they cannot disagree with them. Escapes
+ * and longer codes are left to the single-code path, which is also
+ * taken whenever the runs would run off the end of the block, so that
+ * damaged streams are handled exactly as before.
+ */
+
+static const DCTtab * DCT_B14_code (const uint32_t bit_buf)
+{
+    if (bit_buf >= 0x28000000)
+	return DCT_B14AC_5 + (UBITS (bit_buf, 5) - 5);
+    else if (bit_buf >= 0x04000000)
+	return DCT_B14_8 + (UBITS (bit_buf, 8) - 4);
+    else if (bit_buf >= 0x02000000)
+	return DCT_B14_10 + (UBITS (bit_buf, 10) - 8);
+    return NULL;	/* longer than DCT_MULTI_BITS */
+}
+
+static const DCTtab * DCT_B15_code (const uint32_t bit_buf)
+{
+    if (bit_buf >= 0x04000000)
+	return DCT_B15_8 + (UBITS (bit_buf, 8) - 4);
+    else if (bit_buf >= 0x02000000)
+	return DCT_B15_10 + (UBITS (bit_buf, 10) - 8);
+    return NULL;
+}
+
+static void build_DCT_multi (DCTmulti * const table,
+			     const DCTtab * (* const code) (uint32_t))
+{
+    int index;
+
+    for (index = 0; index < (1 << DCT_MULTI_BITS); index++) {
+	DCTmulti * const multi = table + index;
+	uint32_t bit_buf = (uint32_t) index << (32 - DCT_MULTI_BITS);
+	int len = 0;
+
+	memset (multi, 0, sizeof (*multi));
+
+	while (1) {
+	    const DCTtab * const tab = code (bit_buf);
+
+	    if (tab == NULL)
+		break;
+	    if (tab->run >= 64) {	/* end of block or escape */
+		if (tab->run == 129 && len + tab->len <= DCT_MULTI_BITS) {
+		    multi->eob = 1;
+		    len += tab->len;
+		}
+		break;
+	    }
+	    if (multi->count == DCT_MULTI_CODES ||
+		len + tab->len + 1 > DCT_MULTI_BITS)
+		break;
+
+	    multi->run[multi->count] = tab->run;
+	    multi->level[multi->count] =
+		SBITS (bit_buf << tab->len, 1) ? -tab->level : tab->level;
+	    multi->adv += tab->run;
+	    multi->count++;
+
+	    len += tab->len + 1;
+	    bit_buf <<= tab->len + 1;
+	}
+
+	multi->len = len;
+	if (!len)
+	    multi->adv = 64;
+    }
+}
+
+static DCTmulti DCT_B14_multi [1 << DCT_MULTI_BITS];
+static DCTmulti DCT_B15_multi [1 << DCT_MULTI_BITS];
+
+static class DCTmultiInit {
+public:
+    DCTmultiInit ()
+    {
+	build_DCT_multi (DCT_B14_multi, DCT_B14_code);
+	build_DCT_multi (DCT_B15_multi, DCT_B15_code);
+    }
+} DCT_multi_init;
+
+/* store the codes of a multi entry, leaving i at the last one */
+#define MULTI_CODES(multi,dequant)				\
+do {								\
+    for (k = 0; k < multi->count; k++) {			\
+	const int level = multi->level[k];			\
+	const int sign = level >> 31;				\
+								\
+	i += multi->run[k];					\
+	j = scan[i];						\
+	val = (level ^ sign) - sign;				\
+	val = dequant;						\
+	val = (val ^ sign) - sign;				\
+								\
+	SATURATE (val);						\
+	dest[j] = val;						\
+	mismatch ^= val;					\
+    }								\
+} while (0)
+
 static void get_intra_block_B14 (mpeg2_decoder_t * const decoder,
+				 int16_t * const dest,
 				 const uint16_t * const quant_matrix)
 {
     int i;
     int j;
+    int k;
     int val;
     const uint8_t * const scan = decoder->scan;
     int mismatch;
     const DCTtab * tab;
-    uint32_t bit_buf;
-    int bits;
+    const DCTmulti * multi;
+    uint64_t bit_buf;
+    uint32_t top;
+    int avail;
     const uint8_t * bit_ptr;
-    int16_t * const dest = decoder->DCTblock;
 
     i = 0;
     mismatch = ~dest[0];
 
-    bit_buf = decoder->bitstream_buf;
-    bits = decoder->bitstream_bits;
-    bit_ptr = decoder->bitstream_ptr;
-
-    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
+    BITSTREAM_GET64 (decoder, bit_buf, avail, bit_ptr);
 
     while (1) {
-	if (bit_buf >= 0x28000000) {
+	NEEDBITS64 (bit_buf, avail, bit_ptr, decoder->bit_ptr_end);
+
+	multi = DCT_B14_multi + UBITS64 (bit_buf, DCT_MULTI_BITS);
+	if (likely (i + multi->adv < 64)) {
+	    MULTI_CODES (multi, (val * quant_matrix[j]) >> 4);
+	    DUMPBITS64 (bit_buf, avail, multi->len);
+	    if (multi->eob)
+		goto end_of_block;
+	    continue;
+	}
 
-	    tab = DCT_B14AC_5 + (UBITS (bit_buf, 5) - 5);
+	top = bit_buf >> 32;
+
+	if (top >= 0x28000000) {
+
+	    tab = DCT_B14AC_5 + (UBITS (top, 5) - 5);
 
 	    i += tab->run;
 	    if (i >= 64)
@@ -376,24 +495,23 @@ static void get_intra_block_B14 (mpeg2_decoder_t * const decoder,
 	normal_code:
 	    j = scan[i];
 	    bit_buf <<= tab->len;
-	    bits += tab->len + 1;
+	    avail -= tab->len + 1;
 	    val = (tab->level * quant_matrix[j]) >> 4;
 
 	    /* if (bitstream_get (1)) val = -val; */
-	    val = (val ^ SBITS (bit_buf, 1)) - SBITS (bit_buf, 1);
+	    val = (val ^ SBITS64 (bit_buf, 1)) - SBITS64 (bit_buf, 1);
 
 	    SATURATE (val);
 	    dest[j] = val;
 	    mismatch ^= val;
 
 	    bit_buf <<= 1;
-	    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
 
 	    continue;
 
-	} else if (bit_buf >= 0x04000000) {
+	} else if (top >= 0x04000000) {
 
-	    tab = DCT_B14_8 + (UBITS (bit_buf, 8) - 4);
+	    tab = DCT_B14_8 + (UBITS (top, 8) - 4);
 
 	    i += tab->run;
 	    if (i < 64)
@@ -401,7 +519,7 @@ static void get_intra_block_B14 (mpeg2_decoder_t * const decoder,
 
 	    /* escape code */
 
-	    i += UBITS (bit_buf << 6, 6) - 64;
+	    i += UBITS (top << 6, 6) - 64;
 	    if (i >= 64) {
 	      throw MPEGInvalid();
 	      break;	/* illegal, check needed to avoid buffer overflow */
@@ -409,38 +527,35 @@ static void get_intra_block_B14 (mpeg2_decoder_t * const decoder,
 
 	    j = scan[i];
 
-	    DUMPBITS (bit_buf, bits, 12);
-	    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
-	    val = (SBITS (bit_buf, 12) * quant_matrix[j]) / 16;
+	    DUMPBITS64 (bit_buf, avail, 12);
+	    val = (SBITS64 (bit_buf, 12) * quant_matrix[j]) / 16;
 
 	    SATURATE (val);
 	    dest[j] = val;
 	    mismatch ^= val;
 
-	    DUMPBITS (bit_buf, bits, 12);
-	    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
+	    DUMPBITS64 (bit_buf, avail, 12);
 
 	    continue;
 
-	} else if (bit_buf >= 0x02000000) {
-	    tab = DCT_B14_10 + (UBITS (bit_buf, 10) - 8);
+	} else if (top >= 0x02000000) {
+	    tab = DCT_B14_10 + (UBITS (top, 10) - 8);
 	    i += tab->run;
 	    if (i < 64)
 		goto normal_code;
-	} else if (bit_buf >= 0x00800000) {
-	    tab = DCT_13 + (UBITS (bit_buf, 13) - 16);
+	} else if (top >= 0x00800000) {
+	    tab = DCT_13 + (UBITS (top, 13) - 16);
 	    i += tab->run;
 	    if (i < 64)
 		goto normal_code;
-	} else if (bit_buf >= 0x00200000) {
-	    tab = DCT_15 + (UBITS (bit_buf, 15) - 16);
+	} else if (top >= 0x00200000) {
+	    tab = DCT_15 + (UBITS (top, 15) - 16);
 	    i += tab->run;
 	    if (i < 64)
 		goto normal_code;
 	} else {
-	    tab = DCT_16 + UBITS (bit_buf, 16);
-	    DUMPBITS(bit_buf, bits, 16 );
-	    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end );
+	    tab = DCT_16 + UBITS (top, 16);
+	    DUMPBITS64 (bit_buf, avail, 16);
 	    i += tab->run;
 	    if (i < 64)
 		goto normal_code;
@@ -450,40 +565,51 @@ static void get_intra_block_B14 (mpeg2_decoder_t * const decoder,
 	decoder->invalid = true;
 	break;	/* illegal, check needed to avoid buffer overflow */
     }
+    DUMPBITS64 (bit_buf, avail, tab->len);	/* dump end of block code */
+ end_of_block:
     dest[63] ^= mismatch & 16;
-    DUMPBITS (bit_buf, bits, tab->len);	/* dump end of block code */
-    decoder->bitstream_buf = bit_buf;
-    decoder->bitstream_bits = bits;
-    decoder->bitstream_ptr = bit_ptr;
+    BITSTREAM_PUT64 (decoder, bit_buf, avail, bit_ptr);
 }
 
 static void get_intra_block_B15 (mpeg2_decoder_t * const decoder,
+				 int16_t * const dest,
 				 const uint16_t * const quant_matrix)
 {
     int i;
     int j;
+    int k;
     int val;
     const uint8_t * const scan = decoder->scan;
     int mismatch;
     const DCTtab * tab;
-    uint32_t bit_buf;
-    int bits;
+    const DCTmulti * multi;
+    uint64_t bit_buf;
+    uint32_t top;
+    int avail;
     const uint8_t * bit_ptr;
-    int16_t * const dest = decoder->DCTblock;
 
     i = 0;
     mismatch = ~dest[0];
 
-    bit_buf = decoder->bitstream_buf;
-    bits = decoder->bitstream_bits;
-    bit_ptr = decoder->bitstream_ptr;
-
-    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
+    BITSTREAM_GET64 (decoder, bit_buf, avail, bit_ptr);
 
     while (1) {
-	if (bit_buf >= 0x04000000) {
+	NEEDBITS64 (bit_buf, avail, bit_ptr, decoder->bit_ptr_end);
+
+	multi = DCT_B15_multi + UBITS64 (bit_buf, DCT_MULTI_BITS);
+	if (likely (i + multi->adv < 64)) {
+	    MULTI_CODES (multi, (val * quant_matrix[j]) >> 4);
+	    DUMPBITS64 (bit_buf, avail, multi->len);
+	    if (multi->eob)
+		goto end_of_block;
+	    continue;
+	}
 
-	    tab = DCT_B15_8 + (UBITS (bit_buf, 8) - 4);
+	top = bit_buf >> 32;
+
+	if (top >= 0x04000000) {
+
+	    tab = DCT_B15_8 + (UBITS (top, 8) - 4);
 
 	    i += tab->run;
 	    if (i < 64) {
@@ -491,19 +617,17 @@ static void get_intra_block_B15 (mpeg2_decoder_t * const decoder,
 	    normal_code:
 		j = scan[i];
 		bit_buf <<= tab->len;
-		bits += tab->len + 1;
+		avail -= tab->len + 1;
 		val = (tab->level * quant_matrix[j]) >> 4;
 
 		/* if (bitstream_get (1)) val = -val; */
-		val = (val ^ SBITS (bit_buf, 1)) - SBITS (bit_buf, 1);
-				
+		val = (val ^ SBITS64 (bit_buf, 1)) - SBITS64 (bit_buf, 1);
 
 		SATURATE (val);
 		dest[j] = val;
 		mismatch ^= val;
 
 		bit_buf <<= 1;
-		NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
 
 		continue;
 
@@ -516,7 +640,7 @@ static void get_intra_block_B15 (mpeg2_decoder_t * const decoder,
 
 		/* escape code */
 
-		i += UBITS (bit_buf << 6, 6) - 64;
+		i += UBITS (top << 6, 6) - 64;
 		if (i >= 64) {
 		  //		  throw MPEGInvalid();
 		  /* This seems to show up in all kinds of bitstreams -- KJW */
@@ -526,39 +650,36 @@ static void get_intra_block_B15 (mpeg2_decoder_t * const decoder,
 
 		j = scan[i];
 
-		DUMPBITS (bit_buf, bits, 12);
-		NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
-		val = (SBITS (bit_buf, 12) * quant_matrix[j]) / 16;
+		DUMPBITS64 (bit_buf, avail, 12);
+		val = (SBITS64 (bit_buf, 12) * quant_matrix[j]) / 16;
 
 		SATURATE (val);
 		dest[j] = val;
 		mismatch ^= val;
 
-		DUMPBITS (bit_buf, bits, 12);
-		NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
+		DUMPBITS64 (bit_buf, avail, 12);
 
 		continue;
 
 	    }
-	} else if (bit_buf >= 0x02000000) {
-	    tab = DCT_B15_10 + (UBITS (bit_buf, 10) - 8);
+	} else if (top >= 0x02000000) {
+	    tab = DCT_B15_10 + (UBITS (top, 10) - 8);
 	    i += tab->run;
 	    if (i < 64)
 		goto normal_code;
-	} else if (bit_buf >= 0x00800000) {
-	    tab = DCT_13 + (UBITS (bit_buf, 13) - 16);
+	} else if (top >= 0x00800000) {
+	    tab = DCT_13 + (UBITS (top, 13) - 16);
 	    i += tab->run;
 	    if (i < 64)
 		goto normal_code;
-	} else if (bit_buf >= 0x00200000) {
-	    tab = DCT_15 + (UBITS (bit_buf, 15) - 16);
+	} else if (top >= 0x00200000) {
+	    tab = DCT_15 + (UBITS (top, 15) - 16);
 	    i += tab->run;
 	    if (i < 64)
 		goto normal_code;
 	} else {
-	    tab = DCT_16 + UBITS (bit_buf, 16);
-	    DUMPBITS(bit_buf, bits, 16 );
-	    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end );
+	    tab = DCT_16 + UBITS (top, 16);
+	    DUMPBITS64 (bit_buf, avail, 16);
 	    i += tab->run;
 	    if (i < 64)
 		goto normal_code;
@@ -568,45 +689,63 @@ static void get_intra_block_B15 (mpeg2_decoder_t * const decoder,
 	decoder->invalid = true;
 	break;	/* illegal, check needed to avoid buffer overflow */
     }
+    DUMPBITS64 (bit_buf, avail, tab->len);	/* dump end of block code */
+ end_of_block:
     dest[63] ^= mismatch & 16;
-    DUMPBITS (bit_buf, bits, tab->len);	/* dump end of block code */
-    decoder->bitstream_buf = bit_buf;
-    decoder->bitstream_bits = bits;
-    decoder->bitstream_ptr = bit_ptr;
+    BITSTREAM_PUT64 (decoder, bit_buf, avail, bit_ptr);
 }
 
 static int get_non_intra_block (mpeg2_decoder_t * const decoder,
+				int16_t * const dest,
 				const uint16_t * const quant_matrix)
 {
     int i;
     int j;
+    int k;
     int val;
     const uint8_t * const scan = decoder->scan;
     int mismatch;
     const DCTtab * tab;
-    uint32_t bit_buf;
-    int bits;
+    const DCTmulti * multi;
+    uint64_t bit_buf;
+    uint32_t top;
+    int avail;
     const uint8_t * bit_ptr;
-    int16_t * const dest = decoder->DCTblock;
 
     i = -1;
     mismatch = -1;
 
-    bit_buf = decoder->bitstream_buf;
-    bits = decoder->bitstream_bits;
-    bit_ptr = decoder->bitstream_ptr;
+    BITSTREAM_GET64 (decoder, bit_buf, avail, bit_ptr);
 
-    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
-    if (bit_buf >= 0x28000000) {
-	tab = DCT_B14DC_5 + (UBITS (bit_buf, 5) - 5);
+    /* the first code has its own table, so it never goes through
+       DCT_B14_multi */
+    NEEDBITS64 (bit_buf, avail, bit_ptr, decoder->bit_ptr_end);
+    top = bit_buf >> 32;
+    if (top >= 0x28000000) {
+	tab = DCT_B14DC_5 + (UBITS (top, 5) - 5);
 	goto entry_1;
     } else
 	goto entry_2;
 
     while (1) {
-	if (bit_buf >= 0x28000000) {
+	NEEDBITS64 (bit_buf, avail, bit_ptr, decoder->bit_ptr_end);
+
+	multi = DCT_B14_multi + UBITS64 (bit_buf, DCT_MULTI_BITS);
+	if (likely (i + multi->adv < 64)) {
+	    MULTI_CODES (multi, ((2 * val + 1) * quant_matrix[j]) >> 5);
+	    DUMPBITS64 (bit_buf, avail, multi->len);
+	    if (multi->eob) {
+		i += 129;	/* as the end of block code would */
+		goto end_of_block;
+	    }
+	    continue;
+	}
+
+	top = bit_buf >> 32;
+
+	if (top >= 0x28000000) {
 
-	    tab = DCT_B14AC_5 + (UBITS (bit_buf, 5) - 5);
+	    tab = DCT_B14AC_5 + (UBITS (top, 5) - 5);
 
 	entry_1:
 	    i += tab->run;
@@ -616,27 +755,26 @@ static int get_non_intra_block (mpeg2_decoder_t * const decoder,
 	normal_code:
 	    j = scan[i];
 	    bit_buf <<= tab->len;
-	    bits += tab->len + 1;
+	    avail -= tab->len + 1;
 	    val = ((2 * tab->level + 1) * quant_matrix[j]) >> 5;
 
 	    /* if (bitstream_get (1)) val = -val; */
-	    val = (val ^ SBITS (bit_buf, 1)) - SBITS (bit_buf, 1);
+	    val = (val ^ SBITS64 (bit_buf, 1)) - SBITS64 (bit_buf, 1);
 
 	    SATURATE (val);
 	    dest[j] = val;
 	    mismatch ^= val;
 
 	    bit_buf <<= 1;
-	    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
 
 	    continue;
 
 	}
 
     entry_2:
-	if (bit_buf >= 0x04000000) {
+	if (top >= 0x04000000) {
 
-	    tab = DCT_B14_8 + (UBITS (bit_buf, 8) - 4);
+	    tab = DCT_B14_8 + (UBITS (top, 8) - 4);
 
 	    i += tab->run;
 	    if (i < 64)
@@ -644,7 +782,7 @@ static int get_non_intra_block (mpeg2_decoder_t * const decoder,
 
 	    /* escape code */
 
-	    i += UBITS (bit_buf << 6, 6) - 64;
+	    i += UBITS (top << 6, 6) - 64;
 	    if (i >= 64) {
 	      //	      throw MPEGInvalid();
 	      //	      fprintf( stderr, "Suspected invalid block.\n" );
@@ -654,40 +792,37 @@ static int get_non_intra_block (mpeg2_decoder_t * const decoder,
 
 	    j = scan[i];
 
-	    DUMPBITS (bit_buf, bits, 12);
-	    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
-	    val = 2 * (SBITS (bit_buf, 12) + SBITS (bit_buf, 1)) + 1;
+	    DUMPBITS64 (bit_buf, avail, 12);
+	    val = 2 * (SBITS64 (bit_buf, 12) + SBITS64 (bit_buf, 1)) + 1;
 	    val = (val * quant_matrix[j]) / 32;
 
 	    SATURATE (val);
 	    dest[j] = val;
 	    mismatch ^= val;
 
-	    DUMPBITS (bit_buf, bits, 12);
-	    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
+	    DUMPBITS64 (bit_buf, avail, 12);
 
 	    continue;
 
-	} else if (bit_buf >= 0x02000000) {
-	    tab = DCT_B14_10 + (UBITS (bit_buf, 10) - 8);
+	} else if (top >= 0x02000000) {
+	    tab = DCT_B14_10 + (UBITS (top, 10) - 8);
 	    i += tab->run;
 	    if (i < 64)
 		goto normal_code;
-	} else if (bit_buf >= 0x00800000) {
-	    tab = DCT_13 + (UBITS (bit_buf, 13) - 16);
+	} else if (top >= 0x00800000) {
+	    tab = DCT_13 + (UBITS (top, 13) - 16);
 	    i += tab->run;
 	    if (i < 64)
 		goto normal_code;
-	} else if (bit_buf >= 0x00200000) {
-	    tab = DCT_15 + (UBITS (bit_buf, 15) - 16);
+	} else if (top >= 0x00200000) {
+	    tab = DCT_15 + (UBITS (top, 15) - 16);
 	    i += tab->run;
 	    if (i < 64)
 		goto normal_code;
 	} else {
-	    tab = DCT_16 + UBITS (bit_buf, 16);
+	    tab = DCT_16 + UBITS (top, 16);
 
-	    DUMPBITS(bit_buf, bits, 16 );
-	    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end );
+	    DUMPBITS64 (bit_buf, avail, 16);
 	    i += tab->run;
 	    if (i < 64)
 		goto normal_code;
@@ -697,310 +832,271 @@ static int get_non_intra_block (mpeg2_decoder_t * const decoder,
 	//	throw MPEGInvalid();
 	break;	/* illegal, check needed to avoid buffer overflow */
     }
+    DUMPBITS64 (bit_buf, avail, tab->len);	/* dump end of block code */
+ end_of_block:
     dest[63] ^= mismatch & 16;
-    DUMPBITS (bit_buf, bits, tab->len);	/* dump end of block code */
-    decoder->bitstream_buf = bit_buf;
-    decoder->bitstream_bits = bits;
-    decoder->bitstream_ptr = bit_ptr;
+    BITSTREAM_PUT64 (decoder, bit_buf, avail, bit_ptr);
     return i;
 }
 
-static void get_mpeg1_intra_block (mpeg2_decoder_t * const decoder)
+#ifdef MPEG2_CAPTURE
+/* Out-of-line entry points to the block parsers, for kernelbench */
+void mpeg2_get_intra_block_B14 (mpeg2_decoder_t * const decoder,
+				int16_t * const dest,
+				const uint16_t * const quant_matrix)
 {
-    int i;
-    int j;
-    int val;
-    const uint8_t * const scan = decoder->scan;
-    const uint16_t * const quant_matrix = decoder->quantizer_matrix[0];
-    const DCTtab * tab;
-    uint32_t bit_buf;
-    int bits;
-    const uint8_t * bit_ptr;
-    int16_t * const dest = decoder->DCTblock;
+    get_intra_block_B14 (decoder, dest, quant_matrix);
+}
 
-    i = 0;
+void mpeg2_get_intra_block_B15 (mpeg2_decoder_t * const decoder,
+				int16_t * const dest,
+				const uint16_t * const quant_matrix)
+{
+    get_intra_block_B15 (decoder, dest, quant_matrix);
+}
 
-    bit_buf = decoder->bitstream_buf;
-    bits = decoder->bitstream_bits;
-    bit_ptr = decoder->bitstream_ptr;
+int mpeg2_get_non_intra_block (mpeg2_decoder_t * const decoder,
+			       int16_t * const dest,
+			       const uint16_t * const quant_matrix)
+{
+    return get_non_intra_block (decoder, dest, quant_matrix);
+}
+#endif
 
+template <bool INTRA_VLC_FORMAT>
+static inline void slice_intra_block (mpeg2_decoder_t * const decoder,
+				      const int cc, int16_t * const block)
+{
+#define bit_buf (decoder->bitstream_buf)
+#define bits (decoder->bitstream_bits)
+#define bit_ptr (decoder->bitstream_ptr)
     NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
+    /* Get the intra DC coefficient and inverse quantize it */
+    if (cc == 0)
+	block[0] =
+	    decoder->dc_dct_pred[0] += get_luma_dc_dct_diff (decoder);
+    else
+	block[0] =
+	    decoder->dc_dct_pred[cc] += get_chroma_dc_dct_diff (decoder);
 
-    while (1) {
-	if (bit_buf >= 0x28000000) {
-
-	    tab = DCT_B14AC_5 + (UBITS (bit_buf, 5) - 5);
-
-	    i += tab->run;
-	    if (i >= 64)
-		break;	/* end of block */
-
-	normal_code:
-	    j = scan[i];
-	    bit_buf <<= tab->len;
-	    bits += tab->len + 1;
-	    val = (tab->level * quant_matrix[j]) >> 4;
-
-	    /* oddification */
-	    val = (val - 1) | 1;
-
-	    /* if (bitstream_get (1)) val = -val; */
-	    val = (val ^ SBITS (bit_buf, 1)) - SBITS (bit_buf, 1);
-
-	    SATURATE (val);
-	    dest[j] = val;
-
-	    bit_buf <<= 1;
-	    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
-
-	    continue;
-
-	} else if (bit_buf >= 0x04000000) {
-
-	    tab = DCT_B14_8 + (UBITS (bit_buf, 8) - 4);
-
-	    i += tab->run;
-	    if (i < 64)
-		goto normal_code;
-
-	    /* escape code */
-
-	    i += UBITS (bit_buf << 6, 6) - 64;
-	    if (i >= 64) {
-	      throw MPEGInvalid();
-	      break;	/* illegal, check needed to avoid buffer overflow */
-	    }
-
-	    j = scan[i];
-
-	    DUMPBITS (bit_buf, bits, 12);
-	    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
-	    val = SBITS (bit_buf, 8);
-	    if (! (val & 0x7f)) {
-		DUMPBITS (bit_buf, bits, 8);
-		val = UBITS (bit_buf, 8) + 2 * val;
-	    }
-	    val = (val * quant_matrix[j]) / 16;
-
-	    /* oddification */
-	    val = (val + ~SBITS (val, 1)) | 1;
-
-	    SATURATE (val);
-	    dest[j] = val;
-
-	    DUMPBITS (bit_buf, bits, 8);
-	    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
-
-	    continue;
-
-	} else if (bit_buf >= 0x02000000) {
-	    tab = DCT_B14_10 + (UBITS (bit_buf, 10) - 8);
-	    i += tab->run;
-	    if (i < 64)
-		goto normal_code;
-	} else if (bit_buf >= 0x00800000) {
-	    tab = DCT_13 + (UBITS (bit_buf, 13) - 16);
-	    i += tab->run;
-	    if (i < 64)
-		goto normal_code;
-	} else if (bit_buf >= 0x00200000) {
-	    tab = DCT_15 + (UBITS (bit_buf, 15) - 16);
-	    i += tab->run;
-	    if (i < 64)
-		goto normal_code;
-	} else {
-	    tab = DCT_16 + UBITS (bit_buf, 16);
-
-	    DUMPBITS(bit_buf, bits, 16 );
-	    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end );
-
-	    i += tab->run;
-	    if (i < 64)
-		goto normal_code;
-	}
-	throw MPEGInvalid();
-	break;	/* illegal, check needed to avoid buffer overflow */
+    if (INTRA_VLC_FORMAT) {
+	CAPTURE_BLOCK (decoder, MPEG2_BLOCK_INTRA_B15, block,
+		       decoder->quantizer_matrix[cc ? 2 : 0]);
+	get_intra_block_B15 (decoder, block,
+			     decoder->quantizer_matrix[cc ? 2 : 0]);
+    } else {
+	CAPTURE_BLOCK (decoder, MPEG2_BLOCK_INTRA_B14, block,
+		       decoder->quantizer_matrix[cc ? 2 : 0]);
+	get_intra_block_B14 (decoder, block,
+			     decoder->quantizer_matrix[cc ? 2 : 0]);
     }
-    DUMPBITS (bit_buf, bits, tab->len);	/* dump end of block code */
-    decoder->bitstream_buf = bit_buf;
-    decoder->bitstream_bits = bits;
-    decoder->bitstream_ptr = bit_ptr;
+#undef bit_buf
+#undef bits
+#undef bit_ptr
 }
 
-static int get_mpeg1_non_intra_block (mpeg2_decoder_t * const decoder)
+/* DC-only preview: a block's mean is its DC coefficient, so its
+ * 1/8-scale pixel is (DC + 64) >> 7 and the IDCT can be skipped. The
+ * coefficients must still all be parsed to find the next block. */
+template <bool INTRA_VLC_FORMAT>
+static inline int slice_dc_only_block (mpeg2_decoder_t * const decoder,
+				       const int cc)
 {
-    int i;
-    int j;
     int val;
-    const uint8_t * const scan = decoder->scan;
-    const uint16_t * const quant_matrix = decoder->quantizer_matrix[1];
-    const DCTtab * tab;
-    uint32_t bit_buf;
-    int bits;
-    const uint8_t * bit_ptr;
-    int16_t * const dest = decoder->DCTblock;
 
-    i = -1;
-
-    bit_buf = decoder->bitstream_buf;
-    bits = decoder->bitstream_bits;
-    bit_ptr = decoder->bitstream_ptr;
+    slice_intra_block<INTRA_VLC_FORMAT> (decoder, cc, decoder->DCTblock);
+    val = (decoder->DCTblock[0] + 64) >> 7;
+    memset (decoder->DCTblock, 0, sizeof (decoder->DCTblock));
 
-    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
-    if (bit_buf >= 0x28000000) {
-	tab = DCT_B14DC_5 + (UBITS (bit_buf, 5) - 5);
-	goto entry_1;
-    } else
-	goto entry_2;
-
-    while (1) {
-	if (bit_buf >= 0x28000000) {
-
-	    tab = DCT_B14AC_5 + (UBITS (bit_buf, 5) - 5);
-
-	entry_1:
-	    i += tab->run;
-	    if (i >= 64)
-		break;	/* end of block */
-
-	normal_code:
-	    j = scan[i];
-	    bit_buf <<= tab->len;
-	    bits += tab->len + 1;
-	    val = ((2 * tab->level + 1) * quant_matrix[j]) >> 5;
-
-	    /* oddification */
-	    val = (val - 1) | 1;
-
-	    /* if (bitstream_get (1)) val = -val; */
-	    val = (val ^ SBITS (bit_buf, 1)) - SBITS (bit_buf, 1);
-
-	    SATURATE (val);
-	    dest[j] = val;
-
-	    bit_buf <<= 1;
-	    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
-
-	    continue;
-
-	}
-
-    entry_2:
-	if (bit_buf >= 0x04000000) {
-
-	    tab = DCT_B14_8 + (UBITS (bit_buf, 8) - 4);
-
-	    i += tab->run;
-	    if (i < 64)
-		goto normal_code;
-
-	    /* escape code */
-
-	    i += UBITS (bit_buf << 6, 6) - 64;
-	    if (i >= 64) {
-	      throw MPEGInvalid();
-	      break;	/* illegal, check needed to avoid buffer overflow */
-	    }
+    return (val < 0) ? 0 : ((val > 255) ? 255 : val);
+}
 
-	    j = scan[i];
+/* An intra macroblock of a DC-only picture (4:2:0 only), whose planes
+ * at picture_dest are 1/8 scale, with strides stride and uv_stride. Its
+ * pixels are found from the macroblock position; the full-size dest
+ * pointers are never formed. Each field block of a field DCT spans the
+ * macroblock's height, so the top and bottom field values are averaged
+ * into both rows. */
+template <bool INTRA_VLC_FORMAT>
+static void slice_dc_only (mpeg2_decoder_t * const decoder,
+			   const bool field_dct)
+{
+    const int stride = decoder->stride;
+    uint8_t * const y = decoder->picture_dest[0] +
+	(decoder->v_offset >> 3) * stride + (decoder->offset >> 3);
+    const int uv = (decoder->v_offset >> 4) * decoder->uv_stride +
+	(decoder->offset >> 4);
+    int luma[4];
+    int i;
 
-	    DUMPBITS (bit_buf, bits, 12);
-	    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
-	    val = SBITS (bit_buf, 8);
-	    if (! (val & 0x7f)) {
-		DUMPBITS (bit_buf, bits, 8);
-		val = UBITS (bit_buf, 8) + 2 * val;
-	    }
-	    val = 2 * (val + SBITS (val, 1)) + 1;
-	    val = (val * quant_matrix[j]) / 32;
+    for (i = 0; i < 4; i++)
+	luma[i] = slice_dc_only_block<INTRA_VLC_FORMAT> (decoder, 0);
 
-	    /* oddification */
-	    val = (val + ~SBITS (val, 1)) | 1;
+    if (field_dct) {
+	y[0] = y[stride] = (luma[0] + luma[2] + 1) >> 1;
+	y[1] = y[stride + 1] = (luma[1] + luma[3] + 1) >> 1;
+    } else {
+	y[0] = luma[0];
+	y[1] = luma[1];
+	y[stride] = luma[2];
+	y[stride + 1] = luma[3];
+    }
 
-	    SATURATE (val);
-	    dest[j] = val;
+    decoder->picture_dest[1][uv] =
+	slice_dc_only_block<INTRA_VLC_FORMAT> (decoder, 1);
+    decoder->picture_dest[2][uv] =
+	slice_dc_only_block<INTRA_VLC_FORMAT> (decoder, 2);
+}
 
-	    DUMPBITS (bit_buf, bits, 8);
-	    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
+template <bool INTRA_VLC_FORMAT, bool REDUCED>
+static inline void slice_intra_DCT (mpeg2_decoder_t * const decoder,
+				    const int cc,
+				    uint8_t * const dest, const int stride)
+{
+    slice_intra_block<INTRA_VLC_FORMAT> (decoder, cc, decoder->DCTblock);
+    if (REDUCED && decoder->lowres)
+	mpeg2_idct_copy_lowres (decoder->DCTblock, dest, stride,
+				decoder->lowres);
+    else
+	decoder->idct_copy (decoder->DCTblock, dest, stride);
+}
 
-	    continue;
+/* The left and right luma blocks of a macroblock, transformed together */
+template <bool INTRA_VLC_FORMAT>
+static inline void slice_intra_DCT_pair (mpeg2_decoder_t * const decoder,
+					 uint8_t * const dest,
+					 const int stride)
+{
+    slice_intra_block<INTRA_VLC_FORMAT> (decoder, 0, decoder->DCTblock);
+    slice_intra_block<INTRA_VLC_FORMAT> (decoder, 0, decoder->DCTblock + 64);
+    decoder->idct_copy2 (decoder->DCTblock, dest, stride);
+}
 
-	} else if (bit_buf >= 0x02000000) {
-	    tab = DCT_B14_10 + (UBITS (bit_buf, 10) - 8);
-	    i += tab->run;
-	    if (i < 64)
-		goto normal_code;
-	} else if (bit_buf >= 0x00800000) {
-	    tab = DCT_13 + (UBITS (bit_buf, 13) - 16);
-	    i += tab->run;
-	    if (i < 64)
-		goto normal_code;
-	} else if (bit_buf >= 0x00200000) {
-	    tab = DCT_15 + (UBITS (bit_buf, 15) - 16);
-	    i += tab->run;
-	    if (i < 64)
-		goto normal_code;
-	} else {
-	    tab = DCT_16 + UBITS (bit_buf, 16);
+/* An intra macroblock, reconstructed at full size or, if REDUCED, at
+ * lowres */
+template <bool INTRA_VLC_FORMAT, bool REDUCED>
+static inline void slice_intra_macroblock (mpeg2_decoder_t * const decoder,
+					   const int macroblock_modes)
+{
+    const int lowres = REDUCED ? decoder->lowres : 0;
+    int DCT_offset, DCT_stride;
+    int offset;
+    uint8_t * dest_y;
 
-	    DUMPBITS(bit_buf, bits, 16 );
-	    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end );
+    if (macroblock_modes & DCT_TYPE_INTERLACED) {
+	DCT_offset = decoder->stride;
+	DCT_stride = decoder->stride * 2;
+    } else {
+	DCT_offset = decoder->stride * (8 >> lowres);
+	DCT_stride = decoder->stride;
+    }
 
-	    i += tab->run;
-	    if (i < 64)
-		goto normal_code;
-	}
-	throw MPEGInvalid();
-	break;	/* illegal, check needed to avoid buffer overflow */
+    /* lowres is only supported for 4:2:0 */
+    offset = decoder->offset >> lowres;
+    dest_y = decoder->dest[0] + offset;
+    if (!lowres) {
+	slice_intra_DCT_pair<INTRA_VLC_FORMAT> (decoder, dest_y,
+						DCT_stride);
+	slice_intra_DCT_pair<INTRA_VLC_FORMAT> (decoder,
+						dest_y + DCT_offset,
+						DCT_stride);
+    } else {
+	const int block = 8 >> lowres;
+	slice_intra_DCT<INTRA_VLC_FORMAT, REDUCED> (decoder, 0, dest_y,
+						    DCT_stride);
+	slice_intra_DCT<INTRA_VLC_FORMAT, REDUCED> (decoder, 0, dest_y + block,
+						    DCT_stride);
+	slice_intra_DCT<INTRA_VLC_FORMAT, REDUCED> (decoder, 0,
+						    dest_y + DCT_offset,
+						    DCT_stride);
+	slice_intra_DCT<INTRA_VLC_FORMAT, REDUCED> (decoder, 0,
+						    dest_y + DCT_offset +
+						    block,
+						    DCT_stride);
+    }
+    if (likely (decoder->chroma_format == 0)) {
+	slice_intra_DCT<INTRA_VLC_FORMAT, REDUCED> (decoder, 1,
+						    decoder->dest[1] +
+						    (offset >> 1),
+						    decoder->uv_stride);
+	slice_intra_DCT<INTRA_VLC_FORMAT, REDUCED> (decoder, 2,
+						    decoder->dest[2] +
+						    (offset >> 1),
+						    decoder->uv_stride);
+    } else if (likely (decoder->chroma_format == 1)) {
+	uint8_t * dest_u = decoder->dest[1] + (offset >> 1);
+	uint8_t * dest_v = decoder->dest[2] + (offset >> 1);
+	DCT_stride >>= 1;
+	DCT_offset >>= 1;
+	slice_intra_DCT<INTRA_VLC_FORMAT, REDUCED> (decoder, 1, dest_u,
+						    DCT_stride);
+	slice_intra_DCT<INTRA_VLC_FORMAT, REDUCED> (decoder, 2, dest_v,
+						    DCT_stride);
+	slice_intra_DCT<INTRA_VLC_FORMAT, REDUCED> (decoder, 1,
+						    dest_u + DCT_offset,
+						    DCT_stride);
+	slice_intra_DCT<INTRA_VLC_FORMAT, REDUCED> (decoder, 2,
+						    dest_v + DCT_offset,
+						    DCT_stride);
+    } else {
+	uint8_t * dest_u = decoder->dest[1] + offset;
+	uint8_t * dest_v = decoder->dest[2] + offset;
+	slice_intra_DCT<INTRA_VLC_FORMAT, REDUCED> (decoder, 1, dest_u,
+						    DCT_stride);
+	slice_intra_DCT<INTRA_VLC_FORMAT, REDUCED> (decoder, 2, dest_v,
+						    DCT_stride);
+	slice_intra_DCT<INTRA_VLC_FORMAT, REDUCED> (decoder, 1,
+						    dest_u + DCT_offset,
+						    DCT_stride);
+	slice_intra_DCT<INTRA_VLC_FORMAT, REDUCED> (decoder, 2,
+						    dest_v + DCT_offset,
+						    DCT_stride);
+	slice_intra_DCT<INTRA_VLC_FORMAT, REDUCED> (decoder, 1, dest_u + 8,
+						    DCT_stride);
+	slice_intra_DCT<INTRA_VLC_FORMAT, REDUCED> (decoder, 2, dest_v + 8,
+						    DCT_stride);
+	slice_intra_DCT<INTRA_VLC_FORMAT, REDUCED> (decoder, 1,
+						    dest_u + DCT_offset + 8,
+						    DCT_stride);
+	slice_intra_DCT<INTRA_VLC_FORMAT, REDUCED> (decoder, 2,
+						    dest_v + DCT_offset + 8,
+						    DCT_stride);
     }
-    DUMPBITS (bit_buf, bits, tab->len);	/* dump end of block code */
-    decoder->bitstream_buf = bit_buf;
-    decoder->bitstream_bits = bits;
-    decoder->bitstream_ptr = bit_ptr;
-    return i;
 }
 
-static inline void slice_intra_DCT (mpeg2_decoder_t * const decoder,
-				    const int cc,
-				    uint8_t * const dest, const int stride)
+static inline int slice_non_intra_block (mpeg2_decoder_t * const decoder,
+					 const int cc, int16_t * const block)
 {
-#define bit_buf (decoder->bitstream_buf)
-#define bits (decoder->bitstream_bits)
-#define bit_ptr (decoder->bitstream_ptr)
-    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
-    /* Get the intra DC coefficient and inverse quantize it */
-    if (cc == 0)
-	decoder->DCTblock[0] =
-	    decoder->dc_dct_pred[0] += get_luma_dc_dct_diff (decoder);
-    else
-	decoder->DCTblock[0] =
-	    decoder->dc_dct_pred[cc] += get_chroma_dc_dct_diff (decoder);
-
-    if (decoder->mpeg1) {
-	if (decoder->coding_type != D_TYPE)
-	    get_mpeg1_intra_block (decoder);
-    } else if (decoder->intra_vlc_format)
-	get_intra_block_B15 (decoder, decoder->quantizer_matrix[cc ? 2 : 0]);
-    else
-	get_intra_block_B14 (decoder, decoder->quantizer_matrix[cc ? 2 : 0]);
-    mpeg2_idct_copy (decoder->DCTblock, dest, stride);
-#undef bit_buf
-#undef bits
-#undef bit_ptr
+    CAPTURE_BLOCK (decoder, MPEG2_BLOCK_NON_INTRA, block,
+		   decoder->quantizer_matrix[cc ? 3 : 1]);
+    return get_non_intra_block (decoder, block,
+				decoder->quantizer_matrix[cc ? 3 : 1]);
 }
 
+template <bool REDUCED>
 static inline void slice_non_intra_DCT (mpeg2_decoder_t * const decoder,
 					const int cc,
 					uint8_t * const dest, const int stride)
 {
     int last;
 
-    if (decoder->mpeg1)
-	last = get_mpeg1_non_intra_block (decoder);
+    last = slice_non_intra_block (decoder, cc, decoder->DCTblock);
+    if (REDUCED && decoder->lowres)
+	mpeg2_idct_add_lowres (decoder->DCTblock, dest, stride,
+			       decoder->lowres);
     else
-	last = get_non_intra_block (decoder,
-				    decoder->quantizer_matrix[cc ? 3 : 1]);
-    mpeg2_idct_add (last, decoder->DCTblock, dest, stride);
+	decoder->idct_add (last, decoder->DCTblock, dest, stride);
+}
+
+static inline void slice_non_intra_DCT_pair (mpeg2_decoder_t * const decoder,
+					     uint8_t * const dest,
+					     const int stride)
+{
+    int last0, last1;
+
+    last0 = slice_non_intra_block (decoder, 0, decoder->DCTblock);
+    last1 = slice_non_intra_block (decoder, 0, decoder->DCTblock + 64);
+    decoder->idct_add2 (last0, last1, decoder->DCTblock, dest, stride);
 }
 
 #define MOTION_420(table1,ref,motion_x,motion_y,size,y)			      \
@@ -1106,6 +1202,109 @@ static inline void slice_non_intra_DCT (mpeg2_decoder_t * const decoder,
     table4[4] (decoder->dest[2] + (decoder->offset >> 1),		      \
 	      ref[2] + offset, decoder->uv_stride, 8)
 
+/* Reduced-resolution prediction of one macroblock (frame == 1) or of
+ * one field of it (frame == 0). pos_x and pos_y are the clipped luma
+ * position in full-size half-pels (field lines for field prediction);
+ * motion_x and motion_y the matching clipped vector. */
+static inline void motion_block_lowres (mpeg2_decoder_t * const decoder,
+					uint8_t * const * const ref,
+					const int avg, const int frame,
+					const unsigned int pos_x,
+					const unsigned int pos_y,
+					int motion_x, int motion_y,
+					const int dest_field,
+					const int src_field)
+{
+    const int lowres = decoder->lowres;
+    const unsigned int mask = (2 << lowres) - 1;
+    const int step = 2 - frame;
+    const int height = 8 << frame;
+    unsigned int pos_cx, pos_cy, line;
+
+    line = (pos_y >> (lowres + 1)) * step + src_field;
+    mpeg2_mc_lowres (decoder->dest[0] + dest_field * decoder->stride +
+		     (decoder->offset >> lowres),
+		     ref[0] + (pos_x >> (lowres + 1)) + line * decoder->stride,
+		     step * decoder->stride, 16 >> lowres, height >> lowres,
+		     pos_x & mask, pos_y & mask, lowres, avg);
+
+    motion_x /= 2;	motion_y /= 2;
+    pos_cx = decoder->offset + motion_x;
+    pos_cy = (frame ? decoder->v_offset : decoder->v_offset >> 1) + motion_y;
+    line = (pos_cy >> (lowres + 1)) * step + src_field;
+    mpeg2_mc_lowres (decoder->dest[1] + dest_field * decoder->uv_stride +
+		     (decoder->offset >> (lowres + 1)),
+		     ref[1] + (pos_cx >> (lowres + 1)) +
+		     line * decoder->uv_stride,
+		     step * decoder->uv_stride, 8 >> lowres, height >> (lowres + 1),
+		     pos_cx & mask, pos_cy & mask, lowres, avg);
+    mpeg2_mc_lowres (decoder->dest[2] + dest_field * decoder->uv_stride +
+		     (decoder->offset >> (lowres + 1)),
+		     ref[2] + (pos_cx >> (lowres + 1)) +
+		     line * decoder->uv_stride,
+		     step * decoder->uv_stride, 8 >> lowres, height >> (lowres + 1),
+		     pos_cx & mask, pos_cy & mask, lowres, avg);
+}
+
+/* The lowres macros take the same tables as the full-size ones, but only
+ * to tell put from avg. */
+#define LOWRES_AVG(table) ((table) == decoder->mc_avg)
+
+#define MOTION_LOWRES(table1,ref,motion_x,motion_y,size,y)		      \
+    pos_x = 2 * decoder->offset + motion_x;				      \
+    pos_y = 2 * decoder->v_offset + motion_y + 2 * y;			      \
+    if (unlikely (pos_x > decoder->limit_x)) {				      \
+	pos_x = ((int)pos_x < 0) ? 0 : decoder->limit_x;		      \
+	motion_x = pos_x - 2 * decoder->offset;				      \
+    }									      \
+    if (unlikely (pos_y > decoder->limit_y_ ## size)) {			      \
+	pos_y = ((int)pos_y < 0) ? 0 : decoder->limit_y_ ## size;	      \
+	motion_y = pos_y - 2 * decoder->v_offset - 2 * y;		      \
+    }									      \
+    (void) xy_half;	(void) offset;					      \
+    motion_block_lowres (decoder, ref, LOWRES_AVG (table1), 1,		      \
+			 pos_x, pos_y, motion_x, motion_y, 0, 0)
+
+/* (0 op) is the source field parity that op forces, as in MOTION_FIELD */
+#define MOTION_FIELD_LOWRES(table2,ref,motion_x,motion_y,dest_field,op,src_field) \
+    pos_x = 2 * decoder->offset + motion_x;				      \
+    pos_y = decoder->v_offset + motion_y;				      \
+    if (unlikely (pos_x > decoder->limit_x)) {				      \
+	pos_x = ((int)pos_x < 0) ? 0 : decoder->limit_x;		      \
+	motion_x = pos_x - 2 * decoder->offset;				      \
+    }									      \
+    if (unlikely (pos_y > decoder->limit_y)) {				      \
+	pos_y = ((int)pos_y < 0) ? 0 : decoder->limit_y;		      \
+	motion_y = pos_y - decoder->v_offset;				      \
+    }									      \
+    (void) xy_half;	(void) offset;					      \
+    motion_block_lowres (decoder, ref, LOWRES_AVG (table2), 0,		      \
+			 pos_x, pos_y, motion_x, motion_y,		      \
+			 dest_field, (0 op) + src_field)
+
+#define MOTION_DMV_LOWRES(table3,ref,motion_x,motion_y)			      \
+    pos_x = 2 * decoder->offset + motion_x;				      \
+    pos_y = decoder->v_offset + motion_y;				      \
+    if (unlikely (pos_x > decoder->limit_x)) {				      \
+	pos_x = ((int)pos_x < 0) ? 0 : decoder->limit_x;		      \
+	motion_x = pos_x - 2 * decoder->offset;				      \
+    }									      \
+    if (unlikely (pos_y > decoder->limit_y)) {				      \
+	pos_y = ((int)pos_y < 0) ? 0 : decoder->limit_y;		      \
+	motion_y = pos_y - decoder->v_offset;				      \
+    }									      \
+    (void) xy_half;	(void) offset;					      \
+    motion_block_lowres (decoder, ref, LOWRES_AVG (table3), 0,		      \
+			 pos_x, pos_y, motion_x, motion_y, 0, 0);	      \
+    motion_block_lowres (decoder, ref, LOWRES_AVG (table3), 0,		      \
+			 pos_x, pos_y, motion_x, motion_y, 1, 1)
+
+#define MOTION_ZERO_LOWRES(table4,ref)					      \
+    (void) offset;							      \
+    motion_block_lowres (decoder, ref, LOWRES_AVG (table4), 1,		      \
+			 2 * decoder->offset, 2 * decoder->v_offset,	      \
+			 0, 0, 0, 0)
+
 #define bit_buf (decoder->bitstream_buf)
 #define bits (decoder->bitstream_bits)
 #define bit_ptr (decoder->bitstream_ptr)
@@ -1153,7 +1352,7 @@ static void motion_fr_field_##FORMAT (mpeg2_decoder_t * const decoder,	      \
     NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);					      \
     motion_y = ((motion->pmv[0][1] >> 1) +				      \
 		get_motion_delta (decoder, motion->f_code[1]));		      \
-    /* motion_y = bound_motion_vector (motion_y, motion->f_code[1]); */	      \
+    motion_y = bound_motion_vector (motion_y, motion->f_code[1]);	      \
     motion->pmv[0][1] = motion_y << 1;					      \
 									      \
     MOTION_FIELD (table6, motion->ref[0], motion_x, motion_y, 0, & ~1, field); \
@@ -1170,7 +1369,7 @@ static void motion_fr_field_##FORMAT (mpeg2_decoder_t * const decoder,	      \
     NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);					      \
     motion_y = ((motion->pmv[1][1] >> 1) +				      \
 		get_motion_delta (decoder, motion->f_code[1]));		      \
-    /* motion_y = bound_motion_vector (motion_y, motion->f_code[1]); */	      \
+    motion_y = bound_motion_vector (motion_y, motion->f_code[1]);	      \
     motion->pmv[1][1] = motion_y << 1;					      \
 									      \
     MOTION_FIELD (table6, motion->ref[0], motion_x, motion_y, 1, & ~1, field); \
@@ -1193,21 +1392,23 @@ static void motion_fr_dmv_##FORMAT (mpeg2_decoder_t * const decoder,	      \
 									      \
     motion_y = ((motion->pmv[0][1] >> 1) +				      \
 		get_motion_delta (decoder, motion->f_code[1]));		      \
-    /* motion_y = bound_motion_vector (motion_y, motion->f_code[1]); */	      \
+    motion_y = bound_motion_vector (motion_y, motion->f_code[1]);	      \
     motion->pmv[1][1] = motion->pmv[0][1] = motion_y << 1;		      \
     dmv_y = get_dmv (decoder);						      \
 									      \
     m = decoder->top_field_first ? 1 : 3;				      \
     other_x = ((motion_x * m + (motion_x > 0)) >> 1) + dmv_x;		      \
     other_y = ((motion_y * m + (motion_y > 0)) >> 1) + dmv_y - 1;	      \
-    MOTION_FIELD (mpeg2_mc.put, motion->ref[0], other_x, other_y, 0, | 1, 0); \
+    MOTION_FIELD (decoder->mc_put, motion->ref[0],			      \
+		  other_x, other_y, 0, | 1, 0);				      \
 									      \
     m = decoder->top_field_first ? 3 : 1;				      \
     other_x = ((motion_x * m + (motion_x > 0)) >> 1) + dmv_x;		      \
     other_y = ((motion_y * m + (motion_y > 0)) >> 1) + dmv_y + 1;	      \
-    MOTION_FIELD (mpeg2_mc.put, motion->ref[0], other_x, other_y, 1, & ~1, 0);\
+    MOTION_FIELD (decoder->mc_put, motion->ref[0],			      \
+		  other_x, other_y, 1, & ~1, 0);			      \
 									      \
-    MOTION_DMV (mpeg2_mc.avg, motion->ref[0], motion_x, motion_y);	      \
+    MOTION_DMV (decoder->mc_avg, motion->ref[0], motion_x, motion_y);	      \
 }									      \
 									      \
 static void motion_reuse_##FORMAT (mpeg2_decoder_t * const decoder,	      \
@@ -1242,6 +1443,12 @@ MOTION_FUNCTIONS (420,
 		  MOTION_DMV_420,
 		  MOTION_ZERO_420)
 
+MOTION_FUNCTIONS (lowres,
+		  MOTION_LOWRES,
+		  MOTION_FIELD_LOWRES,
+		  MOTION_DMV_LOWRES,
+		  MOTION_ZERO_LOWRES)
+
 /* like motion_frame, but parsing without actual motion compensation */
 static void motion_fr_conceal (mpeg2_decoder_t * const decoder)
 {
@@ -1262,27 +1469,6 @@ static void motion_fr_conceal (mpeg2_decoder_t * const decoder)
     DUMPBITS (bit_buf, bits, 1); /* remove marker_bit */
 }
 
-static void motion_fi_conceal (mpeg2_decoder_t * const decoder)
-{
-    int tmp;
-
-    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
-    DUMPBITS (bit_buf, bits, 1); /* remove field_select */
-
-    tmp = (decoder->f_motion.pmv[0][0] +
-	   get_motion_delta (decoder, decoder->f_motion.f_code[0]));
-    tmp = bound_motion_vector (tmp, decoder->f_motion.f_code[0]);
-    decoder->f_motion.pmv[1][0] = decoder->f_motion.pmv[0][0] = tmp;
-
-    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
-    tmp = (decoder->f_motion.pmv[0][1] +
-	   get_motion_delta (decoder, decoder->f_motion.f_code[1]));
-    tmp = bound_motion_vector (tmp, decoder->f_motion.f_code[1]);
-    decoder->f_motion.pmv[1][1] = decoder->f_motion.pmv[0][1] = tmp;
-
-    DUMPBITS (bit_buf, bits, 1); /* remove marker_bit */
-}
-
 #undef bit_buf
 #undef bits
 #undef bit_ptr
@@ -1290,11 +1476,12 @@ static void motion_fi_conceal (mpeg2_decoder_t * const decoder)
 #define MOTION_CALL(routine,direction)				\
 do {								\
     if ((direction) & MACROBLOCK_MOTION_FORWARD)		\
-	routine (decoder, &(decoder->f_motion), mpeg2_mc.put);	\
+	routine (decoder, &(decoder->f_motion),			\
+		 decoder->mc_put);				\
     if ((direction) & MACROBLOCK_MOTION_BACKWARD)		\
 	routine (decoder, &(decoder->b_motion),			\
 		 ((direction) & MACROBLOCK_MOTION_FORWARD ?	\
-		  mpeg2_mc.avg : mpeg2_mc.put));		\
+		  decoder->mc_avg : decoder->mc_put));		\
 } while (0)
 
 #define NEXT_MACROBLOCK							\
@@ -1305,7 +1492,7 @@ do {									\
 	    if (decoder->convert) {					\
 		decoder->convert (decoder->convert_id, decoder->dest,	\
 				  decoder->v_offset);			\
-		if (decoder->coding_type == B_TYPE)			\
+		if (CODING_TYPE == B_TYPE)				\
 		    break;						\
 	    }								\
 	    decoder->dest[0] += decoder->slice_stride;			\
@@ -1314,7 +1501,7 @@ do {									\
 	} while (0);							\
 	decoder->v_offset += 16;					\
 	if (decoder->v_offset > decoder->limit_y) {			\
-	    emms();                                                     \
+	    mpeg2_emms ();						\
 	    return;							\
 	}								\
 	decoder->offset = 0;						\
@@ -1323,6 +1510,15 @@ do {									\
 
 void Picture::motion_setup( mpeg2_decoder_t *d )
 {
+  if ( d->lowres ) {
+    d->motion_parser[0] = motion_zero_lowres;
+    d->motion_parser[MC_FIELD] = motion_fr_field_lowres;
+    d->motion_parser[MC_FRAME] = motion_fr_frame_lowres;
+    d->motion_parser[MC_DMV] = motion_fr_dmv_lowres;
+    d->motion_parser[4] = motion_reuse_lowres;
+    return;
+  }
+
   d->motion_parser[0] = motion_zero_420;
   d->motion_parser[MC_FIELD] = motion_fr_field_420;
   d->motion_parser[MC_FRAME] = motion_fr_frame_420;
@@ -1415,13 +1611,21 @@ static inline int slice_init (mpeg2_decoder_t * const decoder, int code)
 #undef bit_ptr
 }
 
-void Slice::decode (mpeg2_decoder_t * const decoder, const int code,
-		    const uint8_t * const buffer)
+/* One instantiation per combination of the picture-wide flags that the
+ * macroblock loop looks at, so it tests none of them per macroblock.
+ * Picture::slice_setup () picks the instantiation for each picture.
+ * REDUCED pictures (lowres or dc_only) get their own instantiations, so
+ * the full-size ones carry no test of either. */
+template <int CODING_TYPE, bool FRAME_PRED_FRAME_DCT, bool INTRA_VLC_FORMAT,
+	  bool CONCEALMENT_MOTION_VECTORS, bool REDUCED>
+static void slice_decode (mpeg2_decoder_t * const decoder, const int code,
+			  const uint8_t * const buffer)
 {
 #define bit_buf (decoder->bitstream_buf)
 #define bits (decoder->bitstream_bits)
 #define bit_ptr (decoder->bitstream_ptr)
 
+    CAPTURE_SLICE (decoder);
     bitstream_init (decoder, buffer);
 
     if (slice_init (decoder, code))
@@ -1434,23 +1638,17 @@ void Slice::decode (mpeg2_decoder_t * const decoder, const int code,
 
 	NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
 
-	macroblock_modes = get_macroblock_modes (decoder);
+	macroblock_modes =
+	    get_macroblock_modes<CODING_TYPE, FRAME_PRED_FRAME_DCT> (decoder);
 
 	/* maybe integrate MACROBLOCK_QUANT test into get_macroblock_modes ? */
 	if (macroblock_modes & MACROBLOCK_QUANT)
 	    get_quantizer_scale (decoder);
 
-	if (macroblock_modes & MACROBLOCK_INTRA) {
+	if (CODING_TYPE == I_TYPE || (macroblock_modes & MACROBLOCK_INTRA)) {
 
-	    int DCT_offset, DCT_stride;
-	    int offset;
-	    uint8_t * dest_y;
-
-	    if (decoder->concealment_motion_vectors) {
-		if (decoder->picture_structure == FRAME_PICTURE)
-		    motion_fr_conceal (decoder);
-		else
-		    motion_fi_conceal (decoder);
+	    if (CONCEALMENT_MOTION_VECTORS) {
+		motion_fr_conceal (decoder);
 	    } else {
 		decoder->f_motion.pmv[0][0] = decoder->f_motion.pmv[0][1] = 0;
 		decoder->f_motion.pmv[1][0] = decoder->f_motion.pmv[1][1] = 0;
@@ -1458,52 +1656,13 @@ void Slice::decode (mpeg2_decoder_t * const decoder, const int code,
 		decoder->b_motion.pmv[1][0] = decoder->b_motion.pmv[1][1] = 0;
 	    }
 
-	    if (macroblock_modes & DCT_TYPE_INTERLACED) {
-		DCT_offset = decoder->stride;
-		DCT_stride = decoder->stride * 2;
-	    } else {
-		DCT_offset = decoder->stride * 8;
-		DCT_stride = decoder->stride;
-	    }
-
-	    offset = decoder->offset;
-	    dest_y = decoder->dest[0] + offset;
-	    slice_intra_DCT (decoder, 0, dest_y, DCT_stride);
-	    slice_intra_DCT (decoder, 0, dest_y + 8, DCT_stride);
-	    slice_intra_DCT (decoder, 0, dest_y + DCT_offset, DCT_stride);
-	    slice_intra_DCT (decoder, 0, dest_y + DCT_offset + 8, DCT_stride);
-	    if (likely (decoder->chroma_format == 0)) {
-		slice_intra_DCT (decoder, 1, decoder->dest[1] + (offset >> 1),
-				 decoder->uv_stride);
-		slice_intra_DCT (decoder, 2, decoder->dest[2] + (offset >> 1),
-				 decoder->uv_stride);
-		if (decoder->coding_type == D_TYPE) {
-		    NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
-		    DUMPBITS (bit_buf, bits, 1);
-		}
-	    } else if (likely (decoder->chroma_format == 1)) {
-		uint8_t * dest_u = decoder->dest[1] + (offset >> 1);
-		uint8_t * dest_v = decoder->dest[2] + (offset >> 1);
-		DCT_stride >>= 1;
-		DCT_offset >>= 1;
-		slice_intra_DCT (decoder, 1, dest_u, DCT_stride);
-		slice_intra_DCT (decoder, 2, dest_v, DCT_stride);
-		slice_intra_DCT (decoder, 1, dest_u + DCT_offset, DCT_stride);
-		slice_intra_DCT (decoder, 2, dest_v + DCT_offset, DCT_stride);
-	    } else {
-		uint8_t * dest_u = decoder->dest[1] + offset;
-		uint8_t * dest_v = decoder->dest[2] + offset;
-		slice_intra_DCT (decoder, 1, dest_u, DCT_stride);
-		slice_intra_DCT (decoder, 2, dest_v, DCT_stride);
-		slice_intra_DCT (decoder, 1, dest_u + DCT_offset, DCT_stride);
-		slice_intra_DCT (decoder, 2, dest_v + DCT_offset, DCT_stride);
-		slice_intra_DCT (decoder, 1, dest_u + 8, DCT_stride);
-		slice_intra_DCT (decoder, 2, dest_v + 8, DCT_stride);
-		slice_intra_DCT (decoder, 1, dest_u + DCT_offset + 8,
-				 DCT_stride);
-		slice_intra_DCT (decoder, 2, dest_v + DCT_offset + 8,
-				 DCT_stride);
-	    }
+	    if (REDUCED && decoder->dc_only)
+		slice_dc_only<INTRA_VLC_FORMAT> (decoder,
+						 macroblock_modes &
+						 DCT_TYPE_INTERLACED);
+	    else
+		slice_intra_macroblock<INTRA_VLC_FORMAT, REDUCED>
+		    (decoder, macroblock_modes);
 	} else {
 
 	    motion_parser_t * parser;
@@ -1522,6 +1681,7 @@ void Slice::decode (mpeg2_decoder_t * const decoder, const int code,
 	    MOTION_CALL (parser, macroblock_modes);
 
 	    if (macroblock_modes & MACROBLOCK_PATTERN) {
+		const int lowres = REDUCED ? decoder->lowres : 0;
 		int coded_block_pattern;
 		int DCT_offset, DCT_stride;
 
@@ -1529,35 +1689,51 @@ void Slice::decode (mpeg2_decoder_t * const decoder, const int code,
 		    DCT_offset = decoder->stride;
 		    DCT_stride = decoder->stride * 2;
 		} else {
-		    DCT_offset = decoder->stride * 8;
+		    DCT_offset = decoder->stride * (8 >> lowres);
 		    DCT_stride = decoder->stride;
 		}
 
 		coded_block_pattern = get_coded_block_pattern (decoder);
 
 		if (likely (decoder->chroma_format == 0)) {
-		    int offset = decoder->offset;
+		    const int block = 8 >> lowres;
+		    int offset = decoder->offset >> lowres;
 		    uint8_t * dest_y = decoder->dest[0] + offset;
-		    if (coded_block_pattern & 1)
-			slice_non_intra_DCT (decoder, 0, dest_y, DCT_stride);
-		    if (coded_block_pattern & 2)
-			slice_non_intra_DCT (decoder, 0, dest_y + 8,
-					     DCT_stride);
-		    if (coded_block_pattern & 4)
-			slice_non_intra_DCT (decoder, 0, dest_y + DCT_offset,
-					     DCT_stride);
-		    if (coded_block_pattern & 8)
-		        slice_non_intra_DCT (decoder, 0,
-			  		     dest_y + DCT_offset + 8,
-					     DCT_stride);
+		    if ((coded_block_pattern & 3) == 3 && !lowres)
+			slice_non_intra_DCT_pair (decoder, dest_y, DCT_stride);
+		    else {
+			if (coded_block_pattern & 1)
+			    slice_non_intra_DCT<REDUCED> (decoder, 0, dest_y,
+							  DCT_stride);
+			if (coded_block_pattern & 2)
+			    slice_non_intra_DCT<REDUCED> (decoder, 0,
+							  dest_y + block,
+							  DCT_stride);
+		    }
+		    if ((coded_block_pattern & 12) == 12 && !lowres)
+			slice_non_intra_DCT_pair (decoder, dest_y + DCT_offset,
+						  DCT_stride);
+		    else {
+			if (coded_block_pattern & 4)
+			    slice_non_intra_DCT<REDUCED> (decoder, 0,
+							  dest_y + DCT_offset,
+							  DCT_stride);
+			if (coded_block_pattern & 8)
+			    slice_non_intra_DCT<REDUCED> (decoder, 0,
+							  dest_y + DCT_offset +
+							  block,
+							  DCT_stride);
+		    }
 		    if (coded_block_pattern & 16)
-			slice_non_intra_DCT (decoder, 1,
-					     decoder->dest[1] + (offset >> 1),
-					     decoder->uv_stride);
+			slice_non_intra_DCT<REDUCED> (decoder, 1,
+						      decoder->dest[1] +
+						      (offset >> 1),
+						      decoder->uv_stride);
 		    if (coded_block_pattern & 32)
-			slice_non_intra_DCT (decoder, 2,
-					     decoder->dest[2] + (offset >> 1),
-					     decoder->uv_stride);
+			slice_non_intra_DCT<REDUCED> (decoder, 2,
+						      decoder->dest[2] +
+						      (offset >> 1),
+						      decoder->uv_stride);
 		} else if (likely (decoder->chroma_format == 1)) {
 		    int offset;
 		    uint8_t * dest_y;
@@ -1568,36 +1744,42 @@ void Slice::decode (mpeg2_decoder_t * const decoder, const int code,
 		    offset = decoder->offset;
 		    dest_y = decoder->dest[0] + offset;
 		    if (coded_block_pattern & 1)
-			slice_non_intra_DCT (decoder, 0, dest_y, DCT_stride);
+			slice_non_intra_DCT<REDUCED> (decoder, 0, dest_y,
+						      DCT_stride);
 		    if (coded_block_pattern & 2)
-			slice_non_intra_DCT (decoder, 0, dest_y + 8,
-					     DCT_stride);
+			slice_non_intra_DCT<REDUCED> (decoder, 0, dest_y + 8,
+						      DCT_stride);
 		    if (coded_block_pattern & 4)
-			slice_non_intra_DCT (decoder, 0, dest_y + DCT_offset,
-					     DCT_stride);
+			slice_non_intra_DCT<REDUCED> (decoder, 0,
+						      dest_y + DCT_offset,
+						      DCT_stride);
 		    if (coded_block_pattern & 8)
-			slice_non_intra_DCT (decoder, 0,
-					     dest_y + DCT_offset + 8,
-					     DCT_stride);
+			slice_non_intra_DCT<REDUCED> (decoder, 0,
+						      dest_y + DCT_offset + 8,
+						      DCT_stride);
 
 		    DCT_stride >>= 1;
 		    DCT_offset = (DCT_offset + offset) >> 1;
 		    if (coded_block_pattern & 16)
-			slice_non_intra_DCT (decoder, 1,
-					     decoder->dest[1] + (offset >> 1),
-					     DCT_stride);
+			slice_non_intra_DCT<REDUCED> (decoder, 1,
+						      decoder->dest[1] +
+						      (offset >> 1),
+						      DCT_stride);
 		    if (coded_block_pattern & 32)
-			slice_non_intra_DCT (decoder, 2,
-					     decoder->dest[2] + (offset >> 1),
-					     DCT_stride);
+			slice_non_intra_DCT<REDUCED> (decoder, 2,
+						      decoder->dest[2] +
+						      (offset >> 1),
+						      DCT_stride);
 		    if (coded_block_pattern & (2 << 30))
-			slice_non_intra_DCT (decoder, 1,
-					     decoder->dest[1] + DCT_offset,
-					     DCT_stride);
+			slice_non_intra_DCT<REDUCED> (decoder, 1,
+						      decoder->dest[1] +
+						      DCT_offset,
+						      DCT_stride);
 		    if (coded_block_pattern & (1 << 30))
-			slice_non_intra_DCT (decoder, 2,
-					     decoder->dest[2] + DCT_offset,
-					     DCT_stride);
+			slice_non_intra_DCT<REDUCED> (decoder, 2,
+						      decoder->dest[2] +
+						      DCT_offset,
+						      DCT_stride);
 		} else {
 		    int offset;
 		    uint8_t * dest_y, * dest_u, * dest_v;
@@ -1611,42 +1793,48 @@ void Slice::decode (mpeg2_decoder_t * const decoder, const int code,
 		    dest_v = decoder->dest[2] + offset;
 
 		    if (coded_block_pattern & 1)
-			slice_non_intra_DCT (decoder, 0, dest_y, DCT_stride);
+			slice_non_intra_DCT<REDUCED> (decoder, 0, dest_y,
+						      DCT_stride);
 		    if (coded_block_pattern & 2)
-			slice_non_intra_DCT (decoder, 0, dest_y + 8,
-					     DCT_stride);
+			slice_non_intra_DCT<REDUCED> (decoder, 0, dest_y + 8,
+						      DCT_stride);
 		    if (coded_block_pattern & 4)
-			slice_non_intra_DCT (decoder, 0, dest_y + DCT_offset,
-					     DCT_stride);
+			slice_non_intra_DCT<REDUCED> (decoder, 0,
+						      dest_y + DCT_offset,
+						      DCT_stride);
 		    if (coded_block_pattern & 8)
-			slice_non_intra_DCT (decoder, 0,
-					     dest_y + DCT_offset + 8,
-					     DCT_stride);
+			slice_non_intra_DCT<REDUCED> (decoder, 0,
+						      dest_y + DCT_offset + 8,
+						      DCT_stride);
 
 		    if (coded_block_pattern & 16)
-			slice_non_intra_DCT (decoder, 1, dest_u, DCT_stride);
+			slice_non_intra_DCT<REDUCED> (decoder, 1, dest_u,
+						      DCT_stride);
 		    if (coded_block_pattern & 32)
-			slice_non_intra_DCT (decoder, 2, dest_v, DCT_stride);
+			slice_non_intra_DCT<REDUCED> (decoder, 2, dest_v,
+						      DCT_stride);
 		    if (coded_block_pattern & (32 << 26))
-			slice_non_intra_DCT (decoder, 1, dest_u + DCT_offset,
-					     DCT_stride);
+			slice_non_intra_DCT<REDUCED> (decoder, 1,
+						      dest_u + DCT_offset,
+						      DCT_stride);
 		    if (coded_block_pattern & (16 << 26))
-			slice_non_intra_DCT (decoder, 2, dest_v + DCT_offset,
-					     DCT_stride);
+			slice_non_intra_DCT<REDUCED> (decoder, 2,
+						      dest_v + DCT_offset,
+						      DCT_stride);
 		    if (coded_block_pattern & (8 << 26))
-			slice_non_intra_DCT (decoder, 1, dest_u + 8,
-					     DCT_stride);
+			slice_non_intra_DCT<REDUCED> (decoder, 1, dest_u + 8,
+						      DCT_stride);
 		    if (coded_block_pattern & (4 << 26))
-			slice_non_intra_DCT (decoder, 2, dest_v + 8,
-					     DCT_stride);
+			slice_non_intra_DCT<REDUCED> (decoder, 2, dest_v + 8,
+						      DCT_stride);
 		    if (coded_block_pattern & (2 << 26))
-			slice_non_intra_DCT (decoder, 1,
-					     dest_u + DCT_offset + 8,
-					     DCT_stride);
+			slice_non_intra_DCT<REDUCED> (decoder, 1,
+						      dest_u + DCT_offset + 8,
+						      DCT_stride);
 		    if (coded_block_pattern & (1 << 26))
-			slice_non_intra_DCT (decoder, 2,
-					     dest_v + DCT_offset + 8,
-					     DCT_stride);
+			slice_non_intra_DCT<REDUCED> (decoder, 2,
+						      dest_v + DCT_offset + 8,
+						      DCT_stride);
 		}
 	    }
 
@@ -1668,13 +1856,13 @@ void Slice::decode (mpeg2_decoder_t * const decoder, const int code,
 	    } else switch (UBITS (bit_buf, 11)) {
 	    case 8:		/* macroblock_escape */
 		mba_inc += 33;
-		/* pass through */
+		/* fall through */
 	    case 15:	/* macroblock_stuffing (MPEG1 only) */
 		DUMPBITS (bit_buf, bits, 11);
 		NEEDBITS (bit_buf, bits, bit_ptr, decoder->bit_ptr_end);
 		continue;
 	    default:	/* end of slice, or error */
-	        emms();
+	        mpeg2_emms ();
 		return;
 	    }
 	}
@@ -1685,7 +1873,7 @@ void Slice::decode (mpeg2_decoder_t * const decoder, const int code,
 	    decoder->dc_dct_pred[0] = decoder->dc_dct_pred[1] =
 		decoder->dc_dct_pred[2] = 16384;
 
-	    if (decoder->coding_type == P_TYPE) {
+	    if (CODING_TYPE == P_TYPE) {
 		do {
 		    MOTION_CALL (decoder->motion_parser[0],
 				 MACROBLOCK_MOTION_FORWARD);
@@ -1702,5 +1890,68 @@ void Slice::decode (mpeg2_decoder_t * const decoder, const int code,
 #undef bit_buf
 #undef bits
 #undef bit_ptr
-    emms();
+    mpeg2_emms ();
+}
+
+#define SLICE_DECODE_ARGS mpeg2_decoder_t * const, const int, const uint8_t * const
+
+#define SLICE_DECODERS(TYPE,FRAME_PRED,REDUCED)			      \
+template void slice_decode<TYPE, FRAME_PRED, false, false, REDUCED>           \
+    (SLICE_DECODE_ARGS);                                                      \
+template void slice_decode<TYPE, FRAME_PRED, false, true, REDUCED>            \
+    (SLICE_DECODE_ARGS);                                                      \
+template void slice_decode<TYPE, FRAME_PRED, true, false, REDUCED>            \
+    (SLICE_DECODE_ARGS);                                                      \
+template void slice_decode<TYPE, FRAME_PRED, true, true, REDUCED>             \
+    (SLICE_DECODE_ARGS);
+
+SLICE_DECODERS (I_TYPE, false, false)
+SLICE_DECODERS (I_TYPE, true, false)
+SLICE_DECODERS (P_TYPE, false, false)
+SLICE_DECODERS (P_TYPE, true, false)
+SLICE_DECODERS (B_TYPE, false, false)
+SLICE_DECODERS (B_TYPE, true, false)
+SLICE_DECODERS (I_TYPE, false, true)
+SLICE_DECODERS (I_TYPE, true, true)
+SLICE_DECODERS (P_TYPE, false, true)
+SLICE_DECODERS (P_TYPE, true, true)
+SLICE_DECODERS (B_TYPE, false, true)
+SLICE_DECODERS (B_TYPE, true, true)
+
+#define SLICE_DECODER_TABLE(TYPE,FRAME_PRED,REDUCED)			\
+    {{slice_decode<TYPE, FRAME_PRED, false, false, REDUCED>,		\
+      slice_decode<TYPE, FRAME_PRED, false, true, REDUCED>},		\
+     {slice_decode<TYPE, FRAME_PRED, true, false, REDUCED>,		\
+      slice_decode<TYPE, FRAME_PRED, true, true, REDUCED>}}
+
+#define SLICE_DECODER_TYPES(REDUCED)					\
+    {{SLICE_DECODER_TABLE (I_TYPE, false, REDUCED),			\
+      SLICE_DECODER_TABLE (I_TYPE, true, REDUCED)},			\
+     {SLICE_DECODER_TABLE (P_TYPE, false, REDUCED),			\
+      SLICE_DECODER_TABLE (P_TYPE, true, REDUCED)},			\
+     {SLICE_DECODER_TABLE (B_TYPE, false, REDUCED),			\
+      SLICE_DECODER_TABLE (B_TYPE, true, REDUCED)}}
+
+/* indexed by lowres || dc_only, coding_type - 1, frame_pred_frame_dct,
+   intra_vlc_format and concealment_motion_vectors */
+static slice_decoder_t * const slice_decoders[2][3][2][2][2] = {
+    SLICE_DECODER_TYPES (false),
+    SLICE_DECODER_TYPES (true)
+};
+
+void Picture::slice_setup( mpeg2_decoder_t *d )
+{
+  ahabassert( (d->coding_type >= I_TYPE) && (d->coding_type <= B_TYPE) );
+
+  d->slice_decoder = slice_decoders[ (d->lowres || d->dc_only) ? 1 : 0 ]
+    [ d->coding_type - 1 ]
+    [ d->frame_pred_frame_dct ? 1 : 0 ]
+    [ d->intra_vlc_format ? 1 : 0 ]
+    [ d->concealment_motion_vectors ? 1 : 0 ];
+}
+
+void Slice::decode (mpeg2_decoder_t * const decoder, const int code,
+		    const uint8_t * const buffer)
+{
+    decoder->slice_decoder (decoder, code, buffer);
 }
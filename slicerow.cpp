@@ -19,20 +19,34 @@ SliceRow::~SliceRow()
   unixassert( pthread_mutex_destroy( &mutex ) );
 }
 
-void SliceRow::init( int f_code_fv, int f_code_bv,
+/* How many macroblock rows above and below a vector with this f_code
+   can reach. Field vectors count field lines, so they reach twice as
+   far in the frame, and a dual-prime vector (P pictures only) can be
+   scaled up by another half. */
+static int dependent_rows( int f_code, bool field_motion, bool dual_prime )
+{
+  int diff;
+
+  if ( field_motion ) {
+    diff = 1 << (f_code - 1);
+    if ( dual_prime ) diff <<= 1;
+  } else if ( f_code == 1 ) {
+    diff = 1;
+  } else {
+    diff = 1 << (f_code - 2);
+  }
+
+  return diff;
+}
+
+void SliceRow::init( int f_code_fv, int f_code_bv, bool field_motion,
 		     Picture *forward, Picture *backward )
 {
   forward_highest_dependent_row = forward_lowest_dependent_row = -1;
   backward_highest_dependent_row = backward_lowest_dependent_row = -1;
 
   if ( forward && (f_code_fv != 15) ) {
-    int diff;
-
-    if ( f_code_fv == 1 ) {
-      diff = 1;
-    } else {
-      diff = 1 << (f_code_fv - 2);
-    }
+    int diff = dependent_rows( f_code_fv, field_motion, backward == NULL );
 
     forward_highest_dependent_row = row - diff;
     if ( forward_highest_dependent_row < 0 ) forward_highest_dependent_row = 0;
@@ -42,13 +56,7 @@ void SliceRow::init( int f_code_fv, int f_code_bv,
   }
 
   if ( backward && (f_code_bv != 15) ) {
-    int diff;
-
-    if ( f_code_bv == 1 ) {
-      diff = 1;
-    } else {
-      diff = 1 << (f_code_bv - 2);
-    }
+    int diff = dependent_rows( f_code_bv, field_motion, false );
 
     backward_highest_dependent_row = row - diff;
     if ( backward_highest_dependent_row < 0 ) backward_highest_dependent_row = 0;
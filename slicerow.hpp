@@ -25,7 +25,8 @@ public:
   SliceRow( uint s_row, uint s_mb_height );
   ~SliceRow();
 
-  void init( int f_code_fv, int f_code_bv, Picture *forward, Picture *backward );
+  void init( int f_code_fv, int f_code_bv, bool field_motion,
+	     Picture *forward, Picture *backward );
 
   SliceRowState lock( void ) {
     MutexLock x( &mutex );
@@ -0,0 +1,409 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "spillcache.hpp"
+#include "framebuffer.hpp"
+#include "picture.hpp"
+#include "mutexobj.hpp"
+#include "exceptions.hpp"
+
+static const char spill_magic[ 8 ] = { 'a', 'h', 'a', 'b', 's', 'p', 'l', '2' };
+static const uint max_buffers = 8;
+
+struct SpillHeader
+{
+  char magic[ 8 ];
+  uint64_t slot_len, num_slots;
+  uint64_t frame_len, stride; /* layout of the frames in the slots */
+  uint64_t stamp; /* last use of any slot */
+};
+
+/* A slot is empty while its stamp is zero */
+struct SpillEntry
+{
+  uint64_t stream;
+  uint32_t display, lowres;
+  uint64_t stamp;
+};
+
+static size_t page_round( size_t len )
+{
+  size_t page = sysconf( _SC_PAGE_SIZE );
+  return (len + page - 1) & ~(page - 1);
+}
+
+static void *writer_thread( void *s_cache )
+{
+  ((SpillCache *)s_cache)->run_writer();
+  return NULL;
+}
+
+SpillCache::SpillCache( const char *filename, size_t budget, uint64_t s_stream,
+			uint s_lowres, uint s_num_pictures, size_t s_frame_len, uint s_stride )
+  : fd( -1 ), map( NULL ), map_len( 0 ), data_offset( 0 ), slot_len( 0 ),
+    frame_len( s_frame_len ), stride( s_stride ), header( NULL ), entries( NULL ),
+    stream( s_stream ), lowres( s_lowres ), num_pictures( s_num_pictures ),
+    writes( max_buffers + 1 ), idle( max_buffers ), buffers( 0 ), shutdown( NULL ),
+    found( 0 ), stored( 0 ), restored( 0 ), dropped( 0 ), failed( 0 )
+{
+  fd = open( filename, O_RDWR | O_CREAT, 0644 );
+  if ( fd < 0 ) {
+    throw UnixError( errno );
+  }
+
+  try {
+    setup( filename, budget );
+  } catch ( ... ) {
+    if ( map ) munmap( map, map_len );
+    close( fd );
+    throw;
+  }
+
+  slot_of = new int[ num_pictures ];
+  pending = new SpillWrite *[ num_pictures ];
+  for ( uint i = 0; i < num_pictures; i++ ) {
+    slot_of[ i ] = -1;
+    pending[ i ] = NULL;
+  }
+
+  reading = new uint[ header->num_slots ];
+  for ( uint s = 0; s < header->num_slots; s++ ) {
+    reading[ s ] = 0;
+  }
+
+  /* Pick up what earlier sessions spilled from this stream */
+  for ( uint s = 0; s < header->num_slots; s++ ) {
+    SpillEntry *e = &entries[ s ];
+    if ( e->stamp && (e->stream == stream) && (e->lowres == lowres)
+	 && (e->display < num_pictures) ) {
+      slot_of[ e->display ] = s;
+      found++;
+    }
+  }
+
+  unixassert( pthread_mutex_init( &mutex, NULL ) );
+  unixassert( pthread_create( &writer, NULL, writer_thread, this ) );
+}
+
+/* Opens the file as it is if its frames are laid out as ours and its
+   size matches the budget, and starts it over empty otherwise */
+void SpillCache::setup( const char *filename, size_t budget )
+{
+  if ( flock( fd, LOCK_EX | LOCK_NB ) < 0 ) {
+    fprintf( stderr, "%s: in use by another process.\n", filename );
+    throw UnixError( errno );
+  }
+
+  struct stat thestat;
+  if ( fstat( fd, &thestat ) < 0 ) {
+    throw UnixError( errno );
+  }
+
+  SpillHeader existing;
+  bool valid = (thestat.st_size >= (off_t)sizeof( existing ))
+    && (pread( fd, &existing, sizeof( existing ), 0 ) == sizeof( existing ))
+    && (memcmp( existing.magic, spill_magic, sizeof( spill_magic ) ) == 0)
+    && (existing.frame_len == frame_len) && (existing.stride == stride)
+    && (existing.slot_len >= frame_len);
+
+  slot_len = valid ? existing.slot_len : page_round( frame_len );
+  uint64_t num_slots = budget / slot_len;
+  if ( num_slots == 0 ) {
+    fprintf( stderr, "%s: budget too small for one frame.\n", filename );
+    throw UnixError( EINVAL );
+  }
+
+  data_offset = page_round( sizeof( SpillHeader ) + num_slots * sizeof( SpillEntry ) );
+  map_len = data_offset + num_slots * slot_len;
+
+  valid = valid && (existing.num_slots == num_slots) && (thestat.st_size == (off_t)map_len);
+
+  if ( !valid ) {
+    /* Sparse: slots take disk space as they are written */
+    if ( (ftruncate( fd, 0 ) < 0) || (ftruncate( fd, map_len ) < 0) ) {
+      throw UnixError( errno );
+    }
+  }
+
+  /* The index is written through the mapping, so give it real blocks
+     now rather than SIGBUS on a full disk later */
+  int err = posix_fallocate( fd, 0, data_offset );
+  if ( err ) {
+    throw UnixError( err );
+  }
+
+  map = (uint8_t *)mmap( NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+  if ( map == MAP_FAILED ) {
+    map = NULL;
+    throw UnixError( errno );
+  }
+
+  header = (SpillHeader *)map;
+  entries = (SpillEntry *)(map + sizeof( SpillHeader ));
+
+  if ( !valid ) {
+    memcpy( header->magic, spill_magic, sizeof( spill_magic ) );
+    header->slot_len = slot_len;
+    header->num_slots = num_slots;
+    header->frame_len = frame_len;
+    header->stride = stride;
+    header->stamp = 0;
+  }
+}
+
+SpillCache::~SpillCache()
+{
+  /* Let the writer finish what is queued */
+  writes.enqueue( &shutdown );
+  unixassert( pthread_join( writer, NULL ) );
+
+  SpillWrite *w;
+  while ( (w = idle.dequeue( false )) ) {
+    free( w->data );
+    delete w;
+  }
+
+  munmap( map, map_len );
+  close( fd );
+
+  delete[] slot_of;
+  delete[] pending;
+  delete[] reading;
+
+  unixassert( pthread_mutex_destroy( &mutex ) );
+}
+
+bool SpillCache::contains( Picture *pic )
+{
+  MutexLock x( &mutex );
+  uint display = pic->get_display();
+  return pending[ display ] || (slot_of[ display ] >= 0);
+}
+
+void SpillCache::store( Picture *pic, Frame *frame )
+{
+  uint display = pic->get_display();
+  SpillWrite *w;
+
+  {
+    MutexLock x( &mutex );
+
+    if ( pending[ display ] || (slot_of[ display ] >= 0) ) {
+      return;
+    }
+
+    w = idle.dequeue( false );
+    if ( !w ) {
+      if ( buffers == max_buffers ) {
+	/* The disk is behind; decoding doesn't wait for it */
+	dropped++;
+	return;
+      }
+
+      uint8_t *data = (uint8_t *)malloc( frame_len );
+      if ( !data ) {
+	throw UnixError( ENOMEM );
+      }
+      w = new SpillWrite( data );
+      buffers++;
+    }
+  }
+
+  /* The buffer is ours until it is pending */
+  memcpy( w->data, frame->get_y(), frame_len );
+
+  MutexLock x( &mutex );
+
+  /* Spilled from another frame in the meantime */
+  if ( pending[ display ] || (slot_of[ display ] >= 0) ) {
+    idle.enqueue( w );
+    return;
+  }
+
+  w->display = display;
+  pending[ display ] = w;
+  writes.enqueue( w );
+}
+
+/* Fills the frame from a buffer still waiting for the writer, or else
+   reads it from its slot straight into the frame. Either is pinned
+   while we copy: the writer doesn't recycle the buffer, nor reuse the
+   slot. */
+bool SpillCache::restore( Picture *pic, Frame *frame )
+{
+  uint display = pic->get_display();
+  SpillWrite *w = NULL;
+  int slot = -1;
+
+  {
+    MutexLock x( &mutex );
+
+    if ( pending[ display ] ) {
+      w = pending[ display ];
+      w->readers++;
+    } else if ( slot_of[ display ] >= 0 ) {
+      slot = slot_of[ display ];
+      reading[ slot ]++;
+      entries[ slot ].stamp = ++header->stamp;
+    } else {
+      return false;
+    }
+  }
+
+  size_t done = 0;
+  if ( w ) {
+    memcpy( frame->get_y(), w->data, frame_len );
+    done = frame_len;
+  } else {
+    off_t offset = data_offset + (off_t)slot * slot_len;
+    while ( done < frame_len ) {
+      ssize_t got = pread( fd, frame->get_y() + done, frame_len - done, offset + done );
+      if ( got <= 0 ) {
+	break;
+      }
+      done += got;
+    }
+  }
+
+  MutexLock x( &mutex );
+
+  if ( w ) {
+    /* The writer left the buffer to us if it finished meanwhile */
+    if ( (--w->readers == 0) && (pending[ display ] != w) ) {
+      idle.enqueue( w );
+    }
+  } else {
+    reading[ slot ]--;
+  }
+
+  if ( done < frame_len ) {
+    /* The frame is decoded after all */
+    if ( !failed++ ) {
+      perror( "spill file: pread" );
+    }
+    return false;
+  }
+
+  restored++;
+  return true;
+}
+
+void SpillCache::run_writer( void )
+{
+  while ( 1 ) {
+    SpillWrite *w = writes.dequeue( true );
+    if ( w == &shutdown ) {
+      return;
+    }
+
+    write( w );
+  }
+}
+
+/* An empty slot, or else the least recently used one, which is
+   emptied. Slots being read are passed over; -1 if that is all of
+   them. The mutex is held. */
+int SpillCache::take_slot( void )
+{
+  int best = -1;
+
+  for ( uint s = 0; s < header->num_slots; s++ ) {
+    if ( reading[ s ] ) {
+      continue;
+    } else if ( !entries[ s ].stamp ) {
+      return s;
+    } else if ( (best < 0) || (entries[ s ].stamp < entries[ best ].stamp) ) {
+      best = s;
+    }
+  }
+
+  if ( best < 0 ) {
+    return -1;
+  }
+
+  SpillEntry *e = &entries[ best ];
+  if ( (e->stream == stream) && (e->lowres == lowres) && (e->display < num_pictures)
+       && (slot_of[ e->display ] == best) ) {
+    slot_of[ e->display ] = -1;
+  }
+  e->stamp = 0;
+
+  return best;
+}
+
+/* Runs on the writer thread. The slot is written without the mutex;
+   nobody reads it until its entry says what it holds. The buffer goes
+   back to idle afterwards, unless a restore() is still copying out of
+   it and gives it back itself. */
+void SpillCache::write( SpillWrite *w )
+{
+  int slot;
+  {
+    MutexLock x( &mutex );
+    slot = take_slot();
+  }
+
+  size_t done = 0;
+  if ( slot >= 0 ) {
+    off_t offset = data_offset + (off_t)slot * slot_len;
+    while ( done < frame_len ) {
+      ssize_t written = pwrite( fd, w->data + done, frame_len - done, offset + done );
+      if ( written <= 0 ) {
+	break;
+      }
+      done += written;
+    }
+  }
+
+  MutexLock x( &mutex );
+
+  pending[ w->display ] = NULL;
+  if ( !w->readers ) {
+    idle.enqueue( w );
+  }
+
+  if ( slot < 0 ) {
+    /* Every slot is being read; a file this small keeps what it has */
+    dropped++;
+    return;
+  }
+
+  if ( done < frame_len ) {
+    /* Most likely the disk is full; the slot stays empty */
+    if ( !failed++ ) {
+      perror( "spill file: pwrite" );
+    }
+    return;
+  }
+
+  SpillEntry *e = &entries[ slot ];
+  e->stream = stream;
+  e->display = w->display;
+  e->lowres = lowres;
+  e->stamp = ++header->stamp;
+  slot_of[ w->display ] = slot;
+  stored++;
+}
+
+void SpillCache::print_status( void )
+{
+  MutexLock x( &mutex );
+
+  uint used = 0;
+  for ( uint s = 0; s < header->num_slots; s++ ) {
+    if ( entries[ s ].stamp ) used++;
+  }
+
+  fprintf( stderr, "spill file: %u of %u slots (%.1f MiB each) in use, %u frames from earlier sessions\n",
+	   used, (uint)header->num_slots, slot_len / 1048576.0, found );
+  fprintf( stderr, "spill file: %u written, %u restored, %u skipped while the disk was busy, %u failed\n",
+	   stored, restored, dropped, failed );
+}
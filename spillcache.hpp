@@ -0,0 +1,87 @@
+#ifndef SPILLCACHE_HPP
+#define SPILLCACHE_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <pthread.h>
+
+#include "ringqueue.hpp"
+
+class Frame;
+class Picture;
+struct SpillHeader;
+struct SpillEntry;
+
+/* A copy of a frame waiting for the writer thread */
+class SpillWrite
+{
+public:
+  uint display;
+  uint8_t *data;
+  uint readers; /* restore()s copying out of it without the mutex */
+
+  SpillWrite( uint8_t *s_data ) : display( 0 ), data( s_data ), readers( 0 ) {}
+};
+
+/* Third tier, below the FrameCache: rendered frames leaving the
+   BufferPool are written to a file of fixed-size slots that outlives
+   the session. The file starts with an index of the slots, each
+   keyed by stream identity, lowres and display number, so reopening
+   a stream finds the frames an earlier session spilled, and getting
+   one back is a copy out of the page cache instead of a decode. The
+   file is started over if its frames are laid out differently.
+
+   Frames are copied to a staging buffer and written by a thread of
+   their own; until then they are restored from the buffer. When all
+   the buffers are busy, the frame is not spilled. The least recently
+   used slot is reused once the file is full. The file is locked
+   while it is open, so only one process uses it at a time.
+
+   store() and restore() are called without the pool mutex and copy
+   frames without ours, which is only taken to claim a buffer or pin a
+   slot and to let it go. */
+class SpillCache
+{
+private:
+  int fd;
+  uint8_t *map;
+  size_t map_len, data_offset, slot_len, frame_len;
+  uint stride;
+  SpillHeader *header;
+  SpillEntry *entries;
+
+  uint64_t stream;
+  uint lowres, num_pictures;
+  int *slot_of;         /* by display number, -1 if not in the file */
+  uint *reading;        /* by slot, restore()s reading it */
+  SpillWrite **pending; /* by display number, if waiting for the writer */
+
+  RingQueue<SpillWrite> writes, idle;
+  uint buffers;
+  SpillWrite shutdown;
+
+  pthread_t writer;
+  pthread_mutex_t mutex;
+
+  uint found, stored, restored, dropped, failed;
+
+  void setup( const char *filename, size_t budget );
+  int take_slot( void );
+  void write( SpillWrite *w );
+
+public:
+  SpillCache( const char *filename, size_t budget, uint64_t s_stream,
+	      uint s_lowres, uint s_num_pictures, size_t s_frame_len, uint s_stride );
+  ~SpillCache();
+
+  bool contains( Picture *pic );
+  void store( Picture *pic, Frame *frame );
+  bool restore( Picture *pic, Frame *frame );
+
+  void run_writer( void );
+
+  void print_status( void );
+};
+
+#endif
@@ -0,0 +1,223 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "telemetry.hpp"
+
+static const uint timing_words = sizeof( FrameTiming ) / sizeof( int64_t );
+static const uint max_retraces_counted = 8;
+static const uint histogram_buckets = 10; /* <1 ms, 1-2, 2-4, ... 256+ */
+
+FrameTimingLog::FrameTimingLog( uint s_capacity )
+  : entries( NULL ), mask( 0 ), claimed( 0 ), written( 0 )
+{
+  uint capacity = 2;
+  while ( capacity < s_capacity ) {
+    capacity *= 2;
+  }
+
+  mask = capacity - 1;
+  entries = new FrameTiming[ capacity ];
+  memset( entries, 0, capacity * sizeof( FrameTiming ) );
+}
+
+FrameTimingLog::~FrameTimingLog()
+{
+  delete[] entries;
+}
+
+/* A seqlock per lap of the ring: the slot is claimed before it is
+   overwritten, so a reader that saw any of the new words also sees
+   the claim, and knows to drop the entry */
+void FrameTimingLog::record( const FrameTiming &timing )
+{
+  uint64_t n = written;
+  const int64_t *from = (const int64_t *)&timing;
+  int64_t *to = (int64_t *)&entries[ n & mask ];
+
+  __atomic_store_n( &claimed, n + 1, __ATOMIC_RELAXED );
+  __atomic_thread_fence( __ATOMIC_RELEASE );
+
+  for ( uint i = 0; i < timing_words; i++ ) {
+    __atomic_store_n( &to[ i ], from[ i ], __ATOMIC_RELAXED );
+  }
+
+  __atomic_store_n( &written, n + 1, __ATOMIC_RELEASE );
+}
+
+uint FrameTimingLog::snapshot( FrameTiming *out )
+{
+  uint64_t end = __atomic_load_n( &written, __ATOMIC_ACQUIRE );
+  uint64_t start = end > mask ? end - mask - 1 : 0;
+
+  for ( uint64_t n = start; n < end; n++ ) {
+    const int64_t *from = (const int64_t *)&entries[ n & mask ];
+    int64_t *to = (int64_t *)&out[ n - start ];
+    for ( uint i = 0; i < timing_words; i++ ) {
+      to[ i ] = __atomic_load_n( &from[ i ], __ATOMIC_RELAXED );
+    }
+  }
+
+  __atomic_thread_fence( __ATOMIC_ACQUIRE );
+
+  /* Entry n's slot is reused by entry n + capacity */
+  uint64_t reused = __atomic_load_n( &claimed, __ATOMIC_RELAXED );
+  uint64_t valid = reused > mask ? reused - mask - 1 : 0;
+
+  if ( valid <= start ) {
+    return end - start;
+  }
+
+  if ( valid >= end ) {
+    return 0;
+  }
+
+  memmove( out, out + (valid - start), (end - valid) * sizeof( FrameTiming ) );
+  return end - valid;
+}
+
+static int compare_int64( const void *a, const void *b )
+{
+  int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+  return (x > y) - (x < y);
+}
+
+/* Nearest rank, of sorted values */
+static double percentile_ms( const int64_t *values, uint count, uint percent )
+{
+  uint rank = (count * percent + 99) / 100;
+  return values[ rank ? rank - 1 : 0 ] / 1000.0;
+}
+
+/* Microsecond values, reported in milliseconds. The histogram has
+   power-of-two buckets, plus one for negative values (early frames). */
+static void write_distribution( FILE *f, const char *name, int64_t *values, uint count )
+{
+  fprintf( f, ",\n  \"%s\": { \"count\": %u", name, count );
+
+  if ( count ) {
+    qsort( values, count, sizeof( int64_t ), compare_int64 );
+
+    int64_t sum = 0;
+    uint negative = 0, buckets[ histogram_buckets ] = { 0 };
+    for ( uint i = 0; i < count; i++ ) {
+      sum += values[ i ];
+
+      if ( values[ i ] < 0 ) {
+	negative++;
+	continue;
+      }
+
+      uint b = 0;
+      while ( (b + 1 < histogram_buckets) && (values[ i ] >= (1000LL << b)) ) {
+	b++;
+      }
+      buckets[ b ]++;
+    }
+
+    fprintf( f, ", \"mean\": %.3f, \"min\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f",
+	     sum / 1000.0 / count, values[ 0 ] / 1000.0,
+	     percentile_ms( values, count, 50 ), percentile_ms( values, count, 90 ),
+	     percentile_ms( values, count, 99 ), values[ count - 1 ] / 1000.0 );
+
+    fprintf( f, ",\n    \"histogram\": { " );
+    if ( negative ) {
+      fprintf( f, "\"<0\": %u, ", negative );
+    }
+    fprintf( f, "\"0-1\": %u", buckets[ 0 ] );
+    for ( uint b = 1; b + 1 < histogram_buckets; b++ ) {
+      fprintf( f, ", \"%d-%d\": %u", 1 << (b - 1), 1 << b, buckets[ b ] );
+    }
+    fprintf( f, ", \"%d+\": %u }", 1 << (histogram_buckets - 2), buckets[ histogram_buckets - 1 ] );
+  }
+
+  fprintf( f, " }" );
+}
+
+/* How many retraces each frame stayed up for. A steady cadence puts
+   nearly every frame in one or two adjacent counts (24 fps on a 60 Hz
+   display alternates 2 and 3); anything else is a stutter. */
+static void write_retraces( FILE *f, const FrameTiming *timings, uint count )
+{
+  uint counts[ max_retraces_counted + 1 ] = { 0 };
+  uint repeated = 0;
+
+  for ( uint i = 1; i < count; i++ ) {
+    int64_t retraces = timings[ i ].msc - timings[ i - 1 ].msc;
+    if ( retraces <= 0 ) {
+      repeated++;
+    } else {
+      counts[ retraces < max_retraces_counted ? retraces : max_retraces_counted ]++;
+    }
+  }
+
+  /* the usual pair of adjacent counts */
+  uint usual = 1;
+  for ( uint r = 2; r < max_retraces_counted; r++ ) {
+    if ( counts[ r ] + counts[ r + 1 ] > counts[ usual ] + counts[ usual + 1 ] ) {
+      usual = r;
+    }
+  }
+
+  fprintf( f, ",\n  \"retraces_per_frame\": { " );
+  if ( repeated ) {
+    fprintf( f, "\"0\": %u, ", repeated );
+  }
+  for ( uint r = 1; r < max_retraces_counted; r++ ) {
+    fprintf( f, "\"%u\": %u, ", r, counts[ r ] );
+  }
+  fprintf( f, "\"%u+\": %u }", max_retraces_counted, counts[ max_retraces_counted ] );
+
+  fprintf( f, ",\n  \"off_cadence\": %u", count - 1 - counts[ usual ] - counts[ usual + 1 ] );
+}
+
+void FrameTimingLog::write_json( FILE *f )
+{
+  FrameTiming *timings = new FrameTiming[ get_capacity() ];
+  uint count = snapshot( timings );
+  int64_t *values = new int64_t[ count ? count : 1 ];
+
+  fprintf( f, "{\n  \"frames_presented\": %llu,\n  \"frames\": %u",
+	   (unsigned long long)__atomic_load_n( &written, __ATOMIC_ACQUIRE ), count );
+
+  if ( count > 1 ) {
+    const FrameTiming &first = timings[ 0 ], &last = timings[ count - 1 ];
+
+    fprintf( f, ",\n  \"seconds\": %.3f,\n  \"frames_per_second\": %.3f",
+	     (last.shown_us - first.shown_us) / 1000000.0,
+	     (count - 1) * 1000000.0 / (last.shown_us - first.shown_us) );
+
+    if ( last.msc > first.msc ) {
+      fprintf( f, ",\n  \"retrace_ms\": %.3f",
+	       (last.ust - first.ust) / 1000.0 / (last.msc - first.msc) );
+    }
+
+    write_retraces( f, timings, count );
+
+    for ( uint i = 1; i < count; i++ ) {
+      values[ i - 1 ] = timings[ i ].shown_us - timings[ i - 1 ].shown_us;
+    }
+    write_distribution( f, "interval_ms", values, count - 1 );
+  }
+
+  uint n = 0;
+  for ( uint i = 0; i < count; i++ ) {
+    if ( timings[ i ].decoded_us ) {
+      values[ n++ ] = timings[ i ].shown_us - timings[ i ].decoded_us;
+    }
+  }
+  write_distribution( f, "decoded_to_shown_ms", values, n );
+
+  n = 0;
+  for ( uint i = 0; i < count; i++ ) {
+    if ( timings[ i ].due_us ) {
+      values[ n++ ] = timings[ i ].shown_us - timings[ i ].due_us;
+    }
+  }
+  write_distribution( f, "lateness_ms", values, n );
+
+  fprintf( f, "\n}\n" );
+  fflush( f );
+
+  delete[] values;
+  delete[] timings;
+}
@@ -0,0 +1,54 @@
+#ifndef TELEMETRY_HPP
+#define TELEMETRY_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+/* What the display thread saw of one frame it presented. Times are
+   CLOCK_MONOTONIC microseconds (PresentationClock::now()); msc and
+   ust are the retrace counter and its time from OML_sync_control, or
+   from the simulated retrace when headless. All fields are 64 bits
+   wide so that they can be copied atomically one at a time. */
+struct FrameTiming
+{
+  int64_t display;    /* picture number, in display order */
+  int64_t msc, ust;
+  int64_t shown_us;   /* when the swap returned */
+  int64_t decoded_us; /* when the decoder had the picture rendered */
+  int64_t due_us;     /* zero unless playing against the clock */
+};
+
+/* The timings of the last frames presented. record() is called by the
+   display thread only, and neither locks nor waits; any thread may
+   take a snapshot() meanwhile, which copies the entries out and then
+   drops any that the writer could have overwritten while they were
+   being copied. */
+class FrameTimingLog
+{
+private:
+  FrameTiming *entries;
+  uint64_t mask;
+  uint64_t claimed; /* entries ever started */
+  uint64_t written; /* entries ever recorded */
+
+  FrameTimingLog( const FrameTimingLog & );
+  FrameTimingLog & operator=( const FrameTimingLog & );
+
+public:
+  FrameTimingLog( uint s_capacity );
+  ~FrameTimingLog();
+
+  void record( const FrameTiming &timing );
+
+  /* Oldest first. Returns the number copied; out must have room for
+     the capacity. */
+  uint snapshot( FrameTiming *out );
+  uint get_capacity( void ) { return mask + 1; }
+
+  /* Histograms and percentiles of frame intervals, retraces per
+     frame, decode-to-present latency and lateness */
+  void write_json( FILE *f );
+};
+
+#endif
@@ -24,6 +24,8 @@
 #ifndef LIBMPEG2_VLC_H
 #define LIBMPEG2_VLC_H
 
+#include <string.h>
+
 #include "exceptions.hpp"
 
 #define GETWORD(bit_buf,shift,bit_ptr)				\
@@ -91,6 +93,78 @@ do {					\
 /* take num bits from the high part of bit_buf and sign extend them */
 #define SBITS(bit_buf,num) (((int32_t)(bit_buf)) >> (32 - (num)))
 
+/*
+ * The DCT coefficient parsers use a 64-bit bit_buf instead, so they
+ * refill at most once every few codes. There, avail counts the valid
+ * bits at the top of bit_buf. The bits below them are either zero or
+ * the stream bits that the next refill will OR into the same place.
+ * The refill loads whole bytes, so the valid bits always end at
+ * bit_ptr. Past the end of the slice, the stream reads as zeros, just
+ * as it does with GETWORD1 and GETWORD0.
+ */
+
+static inline uint64_t bitstream_load64 (const uint8_t * const p)
+{
+    uint64_t word;
+
+    memcpy (&word, p, sizeof (word));
+#ifndef WORDS_BIGENDIAN
+    word = __builtin_bswap64 (word);
+#endif
+    return word;
+}
+
+/* make sure that there are at least 32 valid bits in bit_buf */
+#define NEEDBITS64(bit_buf,avail,bit_ptr,boundscheck)			\
+do {									\
+    if (unlikely (avail < 32)) {					\
+	if (likely (bit_ptr + 8 <= boundscheck)) {			\
+	    const int bytes = (63 - avail) >> 3;			\
+	    bit_buf |= bitstream_load64 (bit_ptr) >> avail;		\
+	    bit_ptr += bytes;						\
+	    avail += bytes << 3;					\
+	} else {							\
+	    do {							\
+		if (bit_ptr < boundscheck)				\
+		    bit_buf |= (uint64_t) *bit_ptr << (56 - avail);	\
+		bit_ptr++;						\
+		avail += 8;						\
+	    } while (avail <= 56);					\
+	}								\
+    }									\
+} while (0)
+
+#define DUMPBITS64(bit_buf,avail,num)	\
+do {					\
+    bit_buf <<= (num);			\
+    avail -= (num);			\
+} while (0)
+
+#define UBITS64(bit_buf,num) ((uint32_t) ((bit_buf) >> (64 - (num))))
+#define SBITS64(bit_buf,num) ((int32_t) ((int64_t) (bit_buf) >> (64 - (num))))
+
+/* take over the decoder's 32-bit working set */
+#define BITSTREAM_GET64(decoder,bit_buf,avail,bit_ptr)		\
+do {								\
+    bit_buf = (uint64_t) (decoder)->bitstream_buf << 32;	\
+    avail = 16 - (decoder)->bitstream_bits;			\
+    bit_ptr = (decoder)->bitstream_ptr;				\
+} while (0)
+
+/* hand it back, returning whole bytes that do not fit in 32 bits */
+#define BITSTREAM_PUT64(decoder,bit_buf,avail,bit_ptr)			\
+do {									\
+    if (avail > 32) {							\
+	const int bytes = (avail - 25) >> 3;				\
+	bit_ptr -= bytes;						\
+	avail -= bytes << 3;						\
+    }									\
+    (decoder)->bitstream_buf =						\
+	(uint32_t) ((bit_buf >> 32) & ~(0xffffffffULL >> avail));	\
+    (decoder)->bitstream_bits = 16 - avail;				\
+    (decoder)->bitstream_ptr = bit_ptr;					\
+} while (0)
+
 typedef struct {
     uint8_t modes;
     uint8_t len;
@@ -122,6 +196,20 @@ typedef struct {
     uint8_t len;
 } DCTtab;
 
+/* Up to DCT_MULTI_CODES short codes (and an end of block) resolved by
+   one lookup on the next DCT_MULTI_BITS bits */
+#define DCT_MULTI_BITS 10
+#define DCT_MULTI_CODES 2
+
+typedef struct {
+    uint8_t count;	/* codes, not counting the end of block */
+    uint8_t eob;	/* the codes are followed by end of block */
+    uint8_t adv;	/* sum of the runs, 64 if nothing was resolved */
+    uint8_t len;	/* bits used, signs and end of block included */
+    uint8_t run[DCT_MULTI_CODES];
+    int8_t level[DCT_MULTI_CODES];	/* negative if the sign bit is set */
+} DCTmulti;
+
 typedef struct {
     uint8_t mba;
     uint8_t len;
@@ -39,7 +39,12 @@ void XEventLoop::loop( void )
       repaints.enqueue( new Repaint() );
     } else if ( ev.type == KeyPress ) {
       KeySym keysym = XLookupKeysym( key, 0 );
-      keys.enqueue( new XKey( keysym ) );
+      if ( keysym == 't' ) {
+	/* frame timings so far, read while the display carries on */
+	display->get_timings()->write_json( stderr );
+      } else {
+	keys.enqueue( new XKey( keysym ) );
+      }
     }
   }
 }